@@ -0,0 +1,47 @@
+#include "Bench.h"
+#include "krit/Engine.h"
+#include "krit/TaskManager.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace {
+std::atomic<size_t> allocations{0};
+}
+
+void *operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+namespace krit::bench {
+
+size_t allocationCount() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+void Phase::printHeader() {
+    printf("%-16s %-8s %10s %10s %12s %12s\n", "scenario", "phase",
+           "first ms", "allocs", "steady ms", "allocs");
+}
+
+void Phase::print(const char *scenario) {
+    int steadyFrames = frames > 1 ? frames - 1 : 1;
+    printf("%-16s %-8s %10.3f %10zu %12.4f %12.1f\n", scenario, name, firstMs,
+           firstAllocations, steadyMs / steadyFrames,
+           (double)steadyAllocations / steadyFrames);
+}
+
+void pump() {
+    TaskManager::work(engine->taskManager->mainQueue);
+    TaskManager::work(engine->taskManager->renderQueue);
+}
+
+}
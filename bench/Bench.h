@@ -0,0 +1,61 @@
+#ifndef KRIT_BENCH_BENCH
+#define KRIT_BENCH_BENCH
+
+#include <chrono>
+#include <cstddef>
+
+/**
+ * Shared pieces of the benchmarks in this directory. Each benchmark reports
+ * its first frame or round separately from the ones after it, since the
+ * first pays for cold caches.
+ */
+namespace krit::bench {
+
+/**
+ * Allocations made through operator new so far, on any thread; worker
+ * threads' allocations are counted towards whatever phase they overlap.
+ */
+size_t allocationCount();
+
+/**
+ * Time and allocations spent in one phase of each frame or round.
+ */
+struct Phase {
+    const char *name;
+    int frames = 0;
+    double firstMs = 0;
+    size_t firstAllocations = 0;
+    double steadyMs = 0;
+    size_t steadyAllocations = 0;
+
+    Phase(const char *name) : name(name) {}
+
+    template <typename F> void measure(F &&f) {
+        size_t allocations = allocationCount();
+        auto start = std::chrono::steady_clock::now();
+        f();
+        double ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+        allocations = allocationCount() - allocations;
+        if (frames++) {
+            steadyMs += ms;
+            steadyAllocations += allocations;
+        } else {
+            firstMs = ms;
+            firstAllocations = allocations;
+        }
+    }
+
+    static void printHeader();
+    void print(const char *scenario);
+};
+
+/**
+ * Run everything waiting on the main and render queues, as a frame would.
+ */
+void pump();
+
+}
+
+#endif
@@ -0,0 +1,188 @@
+#include "Bench.h"
+#include "krit/asset/AssetCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Times the asset cache's bookkeeping with many entries, using assets which
+ * cost nothing to load:
+ *
+ *   krit-cache-bench [--entries N] [--rounds N] [scenario...]
+ *
+ * fill requests every entry once into an empty cache; hit requests them all
+ * again from a full one. evict runs with a budget of half the entries, so
+ * every miss drops the least recently used asset; pinned does the same with
+ * every other asset still referenced, which eviction has to skip, once a
+ * frame. mixed splits the entries between two types sharing one budget, one
+ * with a floor. Requests are made PER_FRAME to a frame.
+ */
+
+using namespace krit;
+using namespace krit::bench;
+
+namespace {
+
+struct BenchSmall {
+    size_t bytes;
+};
+struct BenchLarge {
+    size_t bytes;
+};
+
+// ids end with the asset's cost, e.g. "asset/123:64"
+size_t parseCost(const std::string &id) {
+    return strtoul(id.c_str() + id.rfind(':') + 1, nullptr, 10);
+}
+
+}
+
+namespace krit {
+
+template <> AssetType AssetLoader<BenchSmall>::type() { return TextAsset; }
+template <>
+std::shared_ptr<BenchSmall>
+AssetLoader<BenchSmall>::loadAsset(const std::string &id) {
+    return std::make_shared<BenchSmall>(BenchSmall{parseCost(id)});
+}
+template <> AssetCost AssetLoader<BenchSmall>::cost(BenchSmall *asset) {
+    return AssetCost{asset->bytes};
+}
+
+template <> AssetType AssetLoader<BenchLarge>::type() { return ImageAsset; }
+template <>
+std::shared_ptr<BenchLarge>
+AssetLoader<BenchLarge>::loadAsset(const std::string &id) {
+    return std::make_shared<BenchLarge>(BenchLarge{parseCost(id)});
+}
+template <> AssetCost AssetLoader<BenchLarge>::cost(BenchLarge *asset) {
+    return AssetCost{0, asset->bytes};
+}
+
+}
+
+namespace {
+
+enum { Small, Large };
+
+using Cache = AssetCacheBase<BenchSmall, BenchLarge>;
+
+const size_t COST = 64;
+
+struct Scenario {
+    const char *name;
+    // run one round against a fresh cache
+    std::function<void(Cache &, const std::vector<std::string> &, Phase &)>
+        run;
+};
+
+// requests made per frame; assets used in the current frame can't be evicted
+const size_t PER_FRAME = 100;
+
+void requestAll(Cache &cache, const std::vector<std::string> &ids) {
+    for (size_t i = 0; i < ids.size(); ++i) {
+        cache.get<Small>(ids[i]);
+        if (i % PER_FRAME == PER_FRAME - 1) {
+            ++cache.frame;
+        }
+    }
+}
+
+std::vector<Scenario> scenarios() {
+    return {
+        {"fill",
+         [](Cache &cache, const std::vector<std::string> &ids, Phase &phase) {
+             phase.measure([&]() { requestAll(cache, ids); });
+         }},
+        {"hit",
+         [](Cache &cache, const std::vector<std::string> &ids, Phase &phase) {
+             requestAll(cache, ids);
+             phase.measure([&]() { requestAll(cache, ids); });
+         }},
+        {"evict",
+         [](Cache &cache, const std::vector<std::string> &ids, Phase &phase) {
+             cache.budget = ids.size() / 2 * COST;
+             requestAll(cache, ids);
+             phase.measure([&]() { requestAll(cache, ids); });
+         }},
+        {"pinned",
+         [](Cache &cache, const std::vector<std::string> &ids, Phase &phase) {
+             cache.budget = ids.size() / 2 * COST;
+             std::vector<std::shared_ptr<BenchSmall>> held;
+             for (size_t i = 0; i < ids.size(); ++i) {
+                 auto asset = cache.get<Small>(ids[i]);
+                 if (i % 2) {
+                     held.push_back(asset);
+                 }
+                 if (i % PER_FRAME == PER_FRAME - 1) {
+                     ++cache.frame;
+                 }
+             }
+             phase.measure([&]() { requestAll(cache, ids); });
+         }},
+        {"mixed",
+         [](Cache &cache, const std::vector<std::string> &ids, Phase &phase) {
+             cache.budget = ids.size() / 2 * COST;
+             cache.setFloor<Large>(ids.size() / 8 * COST);
+             auto request = [&]() {
+                 for (size_t i = 0; i < ids.size(); ++i) {
+                     if (i % 2) {
+                         cache.get<Large>(ids[i]);
+                     } else {
+                         cache.get<Small>(ids[i]);
+                     }
+                     if (i % PER_FRAME == PER_FRAME - 1) {
+                         ++cache.frame;
+                     }
+                 }
+             };
+             request();
+             phase.measure(request);
+         }},
+    };
+}
+
+}
+
+int main(int argc, char **argv) {
+    size_t entries = 20000;
+    int rounds = 10;
+    std::vector<std::string> only;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--entries") && i + 1 < argc) {
+            entries = std::max(2, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--rounds") && i + 1 < argc) {
+            rounds = std::max(2, atoi(argv[++i]));
+        } else {
+            only.push_back(argv[i]);
+        }
+    }
+
+    std::vector<std::string> ids;
+    ids.reserve(entries);
+    for (size_t i = 0; i < entries; ++i) {
+        ids.push_back("asset/" + std::to_string(i) + ":" +
+                      std::to_string(COST));
+    }
+
+    printf("%zu entries, %i rounds\n", entries, rounds);
+    Phase::printHeader();
+    for (auto &scenario : scenarios()) {
+        if (!only.empty() &&
+            std::find(only.begin(), only.end(), scenario.name) == only.end()) {
+            continue;
+        }
+        Phase phase("requests");
+        for (int round = 0; round < rounds; ++round) {
+            Cache cache;
+            scenario.run(cache, ids, phase);
+        }
+        phase.print(scenario.name);
+    }
+    return 0;
+}
@@ -0,0 +1,162 @@
+#include "Bench.h"
+#include "krit/asset/GlyphTable.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Compares the glyph cache's open-addressing GlyphTable with the
+ * std::unordered_map it replaced:
+ *
+ *   krit-glyph-table-bench [--glyphs N] [--lookups N] [--rounds N]
+ *
+ * insert fills an empty table with `glyphs` keys spread over a few fonts and
+ * sizes; find looks up `lookups` of them, skewed towards common glyphs the
+ * way text is; miss looks up keys which aren't there; evict erases the
+ * least recently used half and inserts it back, as the glyph cache does
+ * when it evicts at the end of a frame.
+ */
+
+using namespace krit;
+using namespace krit::bench;
+
+namespace {
+
+using GlyphMap = std::unordered_map<GlyphSize, GlyphData, GlyphSizeHash>;
+
+volatile size_t sink;
+
+std::vector<GlyphSize> makeKeys(size_t count, uint32_t firstFont) {
+    std::vector<GlyphSize> keys;
+    keys.reserve(count);
+    for (size_t i = 0; keys.size() < count; ++i) {
+        // a few fonts, each at a few sizes, some with borders
+        uint32_t font = firstFont + i % 3;
+        unsigned size = 12 + (i / 3) % 4 * 6;
+        unsigned border = (i / 12) % 4 == 3 ? 2 : 0;
+        keys.emplace_back(font, (char32_t)(32 + i / 12), size, border);
+    }
+    return keys;
+}
+
+// lookups skewed towards the first keys, like letter frequencies in text
+std::vector<size_t> makeLookups(size_t count, size_t keys) {
+    std::mt19937 random(1234);
+    std::geometric_distribution<size_t> skew(8.0 / keys);
+    std::vector<size_t> lookups(count);
+    for (auto &lookup : lookups) {
+        lookup = skew(random) % keys;
+    }
+    return lookups;
+}
+
+struct TableOps {
+    GlyphTable table;
+
+    void insert(const GlyphSize &key, unsigned frame) {
+        table.insert(key).lastUsed = frame;
+    }
+    GlyphData *find(const GlyphSize &key) { return table.find(key); }
+    void evictBefore(unsigned frame) {
+        table.eraseIf([frame](const GlyphSize &, GlyphData &glyph) {
+            return glyph.lastUsed < frame;
+        });
+    }
+};
+
+struct MapOps {
+    GlyphMap table;
+
+    void insert(const GlyphSize &key, unsigned frame) {
+        table[key].lastUsed = frame;
+    }
+    GlyphData *find(const GlyphSize &key) {
+        auto found = table.find(key);
+        return found == table.end() ? nullptr : &found->second;
+    }
+    void evictBefore(unsigned frame) {
+        for (auto it = table.begin(); it != table.end();) {
+            if (it->second.lastUsed < frame) {
+                it = table.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+};
+
+template <typename Ops>
+void run(const char *name, const std::vector<GlyphSize> &keys,
+         const std::vector<GlyphSize> &missing,
+         const std::vector<size_t> &lookups, int rounds) {
+    Phase insert("insert"), find("find"), miss("miss"), evict("evict");
+    for (int round = 0; round < rounds; ++round) {
+        Ops ops;
+        insert.measure([&]() {
+            for (size_t i = 0; i < keys.size(); ++i) {
+                ops.insert(keys[i], i < keys.size() / 2 ? 1 : 0);
+            }
+        });
+        find.measure([&]() {
+            size_t found = 0;
+            for (size_t lookup : lookups) {
+                found += ops.find(keys[lookup]) != nullptr;
+            }
+            sink = found;
+        });
+        miss.measure([&]() {
+            size_t found = 0;
+            for (auto &key : missing) {
+                found += ops.find(key) != nullptr;
+            }
+            sink = found;
+        });
+        evict.measure([&]() {
+            ops.evictBefore(1);
+            for (size_t i = keys.size() / 2; i < keys.size(); ++i) {
+                ops.insert(keys[i], 1);
+            }
+        });
+    }
+    insert.print(name);
+    find.print(name);
+    miss.print(name);
+    evict.print(name);
+}
+
+}
+
+int main(int argc, char **argv) {
+    size_t glyphs = 20000;
+    size_t lookups = 1000000;
+    int rounds = 10;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--glyphs") && i + 1 < argc) {
+            glyphs = std::max(2, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--lookups") && i + 1 < argc) {
+            lookups = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--rounds") && i + 1 < argc) {
+            rounds = std::max(2, atoi(argv[++i]));
+        } else {
+            fprintf(stderr,
+                    "usage: %s [--glyphs N] [--lookups N] [--rounds N]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<GlyphSize> keys = makeKeys(glyphs, 1);
+    // the same glyphs from fonts that were never loaded
+    std::vector<GlyphSize> missing = makeKeys(glyphs, 100);
+    std::vector<size_t> order = makeLookups(lookups, glyphs);
+
+    printf("%zu glyphs, %zu lookups, %i rounds\n", glyphs, lookups, rounds);
+    Phase::printHeader();
+    run<TableOps>("GlyphTable", keys, missing, order, rounds);
+    run<MapOps>("unordered_map", keys, missing, order, rounds);
+    return 0;
+}
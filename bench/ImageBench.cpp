@@ -0,0 +1,113 @@
+#include "Bench.h"
+#include "krit/Engine.h"
+#include "krit/TaskManager.h"
+#include "krit/asset/AssetLoader.h"
+#include "krit/asset/ImageLoader.h"
+#include "krit/render/ImageData.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Times loading many images at once, through to their textures being ready:
+ *
+ *   krit-image-bench [--count N] [--rounds N] [--root DIR]
+ *                    [--manifest PATH] [--premultiply] image...
+ *
+ * Each round loads `count` copies of every image, bypassing the asset cache.
+ * Issue is the time the caller spends in loadAsset, which is all the main
+ * thread pays up front; ready is the time from then until every image's
+ * whenReady has fired, running frames so that decoded pixels get uploaded.
+ * The first round is usually slower, with the files not yet in the page
+ * cache. This needs a window and GL context, as the uploads are real.
+ */
+
+using namespace krit;
+using namespace krit::bench;
+
+namespace {
+
+void loadRound(const std::vector<std::string> &paths, int count,
+               Phase &issue, Phase &ready) {
+    std::vector<std::shared_ptr<ImageData>> images;
+    images.reserve(paths.size() * count);
+    issue.measure([&]() {
+        for (int i = 0; i < count; ++i) {
+            for (auto &path : paths) {
+                images.push_back(AssetLoader<ImageData>::loadAsset(path));
+            }
+        }
+    });
+    size_t remaining = images.size();
+    ready.measure([&]() {
+        for (auto &img : images) {
+            img->whenReady([&]() { --remaining; });
+        }
+        while (remaining && engine->runFrame()) {
+        }
+    });
+}
+
+}
+
+int main(int argc, char **argv) {
+    int count = 16;
+    int rounds = 5;
+    std::vector<std::string> roots;
+    const char *manifest = nullptr;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--count") && i + 1 < argc) {
+            count = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--rounds") && i + 1 < argc) {
+            rounds = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--root") && i + 1 < argc) {
+            roots.push_back(argv[++i]);
+        } else if (!strcmp(argv[i], "--manifest") && i + 1 < argc) {
+            manifest = argv[++i];
+        } else if (!strcmp(argv[i], "--premultiply")) {
+            ImageLoader::premultiplyAlpha = true;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty()) {
+        fprintf(stderr, "usage: %s [--count N] [--rounds N] [--root DIR] "
+                        "[--manifest PATH] [--premultiply] image...\n",
+                argv[0]);
+        return 1;
+    }
+
+    KritOptions options;
+    // don't let vsync pace the frames the uploads are spread over
+    options.setTitle("krit-image-bench").setSize(1280, 720);
+    options.block = false;
+    Engine app(options);
+    auto scope = app.scope();
+    for (auto &root : roots) {
+        app.io->addRoot(root);
+    }
+    if (manifest && !ImageLoader::parseManifest(manifest)) {
+        fprintf(stderr, "couldn't load image manifest %s\n", manifest);
+        return 1;
+    }
+    app.start();
+
+    Phase issue("issue"), ready("ready");
+    for (int i = 0; i < rounds; ++i) {
+        loadRound(paths, count, issue, ready);
+    }
+    char scenario[32];
+    snprintf(scenario, sizeof(scenario), "%zu images",
+             paths.size() * count);
+    Phase::printHeader();
+    issue.print(scenario);
+    ready.print(scenario);
+
+    app.taskManager->cleanup();
+    return 0;
+}
@@ -0,0 +1,163 @@
+#include "Bench.h"
+#include "krit/Engine.h"
+#include "krit/TaskManager.h"
+#include "krit/io/Io.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+#ifdef KRIT_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Times reading the same assets as loose files, from a zip archive and from
+ * a pack archive:
+ *
+ *   krit-io-bench [--rounds N] [--zip PATH] [--pack PATH] DIR
+ *
+ * Every file under DIR is read through each backend given, and the archives
+ * should be made from DIR, e.g. with tools/pack/pack.py. Each read touches a
+ * byte of every page, so that mapped files pay for their page faults. The
+ * first round is cold: the files and archives are dropped from the page
+ * cache beforehand, where the platform allows it, and zip handles are only
+ * opened by it. Later rounds are warm.
+ */
+
+using namespace krit;
+using namespace krit::bench;
+
+namespace {
+
+volatile size_t sink;
+
+/**
+ * Ask the OS to drop a file's pages from its cache.
+ */
+void evict(const std::filesystem::path &path) {
+#ifdef KRIT_LINUX
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd != -1) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+#else
+    (void)path;
+#endif
+}
+
+size_t touch(const FileBytes &bytes) {
+    size_t sum = bytes.size();
+    for (size_t i = 0; i < bytes.size(); i += 4096) {
+        sum += (unsigned char)bytes.data()[i];
+    }
+    return sum;
+}
+
+struct Backend {
+    const char *name;
+    Io *io;
+    std::filesystem::path root;
+};
+
+void run(Backend &backend, const std::vector<std::string> &files,
+         int rounds) {
+    for (auto &file : files) {
+        if (!backend.io->exists(file)) {
+            fprintf(stderr, "skipping %s: %s isn't in %s\n", backend.name,
+                    file.c_str(), backend.root.c_str());
+            return;
+        }
+    }
+    Phase read("read");
+    for (int round = 0; round < rounds; ++round) {
+        read.measure([&]() {
+            size_t sum = 0;
+            for (auto &file : files) {
+                sum += touch(backend.io->readBytes(file));
+            }
+            sink = sum;
+        });
+    }
+    read.print(backend.name);
+}
+
+}
+
+int main(int argc, char **argv) {
+    int rounds = 10;
+    std::filesystem::path zip, pack, dir;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--rounds") && i + 1 < argc) {
+            rounds = std::max(2, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--zip") && i + 1 < argc) {
+            zip = argv[++i];
+        } else if (!strcmp(argv[i], "--pack") && i + 1 < argc) {
+            pack = argv[++i];
+        } else {
+            dir = argv[i];
+        }
+    }
+    if (dir.empty()) {
+        fprintf(stderr,
+                "usage: %s [--rounds N] [--zip PATH] [--pack PATH] DIR\n",
+                argv[0]);
+        return 1;
+    }
+
+    std::vector<std::string> files;
+    std::error_code error;
+    for (auto it = std::filesystem::recursive_directory_iterator(dir, error);
+         !error && it != std::filesystem::recursive_directory_iterator();
+         it.increment(error)) {
+        if (it->is_regular_file(error)) {
+            files.push_back(
+                it->path().lexically_relative(dir).generic_string());
+            evict(it->path());
+        }
+    }
+    if (error || files.empty()) {
+        fprintf(stderr, "no files to read in %s\n", dir.c_str());
+        return 1;
+    }
+    std::sort(files.begin(), files.end());
+
+    KritOptions options;
+    options.setHeadless(true);
+    Engine headless(options);
+    auto scope = headless.scope();
+
+    std::vector<Backend> backends;
+    backends.push_back({"loose", ioFile, dir});
+    if (!zip.empty()) {
+        backends.push_back({"zip", ioZip, zip});
+    }
+    if (!pack.empty()) {
+        backends.push_back({"pack", ioPack, pack});
+    }
+    for (auto &backend : backends) {
+        if (backend.root != dir) {
+            evict(backend.root);
+        }
+    }
+
+    char scenario[32];
+    snprintf(scenario, sizeof(scenario), "%zu files", files.size());
+    printf("%s, %i rounds\n", scenario, rounds);
+    Phase::printHeader();
+    for (auto &backend : backends) {
+        if (!backend.io->addRoot(backend.root)) {
+            fprintf(stderr, "skipping %s: couldn't open %s\n", backend.name,
+                    backend.root.c_str());
+            continue;
+        }
+        run(backend, files, rounds);
+    }
+
+    headless.taskManager->cleanup();
+    return 0;
+}
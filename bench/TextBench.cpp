@@ -0,0 +1,228 @@
+#include "Bench.h"
+#include "krit/Engine.h"
+#include "krit/TaskManager.h"
+#include "krit/render/DrawCommand.h"
+#include "krit/sprites/Text.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Times text layout, rendering and glyph cache commits for a few typical
+ * workloads, without a window or GPU:
+ *
+ *   krit-text-bench [--frames N] [--font PATH] [--cjk-font PATH] [scenario...]
+ *
+ * Layout covers any changes a scenario makes to its text plus
+ * Text::refresh; render is Text::render into the draw command buffer; commit
+ * is the glyph cache's commit and end of frame, which waits for glyphs
+ * being rasterized on workers. Scenarios share the glyph cache, so name one
+ * scenario to get its cold first frame on its own.
+ */
+
+using namespace krit;
+using namespace krit::bench;
+
+namespace {
+
+using Texts = std::vector<std::unique_ptr<Text>>;
+
+struct Scenario {
+    const char *name;
+    // whether it needs the CJK font
+    bool cjk;
+    // create the scenario's text
+    std::function<void(Texts &)> setup;
+    // change it before each frame after the first
+    std::function<void(Texts &, int)> update;
+};
+
+const char *LATIN =
+    "The quick brown fox jumps over the lazy dog, while five boxing wizards "
+    "jump quickly. Sphinx of black quartz, judge my vow! How vexingly quick "
+    "daft zebras jump; pack my box with five dozen liquor jugs. ";
+
+// the Thousand Character Classic, which doesn't repeat a character
+const char *CJK = "天地玄黄宇宙洪荒日月盈昃辰宿列张寒来暑往秋收冬藏闰余成岁"
+                  "律吕调阳云腾致雨露结为霜金生丽水玉出昆冈剑号巨阙珠称夜光"
+                  "果珍李柰菜重芥姜海咸河淡鳞潜羽翔龙师火帝鸟官人皇。";
+
+std::string repeat(const char *s, int count) {
+    std::string result;
+    for (int i = 0; i < count; ++i) {
+        result += s;
+    }
+    return result;
+}
+
+std::unique_ptr<Text> makeText(const char *font, int size, bool wrap = false,
+                               float width = 0) {
+    auto text = std::make_unique<Text>(
+        TextOptions().setFont(font).setSize(size).setWordWrap(wrap));
+    if (wrap) {
+        text->resize(width, 0);
+    }
+    return text;
+}
+
+std::vector<Scenario> scenarios() {
+    return {
+        {"latin-paragraph", false,
+         [](Texts &texts) {
+             texts.push_back(makeText("latin", 18, true, 960));
+             texts.back()->setText(repeat(LATIN, 20));
+         },
+         nullptr},
+        {"cjk-page", true,
+         [](Texts &texts) {
+             texts.push_back(makeText("cjk", 20, true, 960));
+             texts.back()->setText(repeat(CJK, 12));
+         },
+         nullptr},
+        {"rich-tags", false,
+         [](Texts &texts) {
+             texts.push_back(makeText("latin", 18, true, 960));
+             Text &text = *texts.back();
+             text.borderThickness = 2;
+             std::string s;
+             for (int i = 0; i < 20; ++i) {
+                 s += "<red>Warning:</red> the <alt>quick</alt> brown "
+                      "<outline>fox</outline> jumps over the "
+                      "<center>lazy dog</center><br/>";
+             }
+             text.setRichText(s);
+         },
+         nullptr},
+        {"labels", false,
+         [](Texts &texts) {
+             for (int i = 0; i < 1000; ++i) {
+                 texts.push_back(makeText("latin", 14));
+                 Text &text = *texts.back();
+                 text.move((i % 20) * 64, (i / 20) * 14);
+                 text.setText("Label " + std::to_string(i));
+             }
+         },
+         [](Texts &texts, int frame) {
+             // a few counters tick every frame
+             for (int i = 0; i < 50; ++i) {
+                 texts[(frame * 50 + i) % texts.size()]->setText(
+                     "Score " + std::to_string(frame * 50 + i));
+             }
+         }},
+        {"append-log", false,
+         [](Texts &texts) {
+             texts.push_back(makeText("latin", 14, true, 960));
+             texts.back()->setText("log started");
+         },
+         [](Texts &texts, int frame) {
+             texts.back()->appendText("\n[frame " + std::to_string(frame) +
+                                      "] loaded chunk, 42 entities in view");
+         }},
+    };
+}
+
+void run(Scenario &scenario, int frames) {
+    Texts texts;
+    scenario.setup(texts);
+    Phase layout("layout"), render("render"), commit("commit");
+    RenderContext &ctx = engine->ctx;
+    for (int frame = 0; frame < frames; ++frame) {
+        layout.measure([&]() {
+            if (frame && scenario.update) {
+                scenario.update(texts, frame);
+            }
+            for (auto &text : texts) {
+                text->refresh();
+            }
+        });
+        engine->phase = Engine::FramePhase::Render;
+        render.measure([&]() {
+            for (auto &text : texts) {
+                text->render(ctx);
+            }
+        });
+        engine->phase = Engine::FramePhase::Inactive;
+        commit.measure([&]() {
+            engine->fonts.commit();
+            engine->fonts.flush();
+        });
+        ctx.drawCommandBuffer->clear();
+        pump();
+    }
+    layout.print(scenario.name);
+    render.print(scenario.name);
+    commit.print(scenario.name);
+}
+
+bool registerFont(const char *name, const std::filesystem::path &path) {
+    if (!std::filesystem::exists(path)) {
+        return false;
+    }
+    engine->io->addRoot(path.parent_path());
+    engine->fonts.registerFont(name, path.filename().string());
+    return true;
+}
+
+}
+
+int main(int argc, char **argv) {
+    int frames = 120;
+    std::filesystem::path font = KRIT_BENCH_FONT;
+    std::filesystem::path cjkFont = KRIT_BENCH_CJK_FONT;
+    std::vector<std::string> only;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+            frames = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--font") && i + 1 < argc) {
+            font = argv[++i];
+        } else if (!strcmp(argv[i], "--cjk-font") && i + 1 < argc) {
+            cjkFont = argv[++i];
+        } else {
+            only.push_back(argv[i]);
+        }
+    }
+
+    KritOptions options;
+    options.setHeadless(true).setSize(1280, 720);
+    Engine headless(options);
+    auto scope = headless.scope();
+    Camera &camera = headless.addCamera().setLogicalSize(1280, 720);
+    camera.update();
+    headless.ctx.camera = &camera;
+    headless.ctx.drawCommandBuffer = &headless.renderer.drawCommandBuffer;
+
+    if (!registerFont("latin", font)) {
+        fprintf(stderr, "missing font %s; pass --font\n", font.c_str());
+        return 1;
+    }
+    registerFont("alt", font);
+    bool hasCjk = registerFont("cjk", cjkFont);
+    Text::addFormatTag("red", TextFormatTagOptions().setColor(0xff0000));
+    Text::addFormatTag("alt", TextFormatTagOptions().setFont("alt"));
+    Text::addFormatTag("outline", TextFormatTagOptions().setBorder());
+    Text::addFormatTag("center", TextFormatTagOptions().setAlign(CenterAlign));
+    Text::addFormatTag("br", TextFormatTagOptions().setNewline());
+
+    Phase::printHeader();
+    for (auto &scenario : scenarios()) {
+        if (!only.empty() &&
+            std::find(only.begin(), only.end(), scenario.name) == only.end()) {
+            continue;
+        }
+        if (scenario.cjk && !hasCjk) {
+            fprintf(stderr, "skipping %s: missing font %s; pass --cjk-font\n",
+                    scenario.name, cjkFont.c_str());
+            continue;
+        }
+        run(scenario, frames);
+    }
+
+    headless.taskManager->cleanup();
+    return 0;
+}
@@ -12,6 +12,9 @@
 #include "krit/input/Mouse.h"
 #include "krit/render/Gl.h"
 #include "krit/render/RenderContext.h"
+#if KRIT_ENABLE_SCRIPT
+#include "krit/script/Promise.h"
+#endif
 #include "krit/utils/Panic.h"
 #include "krit/utils/Profiling.h"
 #include "krit/utils/Signal.h"
@@ -75,6 +78,11 @@ Engine::Engine(KritOptions &options)
     script.userData = this;
     scriptContext = JS_NewObject(script.ctx);
 #endif
+    // hot reload: drop changed assets, so they're loaded again next time
+    // they're requested
+    io->onChange = [](const std::string &path) {
+        krit::engine->assets.invalidate(path);
+    };
     taskManager->start();
 }
 
@@ -402,8 +410,10 @@ void Engine::update() {
         }
     }
 
-    // asset requests
+    // changes to loose files, then asset requests
+    io->poll();
     assets.update();
+    textures.update();
 
     // actual update cycle
     invoke(onUpdate);
@@ -511,4 +521,49 @@ Camera &Engine::addCamera() {
     return cameras.back();
 }
 
+#if KRIT_ENABLE_SCRIPT
+#define DEFINE_ASSET_PRELOADER(N, T)                                           \
+    Promise Engine::preload##N(const std::string &s) {                         \
+        Promise promise(script.ctx);                                           \
+        assets.getAsync<T>(s, [promise](std::shared_ptr<T> asset) {            \
+            if (asset) {                                                       \
+                promise.resolve(true);                                         \
+            } else {                                                           \
+                promise.reject("failed to load asset");                        \
+            }                                                                  \
+        });                                                                    \
+        return promise;                                                        \
+    }
+DEFINE_ASSET_PRELOADER(Image, ImageData)
+DEFINE_ASSET_PRELOADER(Atlas, TextureAtlas)
+DEFINE_ASSET_PRELOADER(Font, Font)
+DEFINE_ASSET_PRELOADER(Spine, SpineData)
+DEFINE_ASSET_PRELOADER(Audio, AudioData)
+DEFINE_ASSET_PRELOADER(Text, std::string)
+DEFINE_ASSET_PRELOADER(Particle, ParticleEffect)
+#undef DEFINE_ASSET_PRELOADER
+
+Promise Engine::imageReady(const std::string &id) {
+    Promise promise(script.ctx);
+    assets.getAsync<ImageData>(id, [promise](std::shared_ptr<ImageData> img) {
+        if (!img) {
+            promise.reject("failed to load asset");
+            return;
+        }
+        img->whenReady([promise]() { promise.resolve(true); });
+    });
+    return promise;
+}
+
+Promise Engine::prefetchAssets(const std::string &manifestPath,
+                               const std::string &scene) {
+    Promise promise(script.ctx);
+    AssetManifest manifest =
+        AssetManifest::parse(io->readFile(manifestPath));
+    assets.prefetch(manifest, scene,
+                    [promise](size_t failed) { promise.resolve(!failed); });
+    return promise;
+}
+#endif
+
 }
@@ -6,6 +6,7 @@ declare class Engine {
     readonly window: Window;
     readonly audio: AudioBackend;
     readonly fonts: FontManager;
+    readonly textures: TextureResidency;
     readonly scriptContext: any;
     readonly isRenderPhase: boolean;
     speed: number;
@@ -20,4 +21,16 @@ declare class Engine {
     getImage(id: string): SharedPtr<ImageData>;
     getAtlas(id: string): SharedPtr<TextureAtlas>;
     getAudio(id: string): SharedPtr<AudioData>;
+    preloadImage(id: string): Promise<boolean>;
+    preloadAtlas(id: string): Promise<boolean>;
+    preloadAudio(id: string): Promise<boolean>;
+    imageReady(id: string): Promise<boolean>;
+
+    setAssetScene(tag: string): void;
+    startAssetRecording(): void;
+    stopAssetRecording(path: string): void;
+    assetPrefetchProgress(): number;
+    assetStatsJson(): string;
+    dumpAssetStats(path: string): void;
+    prefetchAssets(manifestPath: string, scene: string): Promise<boolean>;
 }
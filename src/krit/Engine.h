@@ -10,6 +10,7 @@
 #include "krit/math/Dimensions.h"
 #include "krit/platform/Platform.h"
 #include "krit/render/Renderer.h"
+#include "krit/render/TextureResidency.h"
 #include "krit/utils/Color.h"
 #include "krit/utils/Panic.h"
 #include "krit/utils/Signal.h"
@@ -91,6 +92,7 @@ public:
     Renderer renderer;
     InputContext input;
     AssetCache assets;
+    TextureResidency textures;
 
 #if KRIT_ENABLE_TEXT
     FontManager fonts;
@@ -190,6 +192,41 @@ public:
     DECLARE_ASSET_GETTER(Particle, ParticleEffect)
 #undef DECLARE_ASSET_GETTER
 
+#if KRIT_ENABLE_SCRIPT
+    // start loading an asset in the background; resolves once the matching
+    // getter will return it without blocking
+#define DECLARE_ASSET_PRELOADER(N) Promise preload##N(const std::string &s);
+    DECLARE_ASSET_PRELOADER(Image)
+    DECLARE_ASSET_PRELOADER(Atlas)
+    DECLARE_ASSET_PRELOADER(Font)
+    DECLARE_ASSET_PRELOADER(Spine)
+    DECLARE_ASSET_PRELOADER(Audio)
+    DECLARE_ASSET_PRELOADER(Text)
+    DECLARE_ASSET_PRELOADER(Particle)
+#undef DECLARE_ASSET_PRELOADER
+    // like preloadImage, but resolves only once the image's texture is ready
+    // to draw
+    Promise imageReady(const std::string &id);
+#endif
+
+    // record which assets each scene uses, to load them ahead of time later;
+    // see AssetCache::prefetch
+    void setAssetScene(const std::string &tag) { assets.setScene(tag); }
+    void startAssetRecording() { assets.startRecording(); }
+    void stopAssetRecording(const std::string &path) {
+        assets.stopRecording(path);
+    }
+    float assetPrefetchProgress() { return assets.prefetchProgress(); }
+    // see AssetCache::statsJson
+    std::string assetStatsJson() { return assets.statsJson(); }
+    void dumpAssetStats(const std::string &path) { assets.dumpStats(path); }
+#if KRIT_ENABLE_SCRIPT
+    // load the assets `scene` of the manifest asset at `manifestPath` uses in
+    // the background; resolves with whether they all loaded
+    Promise prefetchAssets(const std::string &manifestPath,
+                           const std::string &scene);
+#endif
+
     std::unique_ptr<TaskManager> taskManager;
 
 private:
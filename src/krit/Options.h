@@ -21,6 +21,8 @@ struct KritOptions {
     bool fullscreen{false};
     bool block{true};
     bool windowBorder{true};
+    // no window or GL context; see setHeadless
+    bool headless{false};
     int fixedFramerate{60};
     void *userData{nullptr};
     SDL_PropertiesID windowProperties{0};
@@ -60,6 +62,15 @@ struct KritOptions {
         this->fullscreen = val;
         return *this;
     }
+    /**
+     * Run without a window or GL context, for tools and benchmarks. Nothing
+     * is drawn: the renderer and glyph cache skip their GPU work, so only
+     * code which doesn't upload textures itself can run this way.
+     */
+    KritOptions &setHeadless(bool val) {
+        this->headless = val;
+        return *this;
+    }
     KritOptions &addCamera(const char *renderExport) {
         cameras.push_back(renderExport);
         return *this;
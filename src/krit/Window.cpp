@@ -14,6 +14,12 @@ namespace krit {
 
 Window::Window(KritOptions &options)
     : fullScreenDimensions(options.fullscreenWidth, options.fullscreenHeight) {
+    if (options.headless) {
+        headless = true;
+        x = options.width;
+        y = options.height;
+        return;
+    }
     SDL_SetHint(SDL_HINT_NO_SIGNAL_HANDLERS, "1");
     if (!SDL_Init(SDL_INIT_VIDEO)) {
         panic("SDL init failed: %s", SDL_GetError());
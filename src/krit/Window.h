@@ -24,14 +24,21 @@ struct Window : public IntDimensions {
     }
 
     bool full = false;
+    bool headless = false;
 
     Window(KritOptions &options);
     ~Window();
 
     void setFullScreen(bool full);
     bool isFullScreen() { return full; }
+    bool isHeadless() { return headless; }
 
     void getWindowSize(int *w, int *h) {
+        if (headless) {
+            *w = x;
+            *h = y;
+            return;
+        }
         SDL_GetWindowSize(this->window, w, h);
     }
 
@@ -45,13 +52,17 @@ struct Window : public IntDimensions {
     void show();
     void hide();
 
-    void makeCurrent() { SDL_GL_MakeCurrent(window, glContext); }
+    void makeCurrent() {
+        if (!headless) {
+            SDL_GL_MakeCurrent(window, glContext);
+        }
+    }
 
     SDL_Window *window = nullptr;
 
 private:
     SDL_Surface *surface = nullptr;
-    SDL_GLContext glContext;
+    SDL_GLContext glContext = nullptr;
     IntDimensions fullScreenDimensions;
     int skipFrames = 0;
 
@@ -1,37 +1,179 @@
 #include "krit/asset/AssetCache.h"
+#include "krit/Engine.h"
+#include "krit/TaskManager.h"
+#include <cinttypes>
+#include <cstdio>
 
 namespace krit {
 
-template <int A> static void bumpPreserved(AssetCache &cache) {
-    for (auto &it : std::get<A>(cache.preserved)) {
-        if (it.asset.use_count() == 1) {
-            // we have the only reference to this
-            ++it.unusedFrames;
-            // LOG_DEBUG("unused asset this frame: %s for %zu frames", it.id.c_str(), it.unusedFrames);
-        } else {
-            it.unusedFrames = 0;
-            // LOG_DEBUG("asset %s has use count of %zu", it.id.c_str(), it.asset.use_count());
+void queueAssetTask(AsyncTask &&task, bool offThread) {
+    if (offThread) {
+        engine->taskManager->push(std::move(task));
+    } else {
+        engine->taskManager->pushMain(std::move(task));
+    }
+}
+
+void AssetCache::update() { ++frame; }
+
+void AssetCache::startRecording() {
+    recorder.clear();
+    recorder.recording = true;
+}
+
+void AssetCache::stopRecording(const std::string &path) {
+    recorder.recording = false;
+    AssetManifest manifest;
+    if (engine->platform->exists(path)) {
+        manifest = AssetManifest::parse(engine->platform->readFile(path));
+    }
+    manifest.merge(recorder.manifest());
+    engine->platform->writeFile(path, manifest.serialize());
+    AREA_LOG_INFO("asset", "wrote asset manifest %s", path.c_str());
+}
+
+template <int A>
+static void prefetchAsset(AssetCache &cache, AssetType type,
+                          const std::string &id,
+                          std::function<void(bool)> &&onLoaded) {
+    if (type == A) {
+        cache.getAsync<A>(id, [onLoaded = std::move(onLoaded)](auto asset) {
+            onLoaded(asset != nullptr);
+        });
+    } else {
+        prefetchAsset<A + 1>(cache, type, id, std::move(onLoaded));
+    }
+}
+
+template <>
+void prefetchAsset<AssetTypeCount>(AssetCache &cache, AssetType type,
+                                   const std::string &id,
+                                   std::function<void(bool)> &&onLoaded) {}
+
+void AssetCache::prefetch(const AssetManifest &manifest,
+                          const std::string &scene,
+                          std::function<void(size_t)> &&onDone) {
+    struct PrefetchState {
+        size_t remaining;
+        size_t failed = 0;
+        std::function<void(size_t)> onDone;
+    };
+    const AssetManifest::Scene *found = manifest.findScene(scene);
+    if (!found || found->assets.empty()) {
+        AREA_LOG_WARN("asset", "nothing to prefetch for scene %s",
+                      scene.c_str());
+        if (onDone) {
+            queueAssetTask([onDone = std::move(onDone)]() { onDone(0); },
+                           false);
         }
+        return;
+    }
+    AREA_LOG_INFO("asset", "prefetching %zu assets for scene %s",
+                  found->assets.size(), scene.c_str());
+    auto state = std::make_shared<PrefetchState>();
+    state->remaining = found->assets.size();
+    state->onDone = std::move(onDone);
+    prefetchTotal += found->assets.size();
+    // these belong to the scene being prefetched, not the current one
+    bool recording = recorder.recording.exchange(false);
+    for (auto &entry : found->assets) {
+        prefetchAsset<0>(*this, entry.type, entry.id,
+                         [this, state](bool loaded) {
+                             if (!loaded) {
+                                 ++state->failed;
+                             }
+                             if (++prefetchFinished == prefetchTotal) {
+                                 prefetchFinished = prefetchTotal = 0;
+                             }
+                             if (!--state->remaining && state->onDone) {
+                                 state->onDone(state->failed);
+                             }
+                         });
     }
-    bumpPreserved<A + 1>(cache);
-}
-
-template <> void bumpPreserved<AssetTypeCount>(AssetCache &cache) {}
-
-void AssetCache::update() {
-    // for (size_t i = 0; i < assetRequests.size(); ++i) {
-    //     auto &request = assetRequests[i];
-    //     auto found = cache.find(request.id);
-    //     if (found != cache.end()) {
-    //         std::shared_ptr<void> asset = found->second.lock();
-    //         if (asset && request.ready(asset.get())) {
-    //             request.callback();
-    //             assetRequests.erase(assetRequests.begin() + i);
-    //             --i;
-    //         }
-    //     }
-    // }
-    bumpPreserved<0>(*this);
+    recorder.recording = recording;
 }
 
+float AssetCache::prefetchProgress() {
+    return prefetchTotal ? (float)prefetchFinished / prefetchTotal : 1;
+}
+
+template <int A>
+static void reportType(AssetCache &cache,
+                       std::vector<AssetTypeReport> &result) {
+    AssetTypeReport &report = result.emplace_back();
+    report.type = (AssetType)A;
+    report.budget = cache.budgets[A];
+    report.stats = cache.typeStats[A];
+    for (auto &preserved : std::get<A>(cache.preserved)) {
+        AssetCost cost =
+            AssetCache::AssetLoaderT<A>::cost(preserved.asset.get());
+        ++report.count;
+        report.cost.cpuBytes += cost.cpuBytes;
+        report.cost.gpuBytes += cost.gpuBytes;
+        report.cost.sharedBytes += cost.sharedBytes;
+    }
+    reportType<A + 1>(cache, result);
+}
+
+template <>
+void reportType<AssetTypeCount>(AssetCache &cache,
+                                std::vector<AssetTypeReport> &result) {}
+
+std::vector<AssetTypeReport> AssetCache::report() {
+    std::vector<AssetTypeReport> result;
+    reportType<0>(*this, result);
+    return result;
+}
+
+std::string AssetCache::statsJson() {
+    std::string json;
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "{\"frame\":%" PRIu64 ",\"budget\":%zu,\"used\":%zu,"
+             "\"types\":{",
+             frame, budget, used);
+    json += buf;
+    bool first = true;
+    for (auto &report : this->report()) {
+        const AssetTypeStats &stats = report.stats;
+        snprintf(buf, sizeof(buf),
+                 "%s\"%s\":{\"count\":%zu,\"cpuBytes\":%zu,\"gpuBytes\":%zu,"
+                 "\"sharedBytes\":%zu,\"chargedBytes\":%zu,",
+                 first ? "" : ",", assetTypeName(report.type), report.count,
+                 report.cost.cpuBytes, report.cost.gpuBytes,
+                 report.cost.sharedBytes, report.budget.used);
+        json += buf;
+        snprintf(buf, sizeof(buf),
+                 "\"floor\":%zu,\"ceiling\":%zu,\"hits\":%zu,\"misses\":%zu,"
+                 "\"loads\":%zu,\"failures\":%zu,\"evictions\":%zu,"
+                 "\"loadTimeMs\":%.3f,\"loadTimeHistogram\":[",
+                 report.budget.floor, report.budget.ceiling, stats.hits,
+                 stats.misses, stats.loads, stats.failures, stats.evictions,
+                 stats.loadTime);
+        json += buf;
+        for (size_t i = 0; i < stats.loadTimes.size(); ++i) {
+            if (i < std::size(AssetTypeStats::LOAD_TIME_BUCKETS)) {
+                snprintf(buf, sizeof(buf), "%s{\"maxMs\":%g,\"count\":%zu}",
+                         i ? "," : "", AssetTypeStats::LOAD_TIME_BUCKETS[i],
+                         stats.loadTimes[i]);
+            } else {
+                snprintf(buf, sizeof(buf), ",{\"maxMs\":null,\"count\":%zu}",
+                         stats.loadTimes[i]);
+            }
+            json += buf;
+        }
+        json += "]}";
+        first = false;
+    }
+    json += "}}";
+    return json;
+}
+
+void AssetCache::dumpStats(const std::string &path) {
+    engine->platform->writeFile(path, statsJson());
+    AREA_LOG_INFO("asset", "wrote asset stats to %s", path.c_str());
+}
+
+void AssetCache::resetStats() { typeStats = {}; }
+
 }
@@ -1,11 +1,16 @@
 #pragma once
 
+#include "krit/TaskManager.h"
 #include "krit/asset/AssetLoader.h"
+#include "krit/asset/AssetManifest.h"
 // TODO: make this more generic
 #include "krit/utils/FindFirst.h"
 #include "krit/utils/Log.h"
-#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
 #include <functional>
+#include <list>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -16,43 +21,128 @@ namespace krit {
 
 struct SpineData;
 
-struct AssetRequest {
-    int id;
-    bool (*ready)(void *id);
-    std::function<void()> callback;
+template <typename T>
+using AssetCallback = std::function<void(std::shared_ptr<T>)>;
+
+/**
+ * Queue part of an asynchronous asset load: on the work queue if
+ * `offThread`, otherwise on the main queue.
+ */
+void queueAssetTask(AsyncTask &&task, bool offThread);
+
+template <typename T>
+void AssetLoader<T>::loadAssetAsync(const std::string &path,
+                                    AssetLoadCallback<T> &&onLoaded) {
+    bool offThread = loadsOffThread();
+    queueAssetTask(
+        [path, offThread, onLoaded = std::move(onLoaded)]() {
+            auto start = std::chrono::steady_clock::now();
+            std::shared_ptr<T> asset = loadAsset(path);
+            float ms = std::chrono::duration<float, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+            if (offThread) {
+                queueAssetTask([onLoaded, asset, ms]() { onLoaded(asset, ms); },
+                               false);
+            } else {
+                onLoaded(asset, ms);
+            }
+        },
+        offThread);
+}
+
+/**
+ * Counters for one asset type, since the cache was created or last reset.
+ */
+struct AssetTypeStats {
+    // upper bounds of the load time histogram buckets, in milliseconds; the
+    // last bucket holds everything slower
+    static constexpr float LOAD_TIME_BUCKETS[] = {1, 4, 16, 64, 256};
+
+    // requests for an asset which was already loaded
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t loads = 0;
+    size_t failures = 0;
+    size_t evictions = 0;
+    // total milliseconds spent loading
+    double loadTime = 0;
+    std::array<size_t, std::size(LOAD_TIME_BUCKETS) + 1> loadTimes{};
+
+    void recordLoad(float ms, bool loaded) {
+        ++(loaded ? loads : failures);
+        loadTime += ms;
+        size_t bucket = 0;
+        while (bucket < std::size(LOAD_TIME_BUCKETS) &&
+               ms >= LOAD_TIME_BUCKETS[bucket]) {
+            ++bucket;
+        }
+        ++loadTimes[bucket];
+    }
 };
 
 template <typename T> struct PreservedAsset {
     std::string id;
     std::shared_ptr<T> asset;
-    size_t unusedFrames = 0;
+    // counted against the budget when the asset was stored
+    size_t cost;
+    // frame the asset was last requested or found in use
+    uint64_t lastUsed;
 
-    PreservedAsset() {}
-    PreservedAsset(const std::string &id, std::shared_ptr<T> asset)
-        : id(id), asset(asset) {}
+    PreservedAsset(const std::string &id, std::shared_ptr<T> asset,
+                   size_t cost, uint64_t lastUsed)
+        : id(id), asset(asset), cost(cost), lastUsed(lastUsed) {}
 };
 
-template <typename T>
-bool lru(const PreservedAsset<T> &a1, const PreservedAsset<T> &a2) {
-    return a1.unusedFrames < a2.unusedFrames ||
-           (a1.unusedFrames == a2.unusedFrames &&
-            AssetLoader<T>::cost(a1.asset.get()) <
-                AssetLoader<T>::cost(a2.asset.get()));
-}
+/**
+ * Bytes of one asset type in the cache. Past `ceiling` the type's least
+ * recently used assets are dropped; under `floor` they're kept even when the
+ * cache is over its overall budget. Zero disables either.
+ */
+struct AssetBudget {
+    size_t used = 0;
+    size_t floor = 0;
+    size_t ceiling = 0;
+};
 
+/**
+ * Keeps a reference to every loaded asset, so assets survive between uses,
+ * until the cache needs the space back.
+ *
+ * Each type keeps its assets in a list ordered by when they were last used,
+ * most recent first; requests move an asset to the front. When the cache is
+ * over budget, the oldest asset of any type that nothing else references
+ * is dropped. Assets found to be referenced on the way are moved to the
+ * front, so eviction is amortized O(1).
+ */
 template <typename... AssetTypes> struct AssetCacheBase {
-    std::tuple<std::unordered_map<std::string, std::weak_ptr<AssetTypes>>...>
+    template <typename T> using PreservedList = std::list<PreservedAsset<T>>;
+
+    std::tuple<PreservedList<AssetTypes>...> preserved;
+    std::tuple<std::unordered_map<
+        std::string, typename PreservedList<AssetTypes>::iterator>...>
         cache;
-    std::tuple<std::vector<PreservedAsset<AssetTypes>>...> preserved;
-    std::array<std::pair<size_t, size_t>, sizeof...(AssetTypes)> sizes;
+    std::array<AssetBudget, sizeof...(AssetTypes)> budgets;
+    std::array<AssetTypeStats, sizeof...(AssetTypes)> typeStats;
+    // bytes allowed across all types, or 0 for no limit
+    size_t budget = 0;
+    // bytes used across all types
+    size_t used = 0;
+    // advanced by update() once per frame
+    uint64_t frame = 0;
+    // callbacks waiting on each asset that getAsync is loading
+    std::tuple<std::unordered_map<std::string,
+                                  std::vector<AssetCallback<AssetTypes>>>...>
+        requests;
+    // while recording, notes the id of every asset requested
+    AssetRecorder recorder;
 
-    template <int A> void setLimit(size_t l) { std::get<A>(sizes).second = l; }
+    template <int A> void setLimit(size_t l) { budgets[A].ceiling = l; }
+    template <int A> void setFloor(size_t l) { budgets[A].floor = l; }
 
     template <int A>
-    using SharedPtrT = decltype(std::get<A>(preserved)[0].asset);
-    template <int A>
-    using AssetT = typename std::remove_reference<
-        decltype(*std::get<A>(preserved)[0].asset.get())>::type;
+    using AssetT = std::tuple_element_t<A, std::tuple<AssetTypes...>>;
+    template <int A> using SharedPtrT = std::shared_ptr<AssetT<A>>;
     template <int A> using AssetLoaderT = AssetLoader<AssetT<A>>;
 
     template <typename T> std::shared_ptr<T> get(const std::string &path) {
@@ -60,74 +150,290 @@ template <typename... AssetTypes> struct AssetCacheBase {
     }
 
     template <int A> SharedPtrT<A> get(const std::string &id) {
-        auto &cache = std::get<A>(this->cache);
-        auto &preserved = std::get<A>(this->preserved);
-        auto &sizes = std::get<A>(this->sizes);
-        {
-            auto it = cache.find(id);
-            if (it != cache.end()) {
-                // we can reuse a global reference
-                std::shared_ptr<void> v = it->second.lock();
-                if (v) {
-                    AREA_LOG_DEBUG("asset", "reuse asset: %s", id.c_str());
-                    SharedPtrT<A> ptr = std::static_pointer_cast<AssetT<A>>(v);
-                    return ptr;
-                }
-            }
+        recorder.record(AssetLoaderT<A>::type(), id);
+        if (SharedPtrT<A> asset = find<A>(id)) {
+            ++typeStats[A].hits;
+            return asset;
         }
         // we need to load this asset
+        ++typeStats[A].misses;
         AREA_LOG_INFO("asset", "load asset: %s", id.c_str());
+        auto start = std::chrono::steady_clock::now();
         SharedPtrT<A> asset = AssetLoaderT<A>::loadAsset(id);
+        typeStats[A].recordLoad(elapsedMs(start), asset != nullptr);
         if (!asset) {
             return nullptr;
         }
-        size_t cost = AssetLoaderT<A>::cost(asset.get());
-
-        cache[id] = std::weak_ptr<AssetT<A>>(asset);
-
-        auto &it = sizes;
-        it.first += cost;
-        if (it.second > 0 && it.first > it.second) {
-            AREA_LOG_DEBUG("asset",
-                           "we need space (%i); need %zu, %zu total, %zu limit",
-                           A, cost, it.first, it.second);
-            // purge assets to make room
-            std::sort(preserved.begin(), preserved.end(), lru<AssetT<A>>);
-            while (it.first > it.second) {
-                if (preserved.size() > 0) {
-                    AREA_LOG_DEBUG(
-                        "asset",
-                        "I have a preserved asset in the back, %s, with "
-                        "unused count %zu",
-                        preserved.back().id.c_str(),
-                        preserved.back().unusedFrames);
-                }
-                if (preserved.size() > 0 &&
-                    preserved.back().asset.use_count() == 1 &&
-                    preserved.back().unusedFrames > 0) {
-                    auto &dropped = preserved.back();
-                    size_t reclaimed =
-                        AssetLoaderT<A>::cost(dropped.asset.get());
-                    AREA_LOG_INFO("asset", "drop asset: %s (reclaimed %zu)",
-                                  preserved.back().id.c_str(), reclaimed);
-                    it.first -= reclaimed;
-                    preserved.pop_back();
-                } else {
-                    break;
-                }
+        store<A>(id, asset);
+        return asset;
+    }
+
+    template <typename T>
+    void getAsync(const std::string &path, AssetCallback<T> &&callback) {
+        this->getAsync<find_first<std::tuple<AssetTypes...>, T>::value>(
+            path, std::move(callback));
+    }
+
+    /**
+     * Load an asset without blocking. `callback` runs on the main thread
+     * with the asset, or nullptr if it couldn't be loaded; it never runs
+     * before getAsync returns. The loader's loadAssetAsync decides which
+     * threads do the work. Requests for an asset that's already loading
+     * share that load.
+     */
+    template <int A>
+    void getAsync(const std::string &id, AssetCallback<AssetT<A>> &&callback) {
+        recorder.record(AssetLoaderT<A>::type(), id);
+        if (SharedPtrT<A> asset = find<A>(id)) {
+            ++typeStats[A].hits;
+            queueAssetTask(
+                [asset, callback = std::move(callback)]() { callback(asset); },
+                false);
+            return;
+        }
+        ++typeStats[A].misses;
+        auto &requests = std::get<A>(this->requests);
+        auto found = requests.find(id);
+        if (found != requests.end()) {
+            AREA_LOG_DEBUG("asset", "join pending load: %s", id.c_str());
+            found->second.push_back(std::move(callback));
+            return;
+        }
+        requests[id].push_back(std::move(callback));
+        AREA_LOG_INFO("asset", "load asset in background: %s", id.c_str());
+        AssetLoaderT<A>::loadAssetAsync(
+            id, [this, id](SharedPtrT<A> asset, float ms) {
+                finishAsync<A>(id, asset, ms);
+            });
+    }
+
+    /**
+     * Drop every cached asset loaded from the asset file `path`, e.g.
+     * because it changed, so the next request loads it again. Anything still
+     * holding one of them keeps the old copy.
+     */
+    void invalidate(const std::string &path) {
+        invalidateAll(path, std::index_sequence_for<AssetTypes...>());
+    }
+
+    /**
+     * Return an asset if it's already loaded.
+     */
+    template <int A> SharedPtrT<A> find(const std::string &id) {
+        auto &cache = std::get<A>(this->cache);
+        auto it = cache.find(id);
+        if (it == cache.end()) {
+            return nullptr;
+        }
+        AREA_LOG_DEBUG("asset", "reuse asset: %s", id.c_str());
+        touch<A>(it->second);
+        return it->second->asset;
+    }
+
+private:
+    static float elapsedMs(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<float, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+            .count();
+    }
+
+    template <size_t... A>
+    void invalidateAll(const std::string &path, std::index_sequence<A...>) {
+        (invalidateType<A>(path), ...);
+    }
+
+    template <int A> void invalidateType(const std::string &path) {
+        auto &cache = std::get<A>(this->cache);
+        for (auto it = cache.begin(); it != cache.end();) {
+            if (!AssetLoaderT<A>::usesFile(it->first, path)) {
+                ++it;
+                continue;
             }
+            AREA_LOG_INFO("asset", "drop changed asset: %s",
+                          it->first.c_str());
+            auto dropped = it->second;
+            budgets[A].used -= dropped->cost;
+            used -= dropped->cost;
+            it = cache.erase(it);
+            std::get<A>(preserved).erase(dropped);
         }
+    }
 
-        preserved.push_back(PreservedAsset<AssetT<A>>(id, asset));
+    template <int A>
+    void touch(typename PreservedList<AssetT<A>>::iterator it) {
+        auto &preserved = std::get<A>(this->preserved);
+        it->lastUsed = frame;
+        preserved.splice(preserved.begin(), preserved, it);
+    }
 
-        return asset;
+    template <int A> void store(const std::string &id, SharedPtrT<A> asset) {
+        auto &preserved = std::get<A>(this->preserved);
+        size_t cost = AssetLoaderT<A>::cost(asset.get()).total();
+        preserved.emplace_front(id, asset, cost, frame);
+        std::get<A>(this->cache)[id] = preserved.begin();
+        AssetBudget &typeBudget = budgets[A];
+        typeBudget.used += cost;
+        used += cost;
+
+        while (typeBudget.ceiling && typeBudget.used > typeBudget.ceiling) {
+            if (!evictable<A>()) {
+                AREA_LOG_DEBUG("asset",
+                               "over limit (%i) with nothing to drop: %zu "
+                               "used, %zu limit",
+                               A, typeBudget.used, typeBudget.ceiling);
+                break;
+            }
+            evict<A>();
+        }
+        while (budget && used > budget &&
+               evictOldest(std::index_sequence_for<AssetTypes...>())) {
+        }
+    }
+
+    /**
+     * The least recently used asset of type A, if nothing else references
+     * it and it wasn't used this frame.
+     */
+    template <int A> PreservedAsset<AssetT<A>> *evictable() {
+        auto &preserved = std::get<A>(this->preserved);
+        for (size_t n = preserved.size(); n > 0; --n) {
+            auto &oldest = preserved.back();
+            if (oldest.lastUsed >= frame) {
+                // so was everything in front of it
+                return nullptr;
+            }
+            if (oldest.asset.use_count() == 1) {
+                return &oldest;
+            }
+            // still referenced, so in use as of now
+            touch<A>(std::prev(preserved.end()));
+        }
+        return nullptr;
+    }
+
+    template <int A> void evict() {
+        auto &preserved = std::get<A>(this->preserved);
+        auto &dropped = preserved.back();
+        AREA_LOG_INFO("asset", "drop asset: %s (reclaimed %zu)",
+                      dropped.id.c_str(), dropped.cost);
+        ++typeStats[A].evictions;
+        budgets[A].used -= dropped.cost;
+        used -= dropped.cost;
+        std::get<A>(this->cache).erase(dropped.id);
+        preserved.pop_back();
+    }
+
+    template <int A>
+    void considerEviction(int &victim, uint64_t &oldestFrame) {
+        AssetBudget &typeBudget = budgets[A];
+        if (typeBudget.used <= typeBudget.floor) {
+            return;
+        }
+        if (auto *candidate = evictable<A>()) {
+            if (victim == -1 || candidate->lastUsed < oldestFrame) {
+                victim = A;
+                oldestFrame = candidate->lastUsed;
+            }
+        }
+    }
+
+    /**
+     * Drop the least recently used asset of any type that's above its floor.
+     * Returns false if there was nothing to drop.
+     */
+    template <size_t... A> bool evictOldest(std::index_sequence<A...>) {
+        int victim = -1;
+        uint64_t oldestFrame = 0;
+        (considerEviction<A>(victim, oldestFrame), ...);
+        if (victim == -1) {
+            return false;
+        }
+        ((victim == (int)A ? evict<A>() : void()), ...);
+        return true;
+    }
+
+    template <int A>
+    void finishAsync(const std::string &id, SharedPtrT<A> asset, float ms) {
+        typeStats[A].recordLoad(ms, asset != nullptr);
+        if (asset) {
+            if (SharedPtrT<A> existing = find<A>(id)) {
+                // a synchronous get loaded it in the meantime
+                asset = existing;
+            } else {
+                store<A>(id, asset);
+            }
+        }
+        auto &requests = std::get<A>(this->requests);
+        auto found = requests.find(id);
+        std::vector<AssetCallback<AssetT<A>>> callbacks =
+            std::move(found->second);
+        requests.erase(found);
+        for (auto &callback : callbacks) {
+            callback(asset);
+        }
     }
 };
 
+/**
+ * What one asset type has in the cache, for telemetry.
+ */
+struct AssetTypeReport {
+    AssetType type;
+    size_t count = 0;
+    // current costs of the cached assets, which can differ from what was
+    // charged to the budget when they were stored
+    AssetCost cost;
+    AssetBudget budget;
+    AssetTypeStats stats;
+};
+
 struct AssetCache
     : public AssetCacheBase<ImageData, TextureAtlas, Font, std::string,
                             SpineData, AudioData, ParticleEffect> {
     void update();
+
+    /**
+     * Start recording every asset requested, grouped by the tag passed to
+     * setScene.
+     */
+    void startRecording();
+    /**
+     * Stop recording, and add what was recorded to the manifest at `path`
+     * (a platform path), creating it if needed.
+     */
+    void stopRecording(const std::string &path);
+    void setScene(const std::string &tag) { recorder.setScene(tag); }
+
+    /**
+     * Load the assets `scene` uses in the background, e.g. while a
+     * transition plays. `onDone` runs on the main thread once they've all
+     * finished loading, with the number which failed.
+     */
+    void prefetch(const AssetManifest &manifest, const std::string &scene,
+                  std::function<void(size_t)> &&onDone = nullptr);
+    /**
+     * How much of the prefetching started since the last time none was in
+     * progress has finished, from 0 to 1.
+     */
+    float prefetchProgress();
+
+    /**
+     * What each asset type has in the cache right now, in AssetType order.
+     */
+    std::vector<AssetTypeReport> report();
+    /**
+     * The report and overall budget as a JSON object.
+     */
+    std::string statsJson();
+    /**
+     * Write statsJson to `path`, a platform path.
+     */
+    void dumpStats(const std::string &path);
+    void resetStats();
+
+private:
+    size_t prefetchTotal = 0;
+    size_t prefetchFinished = 0;
 };
 
 }
@@ -24,8 +24,10 @@ template <> AssetType AssetLoader<std::string>::type() {
     return TextAsset;
 }
 
-template <> size_t AssetLoader<std::string>::cost(std::string *txt) {
-    return txt->size();
+template <> AssetCost AssetLoader<std::string>::cost(std::string *txt) {
+    return AssetCost{sizeof(std::string) + txt->capacity()};
 }
 
+template <> bool AssetLoader<std::string>::loadsOffThread() { return true; }
+
 }
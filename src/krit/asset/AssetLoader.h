@@ -3,6 +3,7 @@
 
 #include "krit/asset/AssetType.h"
 #include "krit/math/Dimensions.h"
+#include <functional>
 #include <memory>
 #include <string_view>
 #include <unordered_map>
@@ -10,6 +11,26 @@
 
 namespace krit {
 
+/**
+ * Memory held by a loaded asset. CPU and GPU bytes belong to the asset and
+ * count against cache budgets; shared bytes are kept alive by the asset but
+ * owned and accounted for elsewhere, like the images a texture atlas uses.
+ */
+struct AssetCost {
+    size_t cpuBytes = 0;
+    size_t gpuBytes = 0;
+    size_t sharedBytes = 0;
+
+    size_t total() const { return cpuBytes + gpuBytes; }
+};
+
+/**
+ * Receives an asynchronously loaded asset, or nullptr if it couldn't be
+ * loaded, and the milliseconds spent loading it.
+ */
+template <typename T>
+using AssetLoadCallback = std::function<void(std::shared_ptr<T>, float)>;
+
 template <typename T> struct AssetLoader {
     static AssetType type();
     static std::shared_ptr<T> loadAsset(const std::string &path);
@@ -17,7 +38,26 @@ template <typename T> struct AssetLoader {
     static bool assetIsReadyGeneric(void *asset) {
         return assetIsReady((T *)asset);
     }
-    static size_t cost(T *asset) { return 1; }
+    static AssetCost cost(T *asset) { return AssetCost{sizeof(T)}; }
+    /**
+     * Whether loadAsset can run on a worker thread. Loaders which load other
+     * assets or touch render state can't.
+     */
+    static bool loadsOffThread() { return false; }
+    /**
+     * Whether the asset loaded as `id` was read from the asset file `path`,
+     * so it's stale once that file changes.
+     */
+    static bool usesFile(const std::string &id, const std::string &path) {
+        return id == path;
+    }
+    /**
+     * Load an asset without blocking and call `onLoaded` with it on the main
+     * thread. By default this runs loadAsset, on a worker if loadsOffThread
+     * allows; loaders with their own pipeline specialize it.
+     */
+    static void loadAssetAsync(const std::string &path,
+                               AssetLoadCallback<T> &&onLoaded);
 };
 
 #define DECLARE_ASSET_LOADER(T)                                                \
@@ -25,7 +65,7 @@ template <typename T> struct AssetLoader {
     template <>                                                                \
     std::shared_ptr<T> AssetLoader<T>::loadAsset(const std::string &path);     \
     template <> bool AssetLoader<T>::assetIsReady(T *asset);                   \
-    template <> size_t AssetLoader<T>::cost(T *asset);
+    template <> AssetCost AssetLoader<T>::cost(T *asset);
 #define DECLARE_ASSET_LOADER2(T)                                               \
     struct T;                                                                  \
     DECLARE_ASSET_LOADER(T);
@@ -38,12 +78,23 @@ DECLARE_ASSET_LOADER2(AudioData)
 DECLARE_ASSET_LOADER2(ParticleEffect)
 DECLARE_ASSET_LOADER(std::string)
 
-struct ImageLoader {
-    static void parseManifest();
-};
-
 #undef DECLARE_ASSET_LOADER
 
+struct SpineData;
+template <> AssetCost AssetLoader<SpineData>::cost(SpineData *asset);
+
+template <> bool AssetLoader<std::string>::loadsOffThread();
+template <> bool AssetLoader<Font>::loadsOffThread();
+template <> bool AssetLoader<AudioData>::loadsOffThread();
+
+template <>
+bool AssetLoader<ImageData>::usesFile(const std::string &id,
+                                      const std::string &path);
+
+template <>
+void AssetLoader<ImageData>::loadAssetAsync(
+    const std::string &path, AssetLoadCallback<ImageData> &&onLoaded);
+
 }
 
 #endif
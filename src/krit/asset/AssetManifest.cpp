@@ -0,0 +1,115 @@
+#include "krit/asset/AssetManifest.h"
+#include "krit/utils/Log.h"
+#include <sstream>
+
+namespace krit {
+
+AssetManifest AssetManifest::parse(const std::string &s) {
+    AssetManifest manifest;
+    std::istringstream input(s);
+    std::string line;
+    std::string tag;
+    size_t lineNumber = 0;
+    while (std::getline(input, line)) {
+        ++lineNumber;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        if (line[0] == '[' && line.back() == ']') {
+            tag = line.substr(1, line.size() - 2);
+            continue;
+        }
+        size_t space = line.find(' ');
+        int type = AssetTypeCount;
+        if (space != std::string::npos) {
+            for (type = 0; type < AssetTypeCount; ++type) {
+                if (!line.compare(0, space, assetTypeName((AssetType)type))) {
+                    break;
+                }
+            }
+        }
+        if (type == AssetTypeCount || tag.empty()) {
+            AREA_LOG_WARN("asset", "bad asset manifest line %zu: %s",
+                          lineNumber, line.c_str());
+            continue;
+        }
+        manifest.add(tag, (AssetType)type, line.substr(space + 1));
+    }
+    return manifest;
+}
+
+AssetManifest::Scene *AssetManifest::findScene(const std::string &tag) {
+    for (auto &scene : scenes) {
+        if (scene.tag == tag) {
+            return &scene;
+        }
+    }
+    return nullptr;
+}
+
+void AssetManifest::add(const std::string &tag, AssetType type,
+                        const std::string &id) {
+    Scene *scene = findScene(tag);
+    if (!scene) {
+        scene = &scenes.emplace_back();
+        scene->tag = tag;
+    }
+    for (auto &entry : scene->assets) {
+        if (entry.type == type && entry.id == id) {
+            return;
+        }
+    }
+    scene->assets.push_back(Entry{type, id});
+}
+
+void AssetManifest::merge(const AssetManifest &other) {
+    for (auto &scene : other.scenes) {
+        for (auto &entry : scene.assets) {
+            add(scene.tag, entry.type, entry.id);
+        }
+    }
+}
+
+std::string AssetManifest::serialize() const {
+    std::string s;
+    for (auto &scene : scenes) {
+        s += "[" + scene.tag + "]\n";
+        for (auto &entry : scene.assets) {
+            s += assetTypeName(entry.type);
+            s += " " + entry.id + "\n";
+        }
+    }
+    return s;
+}
+
+void AssetRecorder::setScene(const std::string &tag) {
+    std::lock_guard<std::mutex> guard(lock);
+    scene = tag;
+}
+
+AssetManifest AssetRecorder::manifest() {
+    std::lock_guard<std::mutex> guard(lock);
+    return recorded;
+}
+
+void AssetRecorder::clear() {
+    std::lock_guard<std::mutex> guard(lock);
+    recorded.scenes.clear();
+    seen.clear();
+}
+
+void AssetRecorder::add(AssetType type, const std::string &id) {
+    std::lock_guard<std::mutex> guard(lock);
+    std::string key = scene;
+    key += '\n';
+    key += (char)('0' + type);
+    key += id;
+    if (seen.insert(std::move(key)).second) {
+        recorded.add(scene, type, id);
+    }
+}
+
+}
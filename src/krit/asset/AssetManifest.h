@@ -0,0 +1,86 @@
+#ifndef KRIT_ASSET_ASSETMANIFEST
+#define KRIT_ASSET_ASSETMANIFEST
+
+#include "krit/asset/AssetType.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace krit {
+
+/**
+ * The assets each scene requested, grouped by a scene tag chosen by the game.
+ * Stored as text, one scene header followed by one asset per line:
+ *
+ *     [level1]
+ *     image sprites/hero.png
+ *     font fonts/body.ttf
+ */
+struct AssetManifest {
+    struct Entry {
+        AssetType type;
+        std::string id;
+    };
+
+    struct Scene {
+        std::string tag;
+        // in the order they were first requested
+        std::vector<Entry> assets;
+    };
+
+    std::vector<Scene> scenes;
+
+    /**
+     * Read a manifest written by `serialize`. Lines that can't be parsed are
+     * skipped with a warning.
+     */
+    static AssetManifest parse(const std::string &s);
+
+    Scene *findScene(const std::string &tag);
+    const Scene *findScene(const std::string &tag) const {
+        return const_cast<AssetManifest *>(this)->findScene(tag);
+    }
+    /**
+     * Add an asset to a scene, unless it's already there.
+     */
+    void add(const std::string &tag, AssetType type, const std::string &id);
+    /**
+     * Add every asset of `other` to this manifest.
+     */
+    void merge(const AssetManifest &other);
+    std::string serialize() const;
+};
+
+/**
+ * Collects the assets requested from an AssetCache while recording.
+ */
+struct AssetRecorder {
+    std::atomic<bool> recording{false};
+
+    void setScene(const std::string &tag);
+    void record(AssetType type, const std::string &id) {
+        if (recording) {
+            add(type, id);
+        }
+    }
+    /**
+     * The assets recorded so far.
+     */
+    AssetManifest manifest();
+    void clear();
+
+private:
+    std::mutex lock;
+    std::string scene = "default";
+    AssetManifest recorded;
+    // scene, type and id of everything in `recorded`, to skip repeats cheaply
+    std::unordered_set<std::string> seen;
+
+    void add(AssetType type, const std::string &id);
+};
+
+}
+
+#endif
@@ -14,6 +14,13 @@ enum AssetType {
     AssetTypeCount,
 };
 
+inline const char *assetTypeName(AssetType type) {
+    static const char *names[AssetTypeCount] = {
+        "image", "atlas", "font", "text", "spine", "audio", "particle",
+    };
+    return names[type];
+}
+
 }
 
 #endif
@@ -3,45 +3,192 @@
 #include "krit/asset/Font.h"
 #include "harfbuzz/hb.h"
 #include "krit/Engine.h"
+#include "krit/TaskManager.h"
 #include "krit/io/Io.h"
 #include "krit/math/Dimensions.h"
 #include "krit/math/Rectangle.h"
 #include "krit/render/Gl.h"
 #include "krit/render/ImageData.h"
 #include "krit/utils/Panic.h"
+#include "krit/utils/Profiling.h"
+#include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include FT_GLYPH_H
 #include FT_TYPES_H
 #include FT_STROKER_H
+#include FT_MODULE_H
 #include <stdlib.h>
 #include <tuple>
 #include <utility>
 
 namespace krit {
 
-#ifndef __EMSCRIPTEN__
-static const int BYTES_PER_PIXEL = 1;
+// used both to measure glyphs and to rasterize them for the cache texture
+static const FT_Render_Mode RENDER_MODE = FT_RENDER_MODE_LIGHT;
+
+#if FREETYPE_MAJOR > 2 || (FREETYPE_MAJOR == 2 && FREETYPE_MINOR >= 11)
+#define KRIT_FT_SDF 1
 #else
-static const int BYTES_PER_PIXEL = 4;
+#define KRIT_FT_SDF 0
 #endif
 
-static FT_Stroker stroker;
+void FtGlyphDeleter::operator()(FT_GlyphRec_ *glyph) { FT_Done_Glyph(glyph); }
 
 template <>
 std::shared_ptr<Font> AssetLoader<Font>::loadAsset(const std::string &path) {
-    std::string content = engine->io->readFile(path);
-    // FIXME: do we leak content here, or does FT free it?
-    return std::make_shared<Font>(path, content);
+    // the font keeps the bytes alive for as long as HarfBuzz and FreeType
+    // are using them
+    return std::make_shared<Font>(path, engine->io->readBytes(path));
 }
 
 template <> AssetType AssetLoader<Font>::type() { return FontAsset; }
 
-template <> size_t AssetLoader<Font>::cost(Font *f) { return sizeof(Font); }
+template <> AssetCost AssetLoader<Font>::cost(Font *f) {
+    // glyphs live on pages shared by every font, which the glyph cache
+    // evicts on its own
+    return AssetCost{sizeof(Font) + f->fontData.size(), 0,
+                     engine->fonts.glyphCache.fontBytes(f)};
+}
+
+template <> bool AssetLoader<Font>::loadsOffThread() { return true; }
 
 static FT_Library ftLibrary{0};
 static int ftLibraryUsers{0};
+// guards ftLibrary, since fonts can be loaded on worker threads
+static std::mutex ftLibraryLock;
+
+// ids of destroyed fonts, in the order they were destroyed; each thread's
+// FreeType state closes its faces for them the next time it's used
+static std::mutex retiredFontsLock;
+static std::vector<uint32_t> retiredFonts;
+static std::atomic<size_t> retiredFontCount{0};
+
+/**
+ * FreeType objects can't be used from more than one thread at a time, so each
+ * thread that rasterizes glyphs has its own library, stroker and faces.
+ */
+struct FtThreadState {
+    FT_Library library = nullptr;
+    FT_Stroker stroker = nullptr;
+    // by Font::id
+    std::unordered_map<uint32_t, FT_Face> faces;
+    // how much of retiredFonts this thread has already purged
+    size_t retiredSeen = 0;
+
+    FtThreadState() {
+        int error = FT_Init_FreeType(&library);
+        if (error) {
+            panic("failed to initialize freetype: %i", error);
+        }
+        error = FT_Stroker_New(library, &stroker);
+        if (error) {
+            AREA_LOG_ERROR("font", "couldn't create stroker: %i", error);
+        }
+#if KRIT_FT_SDF
+        // the default spread of 2 is too narrow to draw borders with
+        FT_Int spread = Font::SDF_SPREAD;
+        FT_Property_Set(library, "sdf", "spread", &spread);
+        FT_Property_Set(library, "bsdf", "spread", &spread);
+#endif
+    }
+
+    ~FtThreadState() {
+        if (stroker) {
+            FT_Stroker_Done(stroker);
+        }
+        // also frees the faces
+        FT_Done_FreeType(library);
+    }
+
+    /**
+     * Close the faces of any fonts destroyed since the last call; their
+     * bytes are already gone.
+     */
+    void purge() {
+        if (retiredFontCount.load(std::memory_order_acquire) == retiredSeen) {
+            return;
+        }
+        std::lock_guard<std::mutex> guard(retiredFontsLock);
+        for (; retiredSeen < retiredFonts.size(); ++retiredSeen) {
+            auto found = faces.find(retiredFonts[retiredSeen]);
+            if (found != faces.end()) {
+                if (found->second) {
+                    FT_Done_Face(found->second);
+                }
+                faces.erase(found);
+            }
+        }
+    }
+
+    FT_Face face(Font *font) {
+        purge();
+        auto found = faces.find(font->id);
+        if (found != faces.end()) {
+            return found->second;
+        }
+        FT_Face face = nullptr;
+        if (FT_New_Memory_Face(library, (const FT_Byte *)font->fontData.data(),
+                               font->fontData.size(), 0, &face)) {
+            AREA_LOG_ERROR("font", "failed to open font: %s",
+                           font->path.c_str());
+        }
+        faces.emplace(font->id, face);
+        return face;
+    }
+};
+
+// created on first use by each thread, and released when it exits
+static thread_local std::unique_ptr<FtThreadState> ftThread;
+
+/**
+ * Load, stroke and rasterize a glyph using the calling thread's FreeType
+ * state. Returns nullptr on failure.
+ */
+static FT_Glyph rasterizeGlyph(Font *font, const GlyphSize &key) {
+    ProfileZone("GlyphCache::rasterize");
+    if (!ftThread) {
+        ftThread = std::make_unique<FtThreadState>();
+    }
+    FT_Face face = ftThread->face(font);
+    if (!face) {
+        return nullptr;
+    }
+    FT_Set_Pixel_Sizes(face, key.size, key.size);
+    if (FT_Load_Glyph(face, key.glyphIndex, FT_LOAD_DEFAULT)) {
+        panic("couldn't load glyph: %i", (int)key.glyphIndex);
+    }
+    FT_Glyph glyph;
+    if (FT_Get_Glyph(face->glyph, &glyph)) {
+        AREA_LOG_ERROR("font", "couldn't get glyph: %i", (int)key.glyphIndex);
+        return nullptr;
+    }
+    if (key.border > 0) {
+        FT_Stroker stroker = ftThread->stroker;
+        FT_Stroker_Set(stroker, key.border * 64, FT_STROKER_LINECAP_ROUND,
+                       FT_STROKER_LINEJOIN_ROUND, 0);
+        int err = FT_Glyph_StrokeBorder(&glyph, stroker, false, true);
+        if (err) {
+            AREA_LOG_ERROR("font", "couldn't stroke border: %i", err);
+        }
+    }
+    FT_Render_Mode mode = RENDER_MODE;
+#if KRIT_FT_SDF
+    if (font->sdf) {
+        // borders are drawn by the shader, so the glyph is never stroked
+        mode = FT_RENDER_MODE_SDF;
+    }
+#endif
+    if (FT_Glyph_To_Bitmap(&glyph, mode, nullptr, true)) {
+        AREA_LOG_ERROR("font", "couldn't render glyph: %i",
+                       (int)key.glyphIndex);
+        FT_Done_Glyph(glyph);
+        return nullptr;
+    }
+    return glyph;
+}
 
 FontManager::FontManager() {
     if (!ftLibrary) {
@@ -51,11 +198,6 @@ FontManager::FontManager() {
         if (error) {
             panic("failed to initialize freetype: %i", error);
         }
-        AREA_LOG_INFO("font", "creating stroker");
-        error = FT_Stroker_New(ftLibrary, &stroker);
-        if (error) {
-            AREA_LOG_ERROR("font", "couldn't create stroker: %i", error);
-        }
         ++ftLibraryUsers;
     }
 }
@@ -67,21 +209,9 @@ FontManager::~FontManager() {
     }
 }
 
-void FontManager::commit() {
-    if (glyphCache.img) {
-        glyphCache.commitChanges();
-    }
-    if (nextGlyphCache.img) {
-        nextGlyphCache.commitChanges();
-    }
-}
+void FontManager::commit() { glyphCache.commitChanges(); }
 
-void FontManager::flush() {
-    if (nextGlyphCache.img) {
-        glyphCache = std::move(nextGlyphCache);
-        nextGlyphCache = GlyphCache();
-    }
-}
+void FontManager::flush() { glyphCache.endFrame(); }
 
 std::shared_ptr<Font> FontManager::registerFont(const std::string &name,
                                                 const std::string &path) {
@@ -91,43 +221,64 @@ std::shared_ptr<Font> FontManager::registerFont(const std::string &name,
     return font;
 }
 
+std::shared_ptr<Font> FontManager::registerSdfFont(const std::string &name,
+                                                   const std::string &path) {
+    auto font = registerFont(name, path);
+    if (Font::sdfSupported()) {
+        font->sdf = true;
+    } else {
+        AREA_LOG_WARN("font", "SDF rendering unsupported; using bitmaps for %s",
+                      name.c_str());
+    }
+    return font;
+}
+
 GlyphData &FontManager::getGlyph(Font *font, char32_t codePoint,
                                  unsigned int size, unsigned int border) {
-    if (!nextGlyphCache.img) {
-        if (!glyphCache.img) {
-            glyphCache.createTexture();
-        }
-        GlyphData *found = glyphCache.getGlyph(font, codePoint, size, border);
-        if (found) {
-            return *found;
-        }
-        nextGlyphCache.createTexture();
-    }
-    GlyphData *found = nextGlyphCache.getGlyph(font, codePoint, size, border);
-    if (!found) {
-        panic("ran out of space in backup texture");
-    }
-    return *found;
+    // drawn as an empty rect if the glyph couldn't be rasterized
+    static GlyphData missingGlyph;
+    GlyphData *found = glyphCache.getGlyph(font, codePoint, size, border);
+    return found ? *found : missingGlyph;
 }
 
-Font::Font(const std::string &path, const std::string &fontData) : path(path) {
+static std::atomic<uint32_t> nextFontId{0};
+
+Font::Font() : id(++nextFontId) {}
+
+Font::Font(const std::string &path, FileBytes fontData)
+    : id(++nextFontId), path(path), fontData(std::move(fontData)) {
     // harfbuzz face initialization
-    this->fontData = fontData;
-    blob = hb_blob_create(this->fontData.c_str(), this->fontData.size(),
+    blob = hb_blob_create(this->fontData.data(), this->fontData.size(),
                           HB_MEMORY_MODE_READONLY, nullptr, nullptr);
     face = hb_face_create(blob, 0);
     font = hb_font_create(face);
     hb_font_set_scale(font, 64, 64);
     // freetype face initialization
+    std::lock_guard<std::mutex> guard(ftLibraryLock);
     int error =
-        FT_New_Memory_Face(ftLibrary, (const FT_Byte *)this->fontData.c_str(),
+        FT_New_Memory_Face(ftLibrary, (const FT_Byte *)this->fontData.data(),
                            this->fontData.size(), 0, (FT_Face *)&ftFace);
     if (error) {
         panic("failed to initialize font: %s", path.c_str());
     }
 }
 
+bool Font::sdfSupported() { return KRIT_FT_SDF; }
+
+float Font::sdfThreshold(float outset) {
+    // FreeType maps distances of [-spread, spread] onto [0, 256), with the
+    // edge at 128
+    float value = (128 - outset * 128 / SDF_SPREAD) / 255;
+    return std::clamp(value, 0.0f, 1.0f);
+}
+
 Font::~Font() {
+    if (face) {
+        // moved-from fonts have no face, and their id lives on
+        std::lock_guard<std::mutex> guard(retiredFontsLock);
+        retiredFonts.push_back(id);
+        retiredFontCount.store(retiredFonts.size(), std::memory_order_release);
+    }
     // if (ftFace) {
     //     FT_Done_Face((FT_Face)ftFace);
     // }
@@ -151,154 +302,505 @@ void Font::shape(hb_buffer_t *buf) {
     hb_shape(font, buf, userfeatures, 1);
 }
 
+ShapeCache::~ShapeCache() {
+    if (buffer) {
+        hb_buffer_destroy(buffer);
+    }
+}
+
+void ShapeCache::clear() {
+    entries.clear();
+    index.clear();
+}
+
+/**
+ * Scripts whose characters are shaped independently of their neighbors and
+ * which aren't written with spaces between words, so they can be split
+ * between any two characters.
+ */
+static bool unspacedScript(hb_script_t script) {
+    return script == HB_SCRIPT_HAN || script == HB_SCRIPT_HIRAGANA ||
+           script == HB_SCRIPT_KATAKANA || script == HB_SCRIPT_BOPOMOFO;
+}
+
+void ShapeCache::shape(Font *font, std::string_view text,
+                       std::vector<ShapedGlyph> &out) {
+    if (!buffer) {
+        buffer = hb_buffer_create();
+    }
+    // decode the text, then split it into segments which are shaped and
+    // cached on their own: spaces, since nothing we draw kerns across them,
+    // changes of script, and every character of scripts without spaces
+    hb_buffer_clear_contents(buffer);
+    hb_buffer_add_utf8(buffer, text.data(), text.size(), 0, -1);
+    unsigned int count;
+    hb_glyph_info_t *chars = hb_buffer_get_glyph_infos(buffer, &count);
+    hb_unicode_funcs_t *unicode = hb_unicode_funcs_get_default();
+    segments.clear();
+    for (unsigned int i = 0; i < count; ++i) {
+        uint32_t cluster = chars[i].cluster;
+        hb_codepoint_t c = chars[i].codepoint;
+        hb_script_t charScript = hb_unicode_script(unicode, c);
+        // neutral characters, like digits and punctuation, take the script
+        // of the segment they're in
+        bool neutral = charScript == HB_SCRIPT_COMMON ||
+                       charScript == HB_SCRIPT_INHERITED ||
+                       charScript == HB_SCRIPT_UNKNOWN;
+        Segment *current = segments.empty() ? nullptr : &segments.back();
+        bool split = !current || c == ' ' || text[current->start] == ' ' ||
+                     (!neutral && (unspacedScript(charScript) ||
+                                   (current->script != HB_SCRIPT_COMMON &&
+                                    current->script != (uint32_t)charScript)));
+        if (split) {
+            if (current) {
+                current->end = cluster;
+            }
+            segments.push_back(Segment{
+                cluster, 0,
+                (uint32_t)(neutral ? HB_SCRIPT_COMMON : charScript)});
+        } else if (!neutral && current->script == HB_SCRIPT_COMMON) {
+            // the first character with a script decides the segment's
+            current->script = charScript;
+        }
+    }
+    if (!segments.empty()) {
+        segments.back().end = text.size();
+    }
+
+    for (auto &segment : segments) {
+        size_t first = out.size();
+        auto &glyphs =
+            shapeWord(font, text.substr(segment.start,
+                                        segment.end - segment.start),
+                      segment.script);
+        out.insert(out.end(), glyphs.begin(), glyphs.end());
+        for (size_t i = first; i < out.size(); ++i) {
+            out[i].cluster += segment.start;
+        }
+    }
+}
+
+const std::vector<ShapedGlyph> &
+ShapeCache::shapeWord(Font *font, std::string_view word, uint32_t script) {
+    // what hb_buffer_guess_segment_properties would pick for the segment
+    hb_direction_t direction =
+        hb_script_get_horizontal_direction((hb_script_t)script);
+    if (direction == HB_DIRECTION_INVALID) {
+        direction = HB_DIRECTION_LTR;
+    }
+    hb_language_t language = hb_language_get_default();
+    ShapeKey key{font->id, font->ligatures, script, direction, language,
+                 std::string(word)};
+    auto found = index.find(key);
+    if (found != index.end()) {
+        ++hits;
+        entries.splice(entries.begin(), entries, found->second);
+        return found->second->second;
+    }
+    ++misses;
+    ProfileZone("ShapeCache::shapeWord");
+
+    hb_buffer_clear_contents(buffer);
+    hb_buffer_add_utf8(buffer, word.data(), word.size(), 0, -1);
+    hb_buffer_set_cluster_level(buffer,
+                                HB_BUFFER_CLUSTER_LEVEL_MONOTONE_CHARACTERS);
+    if (script != HB_SCRIPT_COMMON) {
+        hb_buffer_set_script(buffer, (hb_script_t)script);
+    }
+    hb_buffer_guess_segment_properties(buffer);
+    font->shape(buffer);
+    unsigned int glyphCount;
+    hb_glyph_info_t *glyphInfo = hb_buffer_get_glyph_infos(buffer, &glyphCount);
+    hb_glyph_position_t *glyphPos =
+        hb_buffer_get_glyph_positions(buffer, &glyphCount);
+
+    if (entries.size() >= capacity && !entries.empty()) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+    entries.emplace_front(std::move(key), std::vector<ShapedGlyph>());
+    auto &glyphs = entries.front().second;
+    glyphs.reserve(glyphCount);
+    for (unsigned int i = 0; i < glyphCount; ++i) {
+        glyphs.push_back(ShapedGlyph{glyphInfo[i].codepoint,
+                                     glyphInfo[i].cluster,
+                                     glyphPos[i].x_advance,
+                                     glyphPos[i].x_offset,
+                                     glyphPos[i].y_offset});
+    }
+    index.emplace(entries.front().first, entries.begin());
+    return glyphs;
+}
+
 GlyphData *GlyphCache::getGlyph(Font *font, char32_t codePoint,
                                 unsigned int size, unsigned int border) {
+    GlyphSize key(font->id, codePoint, size, border);
     {
         // check if we already contain this glyph at this size
-        auto it = glyphs.find(GlyphSize(font, codePoint, size, border));
-        if (it != glyphs.end()) {
-            return &it->second;
+        GlyphData *found = glyphs.find(key);
+        if (found) {
+            found->lastUsed = frame;
+            return found;
         }
     }
-    FT_Face face = (FT_Face)font->ftFace;
-    FT_Set_Pixel_Sizes(face, size, size);
-    if (FT_Load_Glyph(face, codePoint, FT_LOAD_DEFAULT)) {
-        panic("couldn't load glyph: %i", (int)codePoint);
+    GlyphData &data = glyphs.insert(key);
+    data.lastUsed = frame;
+    auto glyph = std::make_shared<PendingGlyph>(font, key);
+    pending.push_back(glyph);
+#if KRIT_ENABLE_THREADS
+    if (engine->taskManager) {
+        {
+            std::lock_guard<std::mutex> guard(rasterizeLock);
+            ++rasterizing;
+        }
+        engine->taskManager->push([this, glyph]() {
+            if (!glyph->claimed.exchange(true)) {
+                rasterize(*glyph);
+            }
+        });
+        return &data;
     }
-    FT_Glyph glyph;
-    if (FT_Get_Glyph(face->glyph, &glyph)) {
-        AREA_LOG_ERROR("font", "couldn't get glyph: %i", (int)codePoint);
-        return nullptr;
+#endif
+    glyph->claimed = true;
+    glyph->bitmap.reset(rasterizeGlyph(font, key));
+    land(*glyph, data);
+    return &data;
+}
+
+void GlyphCache::rasterize(PendingGlyph &glyph) {
+    glyph.bitmap.reset(rasterizeGlyph(glyph.font, glyph.key));
+    std::lock_guard<std::mutex> guard(rasterizeLock);
+    if (!--rasterizing) {
+        rasterized.notify_all();
     }
-    if (border > 0) {
-        FT_Stroker_Set(stroker, border * 64, FT_STROKER_LINECAP_ROUND,
-                       FT_STROKER_LINEJOIN_ROUND, 0);
-        int err = FT_Glyph_StrokeBorder(&glyph, stroker, false, true);
-        if (err) {
-            AREA_LOG_ERROR("font", "couldn't stroke border: %i", err);
+}
+
+bool GlyphCache::touch(const std::vector<GlyphSize> &keys) {
+    for (auto &key : keys) {
+        GlyphData *found = glyphs.find(key);
+        if (!found) {
+            return false;
         }
+        found->lastUsed = frame;
     }
-    FT_Glyph_To_Bitmap(&glyph, FT_RENDER_MODE_NORMAL, nullptr, true);
-    FT_BitmapGlyph bitmap = reinterpret_cast<FT_BitmapGlyph>(glyph);
+    return true;
+}
 
+bool GlyphCache::land(PendingGlyph &glyph, GlyphData &data) {
+    if (!glyph.bitmap) {
+        return false;
+    }
+    FT_BitmapGlyph bitmap =
+        reinterpret_cast<FT_BitmapGlyph>(glyph.bitmap.get());
     int width = bitmap->bitmap.width;
     int height = bitmap->bitmap.rows;
-    int neededWidth =
-        (width / SIZE_PRECISION + (width % SIZE_PRECISION ? 1 : 0)) *
-        SIZE_PRECISION;
-    int x = 0;
+    IntRectangle slot;
+    GlyphPage *page = place(width + PADDING * 2, height + PADDING * 2, slot);
+    if (!page) {
+        AREA_LOG_ERROR("font", "glyph too large for cache: %ix%i", width,
+                       height);
+        return false;
+    }
+    data.region = ImageRegion(
+        page->img, IntRectangle(slot.x + PADDING, slot.y + PADDING, width,
+                                height));
+    data.offset.setTo(bitmap->left, bitmap->top);
+    data.page = page;
+    page->liveArea += slot.width * slot.height;
+    return true;
+}
+
+GlyphPage *GlyphCache::place(int width, int height, IntRectangle &slot) {
+    for (auto &page : pages) {
+        if (page->pack(width, height, slot)) {
+            return page.get();
+        }
+    }
+    if (width > CACHE_TEXTURE_SIZE || height > CACHE_TEXTURE_SIZE) {
+        return nullptr;
+    }
+    AREA_LOG_INFO("font", "adding glyph cache page %zu", pages.size() + 1);
+    GlyphPage *page = pages.emplace_back(std::make_unique<GlyphPage>()).get();
+    page->pack(width, height, slot);
+    return page;
+}
+
+void GlyphCache::commitChanges() {
+    if (pending.empty()) {
+        return;
+    }
+    ProfileZone("GlyphCache::commitChanges");
+    // the work queue may be busy with other jobs; rather than waiting for
+    // it to get to them, rasterize any glyphs no worker has started yet
+    for (auto &it : pending) {
+        if (!it->claimed.exchange(true)) {
+            rasterize(*it);
+        }
+    }
     {
-        // search columns for space
-        for (auto &column : columns) {
-            if (CACHE_TEXTURE_SIZE - column.height >= height + PADDING * 2 &&
-                column.width >= neededWidth && column.width < neededWidth * 2) {
-                // use this one
-                auto it = glyphs.emplace(
-                    std::piecewise_construct,
-                    std::make_tuple(font, codePoint, size, border),
-                    std::make_tuple(
-                        ImageRegion(img, IntRectangle(x + PADDING,
-                                                      column.height + PADDING,
-                                                      width, height)),
-                        bitmap->left, bitmap->top));
-                column.height += height + PADDING * 2;
-                pending.emplace_back(font, codePoint, size, border);
-                FT_Done_Glyph(glyph);
-                return &it.first->second;
+        ProfileZone("GlyphCache::wait");
+        std::unique_lock<std::mutex> guard(rasterizeLock);
+        rasterized.wait(guard, [this]() { return !rasterizing; });
+    }
+    engine->window.makeCurrent();
+    bool landed = false;
+    for (auto &it : pending) {
+        GlyphData *found = glyphs.find(it->key);
+        if (!found) {
+            // evicted before it was ever drawn
+            continue;
+        }
+        GlyphData &glyphData = *found;
+        if (!glyphData.page) {
+            // rasterized on another thread; placing in request order keeps
+            // the layout the same however the work was scheduled
+            if (!land(*it, glyphData)) {
+                continue;
             }
-            x += column.width + PADDING * 2;
+            landed = true;
+        }
+        GlyphPage &page = *glyphData.page;
+        FT_BitmapGlyph bitmap =
+            reinterpret_cast<FT_BitmapGlyph>(it->bitmap.get());
+        IntRectangle &region = glyphData.region.rect;
+        for (unsigned int i = 0; i < bitmap->bitmap.rows; ++i) {
+            memcpy(&page.pixelData[(region.y + i) * CACHE_TEXTURE_SIZE +
+                                   region.x],
+                   &bitmap->bitmap.buffer[bitmap->bitmap.pitch * i],
+                   bitmap->bitmap.width);
         }
-        // TODO: for last column, allow expanding column size up to 2x
+        // include the padding, so glyphs stacked on the skyline coalesce
+        page.markDirty(IntRectangle(region.x - PADDING, region.y - PADDING,
+                                    region.width + PADDING * 2,
+                                    region.height + PADDING * 2));
     }
-    {
-        // if no space found, create new column
-        if (CACHE_TEXTURE_SIZE - x > neededWidth + PADDING * 2) {
-            columns.emplace_back(neededWidth, height + PADDING * 2);
-            auto it = glyphs.emplace(
-                std::piecewise_construct,
-                std::make_tuple(font, codePoint, size, border),
-                std::make_tuple(
-                    ImageRegion(
-                        img, IntRectangle(x + PADDING, PADDING, width, height)),
-                    bitmap->left, bitmap->top));
-            pending.emplace_back(font, codePoint, size, border);
-            FT_Done_Glyph(glyph);
-            return &it.first->second;
+    pending.clear();
+    if (landed) {
+        // text drawn without these glyphs needs to be rebuilt
+        ++generation;
+    }
+    for (auto &page : pages) {
+        page->upload();
+    }
+}
+
+void GlyphCache::endFrame() {
+    // anything rasterized this frame needs to be in place before it can move
+    commitChanges();
+
+    // evict glyphs which haven't been used recently; if we had to add pages
+    // beyond the limit, also evict anything that wasn't drawn this frame
+    bool overLimit = pages.size() > maxPages;
+    glyphs.eraseIf([&](const GlyphSize &, GlyphData &glyph) {
+        unsigned age = frame - glyph.lastUsed;
+        if (age <= evictFrames && !(overLimit && age > 0)) {
+            return false;
         }
+        if (glyph.page) {
+            glyph.page->liveArea -= (glyph.region.rect.width + PADDING * 2) *
+                                    (glyph.region.rect.height + PADDING * 2);
+        }
+        ++evictions;
+        return true;
+    });
+    ++frame;
+
+    size_t live = 0, used = 0;
+    for (auto &page : pages) {
+        live += page->liveArea;
+        used += page->usedArea;
+    }
+    if (frame < nextCompaction) {
+        return;
+    }
+    static const size_t PAGE_AREA = CACHE_TEXTURE_SIZE * CACHE_TEXTURE_SIZE;
+    // only shrink back down if what's left will fit; the skyline never packs
+    // a page completely, so leave some slack
+    bool shrinks = live <= maxPages * PAGE_AREA * 0.85;
+    // don't bother compacting until the pages start to fill up
+    bool fragmented = used > PAGE_AREA / 2 && live < used * compactThreshold;
+    if ((overLimit && shrinks) || fragmented) {
+        compact();
+        nextCompaction = frame + compactFrames;
     }
-    FT_Done_Glyph(glyph);
-    return nullptr;
 }
 
-void GlyphCache::createTexture() {
+void GlyphCache::compact() {
+    ProfileZone("GlyphCache::compact");
+    ++compactions;
+    ++generation;
+    engine->window.makeCurrent();
+    for (auto &page : pages) {
+        page->previous = std::move(page->pixelData);
+        page->reset();
+    }
+
+    // repack tallest first, which keeps the skyline flat
+    std::vector<GlyphData *> sorted;
+    sorted.reserve(glyphs.size());
+    glyphs.forEach([&](const GlyphSize &, GlyphData &glyph) {
+        // glyphs which failed to rasterize have no slot
+        if (glyph.page) {
+            sorted.push_back(&glyph);
+        }
+    });
+    std::sort(sorted.begin(), sorted.end(), [](GlyphData *a, GlyphData *b) {
+        return a->region.rect.height > b->region.rect.height;
+    });
+    for (GlyphData *glyph : sorted) {
+        IntRectangle &region = glyph->region.rect;
+        GlyphPage &from = *glyph->page;
+        IntRectangle slot;
+        GlyphPage *to = place(region.width + PADDING * 2,
+                              region.height + PADDING * 2, slot);
+        to->liveArea += slot.width * slot.height;
+        for (int i = 0; i < region.height; ++i) {
+            memcpy(&to->pixelData[(slot.y + PADDING + i) * CACHE_TEXTURE_SIZE +
+                                  slot.x + PADDING],
+                   &from.previous[(region.y + i) * CACHE_TEXTURE_SIZE +
+                                  region.x],
+                   region.width);
+        }
+        region.x = slot.x + PADDING;
+        region.y = slot.y + PADDING;
+        glyph->page = to;
+        glyph->region.img = to->img;
+    }
+
+    // drop the pages that are no longer needed and reupload the rest
+    for (size_t i = pages.size(); i > 0; --i) {
+        GlyphPage &page = *pages[i - 1];
+        if (!page.liveArea) {
+            pages.erase(pages.begin() + i - 1);
+            continue;
+        }
+        page.previous.reset();
+        page.dirty.clear();
+        page.markDirty(IntRectangle(0, 0, CACHE_TEXTURE_SIZE,
+                                    CACHE_TEXTURE_SIZE));
+        page.upload();
+    }
+    AREA_LOG_DEBUG("font", "compacted glyph cache: %zu glyphs on %zu pages",
+                   glyphs.size(), pages.size());
+}
+
+size_t GlyphCache::fontBytes(Font *font) {
+    size_t bytes = 0;
+    glyphs.forEach([&](const GlyphSize &key, GlyphData &glyph) {
+        if (key.fontId == font->id) {
+            // glyph pages have one byte per pixel
+            bytes += (size_t)glyph.region.rect.width * glyph.region.rect.height;
+        }
+    });
+    return bytes;
+}
+
+GlyphCacheStats GlyphCache::stats() {
+    GlyphCacheStats result;
+    result.pages = pages.size();
+    result.glyphs = glyphs.size();
+    size_t live = 0;
+    for (auto &page : pages) {
+        live += page->liveArea;
+    }
+    if (!pages.empty()) {
+        result.occupancy = static_cast<float>(live) /
+                           (pages.size() * CACHE_TEXTURE_SIZE *
+                            static_cast<size_t>(CACHE_TEXTURE_SIZE));
+    }
+    result.evictions = evictions;
+    result.compactions = compactions;
+    return result;
+}
+
+GlyphPage::GlyphPage() {
+    static const int SIZE = GlyphCache::CACHE_TEXTURE_SIZE;
+    if (engine->window.isHeadless()) {
+        // glyphs are still packed and rasterized, but never uploaded
+        img = std::make_shared<ImageData>(0, IntDimensions(SIZE, SIZE));
+        reset();
+        return;
+    }
     engine->window.makeCurrent();
     GLuint textureId;
     glGenTextures(1, &textureId);
     if (!textureId) {
-        AREA_LOG_ERROR("font", "failed to generate texture for GlyphCache");
+        AREA_LOG_ERROR("font", "failed to generate texture for GlyphPage");
     }
-    img = std::make_shared<ImageData>(
-        textureId, IntDimensions(CACHE_TEXTURE_SIZE, CACHE_TEXTURE_SIZE));
-    pixelData = std::make_unique<uint8_t[]>(
-        CACHE_TEXTURE_SIZE * CACHE_TEXTURE_SIZE * BYTES_PER_PIXEL);
+    img = std::make_shared<ImageData>(textureId, IntDimensions(SIZE, SIZE));
+    reset();
+    // allocate the whole texture once; after this only changed regions are
+    // uploaded. The text shader only reads the red channel.
+    glBindTexture(GL_TEXTURE_2D, img->texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, SIZE, SIZE, 0, GL_RED,
+                 GL_UNSIGNED_BYTE, pixelData.get());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    checkForGlErrors("glyph page texture");
 }
 
-void GlyphCache::commitChanges() {
-    engine->window.makeCurrent();
-    if (!pending.empty()) {
-        // iterate over pending glyphs
-        for (auto &it : pending) {
-            Font *font = it.font;
-            FT_Face face = (FT_Face)font->ftFace;
-            GlyphData &glyphData =
-                glyphs[GlyphSize(it.font, it.glyphIndex, it.size, it.border)];
-            FT_Set_Pixel_Sizes(face, it.size, it.size);
-            FT_Load_Glyph(face, it.glyphIndex, FT_LOAD_DEFAULT);
-            FT_Glyph glyph;
-            FT_Get_Glyph(face->glyph, &glyph);
-            if (it.border > 0) {
-                FT_Stroker_Set(stroker, it.border * 64,
-                               FT_STROKER_LINECAP_ROUND,
-                               FT_STROKER_LINEJOIN_ROUND, 0);
-                FT_Glyph_StrokeBorder(&glyph, stroker, false, true);
-            }
-            FT_Glyph_To_Bitmap(&glyph, FT_RENDER_MODE_LIGHT, nullptr, true);
-            FT_BitmapGlyph bitmap = reinterpret_cast<FT_BitmapGlyph>(glyph);
-            for (unsigned int i = 0; i < bitmap->bitmap.rows; ++i) {
-#ifndef __EMSCRIPTEN__
-                memcpy(
-                    &pixelData[(glyphData.region.y() + i) * CACHE_TEXTURE_SIZE +
-                               glyphData.region.x()],
-                    &bitmap->bitmap.buffer[bitmap->bitmap.pitch * i],
-                    bitmap->bitmap.width);
-#else
-                int offset = (glyphData.region.y() + i) * CACHE_TEXTURE_SIZE +
-                             glyphData.region.x();
-                for (int j = 0; j < bitmap->bitmap.width; ++j) {
-                    pixelData[(offset + j) * BYTES_PER_PIXEL + 0] =
-
-                        bitmap->bitmap.buffer[bitmap->bitmap.pitch * i + j];
-                    pixelData[(offset + j) * BYTES_PER_PIXEL + 1] =
-                        pixelData[(offset + j) * BYTES_PER_PIXEL + 2] = 0;
-                    pixelData[(offset + j) * BYTES_PER_PIXEL + 3] = 0xff;
-                }
-#endif
-            }
-            FT_Done_Glyph(glyph);
+void GlyphPage::reset() {
+    static const int SIZE = GlyphCache::CACHE_TEXTURE_SIZE;
+    pixelData = std::make_unique<uint8_t[]>(SIZE * SIZE);
+    skyline.reset(SIZE);
+    liveArea = usedArea = 0;
+}
+
+bool GlyphPage::pack(int width, int height, IntRectangle &slot) {
+    if (!skyline.pack(width, height, slot)) {
+        return false;
+    }
+    usedArea += width * height;
+    return true;
+}
+
+void GlyphPage::markDirty(IntRectangle rect) {
+    // merge with any rect this one touches, as long as that doesn't mean
+    // uploading much more than the two would separately
+    for (size_t i = 0; i < dirty.size();) {
+        IntRectangle &other = dirty[i];
+        IntRectangle joined = rect.join(other);
+        if (rect.overlaps(other) &&
+            joined.width * joined.height <=
+                2 * (rect.width * rect.height + other.width * other.height)) {
+            rect = joined;
+            dirty[i] = dirty.back();
+            dirty.pop_back();
+            // the bigger rect may now touch ones we already passed
+            i = 0;
+        } else {
+            ++i;
         }
-        // upload the texture
-        glBindTexture(GL_TEXTURE_2D, img->texture);
-#ifndef __EMSCRIPTEN__
-        auto mode = GL_RED;
-#else
-        auto mode = GL_RGBA;
-#endif
-        glTexImage2D(GL_TEXTURE_2D, 0, mode, CACHE_TEXTURE_SIZE,
-                     CACHE_TEXTURE_SIZE, 0, mode, GL_UNSIGNED_BYTE,
-                     pixelData.get());
-        glBindTexture(GL_TEXTURE_2D, 0);
-        pending.clear();
     }
+    dirty.push_back(rect);
+}
+
+void GlyphPage::upload() {
+    if (dirty.empty()) {
+        return;
+    }
+    if (engine->window.isHeadless()) {
+        dirty.clear();
+        return;
+    }
+    ProfileZone("GlyphPage::upload");
+    static const int SIZE = GlyphCache::CACHE_TEXTURE_SIZE;
+    glBindTexture(GL_TEXTURE_2D, img->texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, SIZE);
+    for (auto &rect : dirty) {
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, rect.x);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, rect.y);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width,
+                        rect.height, GL_RED, GL_UNSIGNED_BYTE,
+                        pixelData.get());
+    }
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    checkForGlErrors("glyph cache upload");
+    dirty.clear();
 }
 
 template <> bool AssetLoader<Font>::assetIsReady(Font *img) { return true; }
@@ -1,3 +1,4 @@
 declare class FontManager {
     registerFont(name: string, path: string): void;
+    registerSdfFont(name: string, path: string): void;
 }
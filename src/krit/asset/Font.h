@@ -3,13 +3,19 @@
 #if KRIT_ENABLE_TEXT
 
 #include "krit/asset/AssetLoader.h"
-#include "krit/math/Point.h"
-#include "krit/render/ImageRegion.h"
+#include "krit/asset/GlyphTable.h"
+#include "krit/io/FileBytes.h"
+#include "krit/render/Skyline.h"
 #include "krit/utils/Panic.h"
+#include <atomic>
+#include <condition_variable>
 #include <cstddef>
+#include <list>
 #include <memory>
+#include <mutex>
 #include <stdint.h>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -17,72 +23,242 @@ struct hb_blob_t;
 struct hb_face_t;
 struct hb_font_t;
 struct hb_buffer_t;
+struct FT_GlyphRec_;
 
 namespace krit {
 
 struct Font;
 struct ImageData;
+struct FtThreadState;
 
-struct GlyphSize {
-    Font *font;
-    char32_t glyphIndex;
-    unsigned int size;
-    unsigned int border;
-
-    GlyphSize(Font *font, char32_t glyphIndex, unsigned int size,
-              unsigned int border)
-        : font(font), glyphIndex(glyphIndex), size(size), border(border) {}
-    bool operator==(const GlyphSize &other) const {
-        return font == other.font && glyphIndex == other.glyphIndex &&
-               size == other.size && border == other.border;
-    }
-};
+/**
+ * One texture of the glyph cache, with its glyphs packed along a skyline.
+ */
+struct GlyphPage {
+    std::shared_ptr<ImageData> img;
+    // single channel coverage, GlyphCache::CACHE_TEXTURE_SIZE pixels square
+    std::unique_ptr<uint8_t[]> pixelData;
+    // the page's contents before compaction, while glyphs are moved out
+    std::unique_ptr<uint8_t[]> previous;
+    Skyline skyline;
+    // regions of pixelData which have changed since the last upload
+    std::vector<IntRectangle> dirty;
+    // padded area of the glyphs still on this page
+    size_t liveArea = 0;
+    // area packed since the last compaction, including evicted glyphs
+    size_t usedArea = 0;
 
-struct GlyphSizeHash {
-    std::size_t operator()(const GlyphSize &size) const {
-        return std::hash<char32_t>()(size.glyphIndex) ^
-               std::hash<unsigned int>()(size.size) ^
-               std::hash<unsigned int>()(size.border);
-    }
+    GlyphPage();
+
+    bool pack(int width, int height, IntRectangle &slot);
+    void reset();
+    void markDirty(IntRectangle rect);
+    void upload();
 };
 
-struct GlyphData {
-    ImageRegion region;
-    Point offset;
+struct GlyphCacheStats {
+    size_t pages = 0;
+    size_t glyphs = 0;
+    // fraction of all page area holding live glyphs
+    float occupancy = 0;
+    size_t evictions = 0;
+    size_t compactions = 0;
+};
 
-    GlyphData() {}
-    GlyphData(ImageRegion region, float x, float y)
-        : region(region), offset(x, y) {}
+struct FtGlyphDeleter {
+    void operator()(FT_GlyphRec_ *glyph);
 };
 
-struct ColumnData {
-    int width = 0;
-    int height = 0;
+/**
+ * A glyph requested this frame which hasn't been copied into the cache
+ * texture yet. `bitmap` is filled in by whichever thread claims it first,
+ * a worker or the render thread in commitChanges, and stays empty if
+ * rasterizing fails.
+ */
+struct PendingGlyph {
+    Font *font;
+    GlyphSize key;
+    std::unique_ptr<FT_GlyphRec_, FtGlyphDeleter> bitmap;
+    std::atomic<bool> claimed{false};
 
-    ColumnData(int width, int height) : width(width), height(height) {}
+    PendingGlyph(Font *font, GlyphSize key) : font(font), key(key) {}
 };
 
+/**
+ * Rasterized glyphs, packed into as many texture pages as needed.
+ *
+ * Pages are added on demand during a frame, so a lookup never fails for lack
+ * of space. At the end of each frame, glyphs which haven't been requested in
+ * `evictFrames` frames are evicted; if there are more than `maxPages` pages,
+ * anything not drawn in the last frame is evicted too. When evictions leave
+ * the pages fragmented, or free enough space to get back down to `maxPages`,
+ * the remaining glyphs are repacked, at most once every `compactFrames`
+ * frames. Repacking moves glyphs: `generation` changes whenever that
+ * happens, so anything holding on to glyph rects can tell they're stale.
+ */
 struct GlyphCache {
-    static const int SIZE_PRECISION = 32;
     static const int PADDING = 4;
     static const int CACHE_TEXTURE_SIZE = 2048;
 
-    std::unordered_map<GlyphSize, GlyphData, GlyphSizeHash> glyphs;
-    std::vector<ColumnData> columns;
-    std::vector<GlyphSize> pending;
-    std::shared_ptr<ImageData> img;
-    std::unique_ptr<uint8_t[]> pixelData;
+    // pages to shrink back down to at the end of a frame
+    size_t maxPages = 4;
+    // frames a glyph can go unused before it's evicted
+    unsigned evictFrames = 600;
+    // repack once less than this fraction of the packed area is still live
+    float compactThreshold = 0.5;
+    // frames to wait after compacting before compacting again
+    unsigned compactFrames = 60;
+
+    GlyphTable glyphs;
+    std::vector<std::unique_ptr<GlyphPage>> pages;
+    // in request order, which is also the order they're placed in
+    std::vector<std::shared_ptr<PendingGlyph>> pending;
+    // bumped whenever glyph rects change or new glyphs become drawable
+    unsigned generation = 0;
 
     GlyphCache() {}
 
+    /**
+     * Find or request a glyph. With threads enabled, a new glyph is
+     * rasterized on the work queue and has no image until the end of the
+     * frame; it's skipped when drawing until then, so it always appears
+     * exactly one frame after it's first requested.
+     */
     GlyphData *getGlyph(Font *font, char32_t codePoint, unsigned int size,
                         unsigned int border = 0);
-    void createTexture();
+
+    /**
+     * Mark glyphs as used this frame, for text which draws quads it built on
+     * an earlier frame instead of requesting its glyphs again. Returns false
+     * if any of them have been evicted since.
+     */
+    bool touch(const std::vector<GlyphSize> &keys);
+
+    /**
+     * Wait for this frame's glyphs to finish rasterizing, then place them
+     * and upload them. Must be called on the render thread.
+     */
     void commitChanges();
+
+    /**
+     * Evict unused glyphs and compact the pages; called once the frame has
+     * been rendered, when no draw commands refer to glyph rects anymore.
+     */
+    void endFrame();
+
+    GlyphCacheStats stats();
+    /**
+     * Page bytes taken up by glyphs of `font`.
+     */
+    size_t fontBytes(Font *font);
+
+private:
+    unsigned frame = 0;
+    unsigned nextCompaction = 0;
+    size_t evictions = 0;
+    size_t compactions = 0;
+
+    std::mutex rasterizeLock;
+    std::condition_variable rasterized;
+    size_t rasterizing = 0;
+
+    void rasterize(PendingGlyph &glyph);
+    GlyphPage *place(int width, int height, IntRectangle &slot);
+    bool land(PendingGlyph &glyph, GlyphData &data);
+    void compact();
+};
+
+/**
+ * One glyph of shaped text, in font units at the shaping scale (64).
+ */
+struct ShapedGlyph {
+    uint32_t glyphId;
+    // byte offset of the glyph's cluster in the shaped text
+    uint32_t cluster;
+    int32_t xAdvance;
+    int32_t xOffset;
+    int32_t yOffset;
+};
+
+struct ShapeKey {
+    uint32_t fontId;
+    bool ligatures;
+    // hb_script_t, hb_direction_t and hb_language_t
+    uint32_t script;
+    int direction;
+    const void *language;
+    std::string text;
+
+    bool operator==(const ShapeKey &other) const {
+        return fontId == other.fontId && ligatures == other.ligatures &&
+               script == other.script && direction == other.direction &&
+               language == other.language && text == other.text;
+    }
+};
+
+struct ShapeKeyHash {
+    std::size_t operator()(const ShapeKey &key) const {
+        size_t hash = std::hash<std::string>()(key.text);
+        hash ^= std::hash<uint32_t>()(key.fontId) + 0x9e3779b9 + (hash << 6) +
+                (hash >> 2);
+        hash ^= std::hash<const void *>()(key.language) + 0x9e3779b9 +
+                (hash << 6) + (hash >> 2);
+        return hash ^ (key.ligatures ? 1 : 0) ^ (key.script << 1) ^
+               (key.direction << 3);
+    }
+};
+
+/**
+ * Bounded LRU cache of HarfBuzz shaping results.
+ *
+ * Text is shaped a word at a time, splitting at spaces and script changes,
+ * so repeated labels and numbers, and words shared between strings, are only
+ * shaped once. Scripts written without spaces, like Chinese and Japanese,
+ * are split between every character instead. Each segment is shaped with the
+ * script, direction and language HarfBuzz guesses for it. Shaping happens at
+ * a fixed scale, so results are shared across sizes.
+ */
+struct ShapeCache {
+    // maximum number of cached words
+    size_t capacity = 4096;
+    size_t hits = 0;
+    size_t misses = 0;
+
+    ~ShapeCache();
+
+    /**
+     * Shape `text` with `font` and append the glyphs to `out`, with clusters
+     * relative to the start of `text`.
+     */
+    void shape(Font *font, std::string_view text,
+               std::vector<ShapedGlyph> &out);
+
+    size_t size() { return entries.size(); }
+    void clear();
+
+private:
+    using Entry = std::pair<ShapeKey, std::vector<ShapedGlyph>>;
+
+    // a byte range of the text being shaped, and its hb_script_t
+    struct Segment {
+        uint32_t start;
+        uint32_t end;
+        uint32_t script;
+    };
+
+    std::list<Entry> entries;
+    std::unordered_map<ShapeKey, std::list<Entry>::iterator, ShapeKeyHash>
+        index;
+    hb_buffer_t *buffer = nullptr;
+    std::vector<Segment> segments;
+
+    const std::vector<ShapedGlyph> &
+    shapeWord(Font *font, std::string_view word, uint32_t script);
 };
 
 struct FontManager {
-    GlyphCache glyphCache, nextGlyphCache;
+    GlyphCache glyphCache;
+    ShapeCache shapeCache;
     std::unordered_map<std::string, std::shared_ptr<Font>> fontRegistry;
 
     FontManager();
@@ -91,6 +267,8 @@ struct FontManager {
     void commit();
     void flush();
     std::shared_ptr<Font> registerFont(const std::string &name, const std::string &path);
+    std::shared_ptr<Font> registerSdfFont(const std::string &name,
+                                          const std::string &path);
 
     std::shared_ptr<Font> getFont(const std::string &name) {
         auto font = fontRegistry[name];
@@ -105,10 +283,11 @@ struct FontManager {
 };
 
 struct Font {
-    Font(const std::string &path, const std::string &fontData);
-    Font() {}
+    Font(const std::string &path, FileBytes fontData);
+    Font();
     ~Font();
     Font(Font &&other) {
+        this->id = other.id;
         this->face = other.face;
         this->font = other.font;
         this->ftFace = other.ftFace;
@@ -119,7 +298,29 @@ struct Font {
         other.ftFace = nullptr;
     }
 
+    // pixel size SDF glyphs are rasterized at, whatever size they're drawn
+    static const int SDF_SIZE = 48;
+    // distance in SDF pixels covered by the field on either side of an edge;
+    // also the thickest border an SDF font can draw, at SDF_SIZE
+    static const int SDF_SPREAD = 8;
+
+    /**
+     * Whether this build of FreeType can render signed distance fields.
+     */
+    static bool sdfSupported();
+
+    /**
+     * Distance field value at `outset` SDF pixels outside the glyph's edge.
+     */
+    static float sdfThreshold(float outset);
+
     bool ligatures = true;
+    // unique for the life of the process; identifies the font in caches
+    uint32_t id;
+    // rasterize glyphs once as signed distance fields and scale them in the
+    // shader, rather than rasterizing each size separately. Set this before
+    // drawing any text with the font.
+    bool sdf = false;
 
     std::string path;
     void shape(hb_buffer_t *buf);
@@ -131,7 +332,9 @@ private:
     hb_face_t *face = nullptr;
     hb_font_t *font = nullptr;
     void *ftFace = nullptr;
-    std::string fontData;
+    FileBytes fontData;
+    friend struct AssetLoader<Font>;
+    friend struct FtThreadState;
     friend struct GlyphCache;
     friend struct Text;
     friend struct TextParser;
@@ -0,0 +1,77 @@
+#include "krit/asset/GlyphTable.h"
+
+namespace krit {
+
+GlyphData *GlyphTable::find(const GlyphSize &key) {
+    if (slots.empty()) {
+        return nullptr;
+    }
+    for (size_t i = GlyphSizeHash()(key) & mask();; i = (i + 1) & mask()) {
+        Slot &slot = slots[i];
+        if (!slot.data) {
+            return nullptr;
+        }
+        if (slot.key == key) {
+            return slot.data;
+        }
+    }
+}
+
+GlyphData &GlyphTable::insert(const GlyphSize &key) {
+    // keep the load factor at or below 3/4
+    if ((count + 1) * 4 > slots.size() * 3) {
+        grow();
+    }
+    GlyphData *data;
+    if (freeData.empty()) {
+        data = &pool.emplace_back();
+    } else {
+        data = freeData.back();
+        freeData.pop_back();
+    }
+    size_t i = GlyphSizeHash()(key) & mask();
+    while (slots[i].data) {
+        i = (i + 1) & mask();
+    }
+    slots[i].key = key;
+    slots[i].data = data;
+    ++count;
+    return *data;
+}
+
+void GlyphTable::grow() {
+    std::vector<Slot> old = std::move(slots);
+    slots.clear();
+    slots.resize(old.empty() ? 256 : old.size() * 2);
+    for (auto &slot : old) {
+        if (slot.data) {
+            size_t i = GlyphSizeHash()(slot.key) & mask();
+            while (slots[i].data) {
+                i = (i + 1) & mask();
+            }
+            slots[i] = slot;
+        }
+    }
+}
+
+void GlyphTable::erase(size_t index) {
+    *slots[index].data = GlyphData();
+    freeData.push_back(slots[index].data);
+    slots[index].data = nullptr;
+    --count;
+    // shift back any following entries that would no longer be reachable
+    // through the gap, so lookups can stop at the first empty slot
+    size_t gap = index;
+    for (size_t i = (index + 1) & mask(); slots[i].data;
+         i = (i + 1) & mask()) {
+        size_t home = GlyphSizeHash()(slots[i].key) & mask();
+        // distance from its home slot to the gap vs. to its current slot
+        if (((gap - home) & mask()) < ((i - home) & mask())) {
+            slots[gap] = slots[i];
+            slots[i].data = nullptr;
+            gap = i;
+        }
+    }
+}
+
+}
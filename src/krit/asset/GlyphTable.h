@@ -0,0 +1,124 @@
+#ifndef KRIT_ASSET_GLYPH_TABLE
+#define KRIT_ASSET_GLYPH_TABLE
+
+#include "krit/math/Point.h"
+#include "krit/render/ImageRegion.h"
+#include <cstddef>
+#include <deque>
+#include <stdint.h>
+#include <tuple>
+#include <vector>
+
+namespace krit {
+
+struct GlyphPage;
+
+/**
+ * A glyph at one size. Fonts are identified by Font::id, as in ShapeKey, so
+ * a key never matches a new font allocated where a destroyed one was.
+ */
+struct GlyphSize {
+    uint32_t fontId;
+    char32_t glyphIndex;
+    unsigned int size;
+    unsigned int border;
+
+    GlyphSize(uint32_t fontId, char32_t glyphIndex, unsigned int size,
+              unsigned int border)
+        : fontId(fontId), glyphIndex(glyphIndex), size(size), border(border) {}
+    bool operator==(const GlyphSize &other) const {
+        return fontId == other.fontId && glyphIndex == other.glyphIndex &&
+               size == other.size && border == other.border;
+    }
+};
+
+struct GlyphSizeLess {
+    bool operator()(const GlyphSize &a, const GlyphSize &b) const {
+        return std::tie(a.fontId, a.glyphIndex, a.size, a.border) <
+               std::tie(b.fontId, b.glyphIndex, b.size, b.border);
+    }
+};
+
+struct GlyphSizeHash {
+    std::size_t operator()(const GlyphSize &size) const {
+        uint64_t hash = (uint64_t)size.fontId << 32 | size.glyphIndex;
+        hash = hash * 0x9e3779b97f4a7c15ull ^
+               ((uint64_t)size.size << 32 | size.border);
+        // murmur3 finalizer, so the low bits depend on every field
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+        return hash;
+    }
+};
+
+struct GlyphData {
+    ImageRegion region;
+    Point offset;
+    GlyphPage *page = nullptr;
+    // frame this glyph was last requested on
+    unsigned lastUsed = 0;
+
+    GlyphData() {}
+    GlyphData(ImageRegion region, float x, float y)
+        : region(region), offset(x, y) {}
+};
+
+/**
+ * Maps GlyphSize to GlyphData with open addressing and linear probing, so a
+ * lookup is usually a single cache line. The GlyphData itself lives in a
+ * separate pool, so pointers to it stay valid until the glyph is erased.
+ */
+struct GlyphTable {
+    GlyphData *find(const GlyphSize &key);
+
+    /**
+     * Add an entry for `key`, which must not already be present.
+     */
+    GlyphData &insert(const GlyphSize &key);
+
+    size_t size() { return count; }
+
+    template <typename F> void forEach(F &&f) {
+        for (auto &slot : slots) {
+            if (slot.data) {
+                f(slot.key, *slot.data);
+            }
+        }
+    }
+
+    /**
+     * Erase every entry for which `pred(key, data)` is true.
+     */
+    template <typename F> void eraseIf(F &&pred) {
+        for (size_t i = 0; i < slots.size();) {
+            Slot &slot = slots[i];
+            if (slot.data && pred(slot.key, *slot.data)) {
+                // the next entry may have shifted into this slot
+                erase(i);
+            } else {
+                ++i;
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        GlyphSize key{0, 0, 0, 0};
+        // null if empty
+        GlyphData *data = nullptr;
+    };
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+    std::deque<GlyphData> pool;
+    std::vector<GlyphData *> freeData;
+
+    size_t mask() { return slots.size() - 1; }
+    void grow();
+    void erase(size_t index);
+};
+
+}
+
+#endif
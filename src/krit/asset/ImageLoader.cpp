@@ -1,21 +1,33 @@
 #include "krit/Engine.h"
 #include "krit/TaskManager.h"
 #include "krit/asset/AssetLoader.h"
+#include "krit/asset/ImageLoader.h"
+#include "krit/asset/Ktx2.h"
 #include "krit/io/Io.h"
 #include "krit/math/Dimensions.h"
 #include "krit/render/Gl.h"
 #include "krit/render/ImageData.h"
+#include "krit/render/Premultiply.h"
+#include "krit/render/RuntimeAtlas.h"
+#include "krit/render/TextureUploader.h"
 #include "krit/utils/Log.h"
-#include "krit/utils/Panic.h"
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_pixels.h>
 #include <SDL3/SDL_surface.h>
 #include <SDL3_image/SDL_image.h>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <filesystem>
 #include <jpeglib.h>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <png.h>
+#include <shared_mutex>
 #include <string>
+#include <unordered_map>
+#include <zlib.h>
 
 namespace krit {
 
@@ -51,84 +63,470 @@ static std::unordered_map<std::string, std::vector<ImageResolutionInfo>>
     resolutions{
         {".png", {{".720.png", 720}, {".1080.png", 1080}, {".png", 2160}}},
         {".jpg", {{".720.jpg", 720}, {".1080.jpg", 1080}, {".jpg", 2160}}},
+        {".ktx2",
+         {{".720.ktx2", 720}, {".1080.ktx2", 1080}, {".ktx2", 2160}}},
     };
 
-struct ImageSize {
-    int resolution;
-    std::string path;
+struct CompressedVariant {
+    const char *extension;
+    GLenum format;
+};
 
-    ImageSize(int resolution, const char *s)
-        : resolution(resolution), path(s) {}
+// precompressed siblings of a PNG/JPEG, e.g. foo.1080.bc7.ktx2 for
+// foo.1080.png, in order of preference
+static const CompressedVariant compressedVariants[] = {
+    {".bc7.ktx2", GL_COMPRESSED_RGBA_BPTC_UNORM},
+    {".astc.ktx2", GL_COMPRESSED_RGBA_ASTC_4x4_KHR},
+    {".etc2.ktx2", GL_COMPRESSED_RGBA8_ETC2_EAC},
+    {".bc3.ktx2", GL_COMPRESSED_RGBA_S3TC_DXT5_EXT},
+    {".bc1.ktx2", GL_COMPRESSED_RGBA_S3TC_DXT1_EXT},
 };
 
-struct ImageInfo {
-    IntDimensions dimensions;
-    std::vector<ImageSize> sizes;
+static bool isCpuDecodable(GLenum format) {
+    return format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ||
+           format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+}
+
+static bool hasSuffix(const std::string &s, const char *suffix) {
+    size_t length = strlen(suffix);
+    return s.size() >= length &&
+           !s.compare(s.size() - length, length, suffix);
+}
 
-    ImageInfo(int w, int h, std::vector<ImageSize> &&sizes)
-        : dimensions(w, h), sizes(sizes) {}
+/**
+ * Find the best precompressed variant of `tier`: first one the driver can
+ * sample directly, then one we can decode on the CPU. If the image manifest
+ * lists the tier, only the siblings it lists are considered; otherwise each
+ * candidate is looked for in the asset roots.
+ */
+static std::optional<std::filesystem::path>
+findCompressedVariant(const ImageTier &tier) {
+    auto engine = krit::engine;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (auto &variant : compressedVariants) {
+            bool usable =
+                pass == 0 ? engine->renderer.supportsCompressedFormat(
+                                variant.format)
+                          : isCpuDecodable(variant.format);
+            if (!usable) {
+                continue;
+            }
+            if (tier.file) {
+                for (auto &sibling : tier.compressed) {
+                    if (hasSuffix(sibling.path.string(), variant.extension)) {
+                        return sibling.path;
+                    }
+                }
+                continue;
+            }
+            std::filesystem::path variantPath = tier.path;
+            variantPath.replace_extension();
+            variantPath += variant.extension;
+            if (engine->io->exists(variantPath)) {
+                return variantPath;
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+/**
+ * Whether a precompressed variant can be sampled by the driver as is.
+ */
+static bool isNativeVariant(const std::filesystem::path &path) {
+    std::string s = path.string();
+    for (auto &variant : compressedVariants) {
+        if (hasSuffix(s, variant.extension)) {
+            return krit::engine->renderer.supportsCompressedFormat(
+                variant.format);
+        }
+    }
+    return false;
+}
+
+/**
+ * Texture memory of an RGBA8 image plus a full mip chain, once it's built.
+ */
+static size_t rgbaBytes(const IntDimensions &size) {
+    return (size_t)size.x * size.y * 4 * 4 / 3;
+}
+
+/**
+ * Parse a KTX2 file and check that the device can use it, either natively or
+ * by decoding it on the CPU.
+ */
+static bool parseKtx2(const std::filesystem::path &pathToLoad,
+                      const FileBytes &s, Ktx2Image &ktx,
+                      ImageTextureInfo &info) {
+    if (!ktx.parse(s.view(), pathToLoad.c_str())) {
+        return false;
+    }
+    bool native = krit::engine->renderer.supportsCompressedFormat(ktx.glFormat);
+    if (!native && !ktx.canDecode()) {
+        LOG_ERROR("compressed texture format %u isn't supported by this "
+                  "device: %s",
+                  ktx.vkFormat, pathToLoad.c_str());
+        return false;
+    }
+    info.size.setTo(ktx.width, ktx.height);
+    if (native) {
+        info.compressed = true;
+        info.gpuBytes = ktx.byteSize();
+    } else {
+        // decode the base level on the CPU and treat it like any other RGBA8
+        // image; mipmaps will be generated by the renderer on demand
+        info.gpuBytes = rgbaBytes(info.size);
+    }
+    return true;
+}
+
+/**
+ * Create a texture from a natively supported KTX2 file. Must be called on the
+ * render thread.
+ */
+static GLuint uploadKtx2(const std::filesystem::path &pathToLoad,
+                         const Ktx2Image &ktx, const FileBytes &s) {
+    LOG_DEBUG("callback: load compressed image %s", pathToLoad.c_str());
+    GLuint texture;
+    glActiveTexture(GL_TEXTURE0);
+    checkForGlErrors("active texture");
+    glGenTextures(1, &texture);
+    if (!texture) {
+        LOG_ERROR("failed to generate texture for image %s",
+                  pathToLoad.c_str());
+    }
+    checkForGlErrors("gen textures");
+    glBindTexture(GL_TEXTURE_2D, texture);
+    checkForGlErrors("bind texture");
+    for (size_t i = 0; i < ktx.levels.size(); ++i) {
+        auto &level = ktx.levels[i];
+        glCompressedTexImage2D(GL_TEXTURE_2D, i, ktx.glFormat, level.width,
+                               level.height, 0, level.length,
+                               s.data() + level.offset);
+        checkForGlErrors("compressedTexImage2D");
+    }
+    // the file's mip chain is the whole chain; don't sample past it
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, ktx.levels.size() - 1);
+    checkForGlErrors("asset load");
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+/**
+ * Wrap the decoded base level of a KTX2 file in an RGBA8 upload.
+ */
+static TextureUpload ktx2Upload(const Ktx2Image &ktx, uint8_t *pixels) {
+    TextureUpload upload;
+    upload.pixels = pixels;
+    upload.width = ktx.width;
+    upload.height = ktx.height;
+    upload.release = [pixels]() { delete[] pixels; };
+    return upload;
+}
+
+static bool loadKtx2(const std::filesystem::path &pathToLoad,
+                     ImageTextureInfo &info,
+                     std::function<void(GLuint)> &onUpload) {
+    auto engine = krit::engine;
+    FileBytes s = engine->io->readBytes(pathToLoad.c_str());
+    Ktx2Image ktx;
+    if (!parseKtx2(pathToLoad, s, ktx, info)) {
+        return false;
+    }
+
+    if (info.compressed) {
+        engine->taskManager->pushRender([=, s = std::move(s),
+                                         onUpload = std::move(onUpload)]() {
+            engine->window.makeCurrent();
+            onUpload(uploadKtx2(pathToLoad, ktx, s));
+        });
+    } else {
+        engine->taskManager->push([=, s = std::move(s),
+                                   onUpload = std::move(onUpload)]() mutable {
+            LOG_DEBUG("decode compressed image %s", pathToLoad.c_str());
+            uint8_t *pixels = ktx.decode(s.view(), 0);
+            if (!pixels) {
+                LOG_ERROR("failed to decode compressed image %s",
+                          pathToLoad.c_str());
+                engine->taskManager->pushRender([=]() { onUpload(0); });
+                return;
+            }
+            engine->taskManager->pushRender([=]() {
+                engine->window.makeCurrent();
+                TextureUpload upload = ktx2Upload(ktx, pixels);
+                upload.onComplete = onUpload;
+                engine->renderer.uploader.upload(std::move(upload));
+            });
+        });
+    }
+    return true;
+}
+
+/**
+ * Image manifests, as written by tools/asset_registry. All integers are
+ * little endian:
+ *
+ *   ImageManifestHeader
+ *   ImageManifestImage[imageCount]
+ *   ImageManifestFile[fileCount]
+ *   keys and paths, not terminated
+ *
+ * Each image's files are contiguous and sorted by resolution, and each
+ * precompressed sibling follows the tier it was made from.
+ */
+struct ImageManifestHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t imageCount;
+    uint32_t fileCount;
 };
 
-template <>
-std::shared_ptr<ImageData>
-AssetLoader<ImageData>::loadAsset(const std::string &key) {
-    std::shared_ptr<ImageData> img = std::make_shared<ImageData>();
+struct ImageManifestImage {
+    uint32_t keyOffset;
+    uint32_t keyLength;
+    uint32_t firstFile;
+    uint32_t fileCount;
+};
 
-    std::filesystem::path path = key;
-    std::string extension = path.extension().string();
+struct ImageManifestFile {
+    uint32_t crc;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+    uint32_t resolution;
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;
+    uint32_t flags;
+};
+
+static_assert(sizeof(ImageManifestHeader) == 16,
+              "unexpected ImageManifestHeader layout");
+static_assert(sizeof(ImageManifestImage) == 16,
+              "unexpected ImageManifestImage layout");
+static_assert(sizeof(ImageManifestFile) == 32,
+              "unexpected ImageManifestFile layout");
+
+enum ImageManifestFlags : uint32_t {
+    ImageFilePremultiplied = 1,
+    ImageFileSibling = 2,
+};
+
+static const char IMAGE_MANIFEST_MAGIC[4] = {'K', 'I', 'M', 'G'};
+static const uint32_t IMAGE_MANIFEST_VERSION = 1;
+static const char *DEFAULT_IMAGE_MANIFEST = "images.manifest";
+
+// every file of each image the manifest lists, by asset key
+static std::unordered_map<std::string, std::vector<ImageFileInfo>>
+    imageManifest;
+static std::shared_mutex imageManifestLock;
+static std::once_flag imageManifestInit;
+static std::atomic<bool> imageManifestParsed{false};
 
+bool ImageLoader::premultiplyAlpha = false;
+
+bool ImageLoader::parseManifest(const std::string &path) {
+    imageManifestParsed = true;
     auto engine = krit::engine;
-    int windowHeight = engine->window.y;
+    if (!engine->io->exists(path)) {
+        if (path != DEFAULT_IMAGE_MANIFEST) {
+            LOG_ERROR("image manifest not found: %s", path.c_str());
+        }
+        return false;
+    }
+    FileBytes bytes = engine->io->readBytes(path);
+    const char *data = bytes.data();
+    ImageManifestHeader header;
+    if (bytes.size() < sizeof(header)) {
+        LOG_ERROR("not an image manifest: %s", path.c_str());
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, IMAGE_MANIFEST_MAGIC,
+               sizeof(IMAGE_MANIFEST_MAGIC))) {
+        LOG_ERROR("not an image manifest: %s", path.c_str());
+        return false;
+    }
+    if (header.version != IMAGE_MANIFEST_VERSION) {
+        LOG_ERROR("unsupported image manifest version %u: %s",
+                  header.version, path.c_str());
+        return false;
+    }
+    size_t imagesOffset = sizeof(header);
+    size_t filesOffset =
+        imagesOffset + header.imageCount * sizeof(ImageManifestImage);
+    size_t stringsOffset =
+        filesOffset + header.fileCount * sizeof(ImageManifestFile);
+    if (stringsOffset > bytes.size()) {
+        LOG_ERROR("corrupt image manifest: %s", path.c_str());
+        return false;
+    }
+    std::string_view strings(data + stringsOffset,
+                             bytes.size() - stringsOffset);
+
+    std::unordered_map<std::string, std::vector<ImageFileInfo>> images;
+    images.reserve(header.imageCount);
+    for (size_t i = 0; i < header.imageCount; ++i) {
+        ImageManifestImage image;
+        memcpy(&image, data + imagesOffset + i * sizeof(image),
+               sizeof(image));
+        if ((size_t)image.keyOffset + image.keyLength > strings.size() ||
+            (size_t)image.firstFile + image.fileCount > header.fileCount) {
+            LOG_ERROR("corrupt image manifest: %s", path.c_str());
+            return false;
+        }
+        std::vector<ImageFileInfo> &files =
+            images[std::string(strings.substr(image.keyOffset,
+                                              image.keyLength))];
+        for (size_t j = 0; j < image.fileCount; ++j) {
+            ImageManifestFile file;
+            memcpy(&file,
+                   data + filesOffset +
+                       (image.firstFile + j) * sizeof(file),
+                   sizeof(file));
+            if ((size_t)file.pathOffset + file.pathLength > strings.size() ||
+                file.format > ImageKtx2) {
+                LOG_ERROR("corrupt image manifest: %s", path.c_str());
+                return false;
+            }
+            ImageFileInfo &info = files.emplace_back();
+            info.path = strings.substr(file.pathOffset, file.pathLength);
+            info.resolution = file.resolution;
+            info.size.setTo(file.width, file.height);
+            info.format = (ImageFileFormat)file.format;
+            info.premultiplied = file.flags & ImageFilePremultiplied;
+            info.sibling = file.flags & ImageFileSibling;
+            info.crc = file.crc;
+        }
+    }
+
+    AREA_LOG_INFO("asset", "loaded image manifest %s: %zu images",
+                  path.c_str(), images.size());
+    std::unique_lock<std::shared_mutex> guard(imageManifestLock);
+    imageManifest = std::move(images);
+    return true;
+}
 
-    ImageResolutionInfo *found = nullptr;
-    std::filesystem::path pathToLoad;
-    std::filesystem::path foundArchive;
-    for (auto &res : resolutions[extension]) {
-        if ((!found || res.resolution >= windowHeight)) {
-            pathToLoad = path;
-            pathToLoad.replace_extension();
-            pathToLoad += res.extension;
-            auto foundAsset = engine->io->find(pathToLoad);
-            if (foundAsset) {
-                found = &res;
-                foundArchive = std::move(*foundAsset);
-                if (res.resolution >= windowHeight) {
-                    break;
+/**
+ * Copy out the files the image manifest lists for `key`, loading the default
+ * manifest first if nothing has been loaded yet.
+ */
+static std::optional<std::vector<ImageFileInfo>>
+findManifestFiles(const std::string &key) {
+    std::call_once(imageManifestInit, []() {
+        if (!imageManifestParsed) {
+            ImageLoader::parseManifest(DEFAULT_IMAGE_MANIFEST);
+        }
+    });
+    std::shared_lock<std::shared_mutex> guard(imageManifestLock);
+    auto found = imageManifest.find(key);
+    if (found == imageManifest.end()) {
+        return std::nullopt;
+    }
+    return found->second;
+}
+
+std::vector<ImageTier> ImageLoader::findTiers(const std::string &key,
+                                              int targetHeight) {
+    std::vector<ImageTier> tiers;
+    if (auto files = findManifestFiles(key)) {
+        for (auto &file : *files) {
+            if (file.sibling) {
+                if (!tiers.empty()) {
+                    tiers.back().compressed.push_back(file);
                 }
+                continue;
+            }
+            if (targetHeight && !tiers.empty() &&
+                tiers.back().resolution >= targetHeight) {
+                break;
+            }
+            ImageTier &tier = tiers.emplace_back();
+            tier.resolution = file.resolution;
+            tier.path = file.path;
+#ifdef __EMSCRIPTEN__
+            // emscripten loads images by path, so it needs to know the root
+            if (auto archive = engine->io->find(file.path)) {
+                tier.archive = std::move(*archive);
             }
+#endif
+            tier.file = file;
         }
+        return tiers;
     }
-    if (!found) {
-        LOG_ERROR("Couldn't find a valid resolution for image: %s",
-                  key.c_str());
-        return img;
+
+    std::filesystem::path path = key;
+    auto found = resolutions.find(path.extension().string());
+    if (found == resolutions.end()) {
+        return tiers;
     }
+    for (auto &res : found->second) {
+        std::filesystem::path pathToLoad = path;
+        pathToLoad.replace_extension();
+        pathToLoad += res.extension;
+        auto foundAsset = engine->io->find(pathToLoad);
+        if (foundAsset) {
+            tiers.push_back(ImageTier{res.resolution, std::move(pathToLoad),
+                                      std::move(*foundAsset)});
+            if (targetHeight && res.resolution >= targetHeight) {
+                break;
+            }
+        }
+    }
+    return tiers;
+}
 
-    pathToLoad = path;
-    pathToLoad.replace_extension();
-    pathToLoad += found->extension;
+bool ImageLoader::loadTexture(const ImageTier &tier, ImageTextureInfo &info,
+                              std::function<void(GLuint)> &&onUpload) {
+    const std::filesystem::path &pathToLoad = tier.path;
+    std::string extension = pathToLoad.extension().string();
 
-    float scale = found->resolution / 2160.0;
+    if (extension == ".ktx2") {
+        return loadKtx2(pathToLoad, info, onUpload);
+    }
+    if (auto compressedPath = findCompressedVariant(tier)) {
+        if (loadKtx2(*compressedPath, info, onUpload)) {
+            return true;
+        }
+    }
 
-    std::string s = engine->io->readFile(pathToLoad.c_str());
+    return loadPixels(tier, info,
+                      [onUpload = std::move(onUpload)](TextureUpload &&upload) {
+                          if (!upload.pixels) {
+                              onUpload(0);
+                              return;
+                          }
+                          upload.onComplete = onUpload;
+                          krit::engine->renderer.uploader.upload(
+                              std::move(upload));
+                      });
+}
 
-    const char *imgType;
+/**
+ * Read the pixel size of a PNG or JPEG from its header. `imgType` is set to
+ * the name SDL_image knows the format by.
+ */
+static bool readImageHeader(const std::filesystem::path &pathToLoad,
+                            const FileBytes &s, const char *&imgType,
+                            ImageTextureInfo &info) {
+    std::string extension = pathToLoad.extension().string();
     if (extension == ".png") {
         imgType = "PNG";
         // use libpng to get the dimensions
         png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING,
                                                      nullptr, nullptr, nullptr);
         if (!png_ptr) {
-            LOG_ERROR("Failed to initialize PNG read struct: %s", key.c_str());
-            return img;
+            LOG_ERROR("Failed to initialize PNG read struct: %s",
+                      pathToLoad.c_str());
+            return false;
         }
         png_infop info_ptr = png_create_info_struct(png_ptr);
         if (!info_ptr) {
             png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
-            LOG_ERROR("Failed to initialize PNG info struct: %s", key.c_str());
-            return img;
+            LOG_ERROR("Failed to initialize PNG info struct: %s",
+                      pathToLoad.c_str());
+            return false;
         }
-        PngData png{.data = s.c_str(), .length = s.size()};
+        PngData png{.data = s.data(), .length = s.size()};
         png_set_read_fn(png_ptr, &png, png_read_custom);
         png_read_info(png_ptr, info_ptr);
         png_uint_32 width, height;
@@ -137,118 +535,573 @@ AssetLoader<ImageData>::loadAsset(const std::string &key) {
                          nullptr, nullptr, nullptr);
         if (ret != 1) {
             png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
-            LOG_ERROR("Failed to read PNG header: %s", key.c_str());
-            return img;
+            LOG_ERROR("Failed to read PNG header: %s", pathToLoad.c_str());
+            return false;
         }
-        // printf("%s: %u x %u\n", pathToLoad.c_str(), width, height);
-        img->dimensions.setTo(width / scale, height / scale);
+        info.size.setTo(width, height);
         png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
     } else if (extension == ".jpg") {
         imgType = "JPEG";
         // use libjpeg to get the dimensions
-        static jpeg_error_mgr jerr;
+        jpeg_error_mgr jerr;
         jpeg_std_error(&jerr);
         struct jpeg_decompress_struct cinfo;
         cinfo.err = &jerr;
         jpeg_create_decompress(&cinfo);
-        jpeg_mem_src(&cinfo, (const unsigned char *)(void *)s.c_str(),
+        jpeg_mem_src(&cinfo, (const unsigned char *)(void *)s.data(),
                      s.size());
         int ret = jpeg_read_header(&cinfo, TRUE);
         if (ret != JPEG_HEADER_OK) {
             jpeg_destroy_decompress(&cinfo);
-            LOG_ERROR("Failed to read JPEG header: %s", key.c_str());
-            return img;
+            LOG_ERROR("Failed to read JPEG header: %s", pathToLoad.c_str());
+            return false;
         }
-        img->dimensions.setTo(cinfo.image_width / scale,
-                              cinfo.image_height / scale);
+        info.size.setTo(cinfo.image_width, cinfo.image_height);
         jpeg_destroy_decompress(&cinfo);
     } else {
-        LOG_ERROR("Unrecognized image extension for image: %s", key.c_str());
-        return img;
+        LOG_ERROR("Unrecognized image extension for image: %s",
+                  pathToLoad.c_str());
+        return false;
     }
 
-    img->scale = scale;
+    info.gpuBytes = rgbaBytes(info.size);
+    return true;
+}
+
+/**
+ * Fill in what the image manifest says about `tier` instead of reading its
+ * header. Compressed files are assumed to use a byte per texel until they're
+ * actually loaded. A tier that's a KTX2 file itself is assumed to be sampled
+ * directly, as its format isn't known until it's parsed; if it's decoded on
+ * the CPU instead it just gets a texture of its own rather than an atlas slot.
+ */
+static void manifestInfo(const ImageTier &tier, ImageTextureInfo &info) {
+    info.size = tier.file->size;
+    info.gpuBytes = rgbaBytes(info.size);
+    if (tier.file->format == ImageKtx2) {
+        info.compressed = true;
+    } else if (auto variant = findCompressedVariant(tier)) {
+        info.compressed = isNativeVariant(*variant);
+    }
+    if (info.compressed) {
+        info.gpuBytes /= 4;
+    }
+}
+
+/**
+ * In development builds, warn if a file listed by the image manifest has
+ * changed since the manifest was written.
+ */
+static void checkManifestCrc(const ImageTier &tier,
+                             const std::filesystem::path &path,
+                             const FileBytes &s) {
+#if !KRIT_RELEASE
+    if (!tier.file) {
+        return;
+    }
+    const ImageFileInfo *file = nullptr;
+    if (tier.file->path == path) {
+        file = &*tier.file;
+    }
+    for (auto &sibling : tier.compressed) {
+        if (sibling.path == path) {
+            file = &sibling;
+        }
+    }
+    if (file &&
+        crc32(0, (const Bytef *)s.data(), s.size()) != file->crc) {
+        AREA_LOG_WARN("asset",
+                      "%s has changed since the image manifest was written",
+                      path.c_str());
+    }
+#else
+    (void)tier;
+    (void)path;
+    (void)s;
+#endif
+}
 
+/**
+ * Decode a PNG or JPEG on the calling thread. Anything with more than one
+ * byte per pixel is converted to RGBA8 here, using SDL's vectorized blitters,
+ * so that neither the driver nor the runtime atlas has to swizzle it on the
+ * render thread, and premultiplied if ImageLoader::premultiplyAlpha is set.
+ * Returns null on failure.
+ */
+static SDL_Surface *decodeImage(const ImageTier &tier, const FileBytes &s,
+                                const char *imgType) {
+    const std::filesystem::path &pathToLoad = tier.path;
+    LOG_DEBUG("load image %s", pathToLoad.c_str());
 #ifdef __EMSCRIPTEN__
     // emscripten loads images by path
+    (void)s;
     (void)imgType;
-    engine->taskManager->push(
-        [=, pathToLoad = std::move(pathToLoad)]() mutable {
-            LOG_DEBUG("load image %s", pathToLoad.c_str());
-            auto fullPathToLoad = foundArchive / pathToLoad;
-            SDL_Surface *surface = IMG_Load(fullPathToLoad.c_str());
-            if (!surface) {
-                panic("IMG_Load(%s) failed: %s", fullPathToLoad.c_str(),
-                      IMG_GetError());
-            }
+    auto fullPathToLoad = tier.archive / pathToLoad;
+    SDL_Surface *surface = IMG_Load(fullPathToLoad.c_str());
 #else
-    engine->taskManager->push([=, pathToLoad = std::move(pathToLoad),
-                                 s = std::move(s)]() mutable {
-        LOG_DEBUG("load image %s", pathToLoad.c_str());
-        SDL_IOStream *rw = SDL_IOFromConstMem(s.c_str(), s.size());
-        SDL_Surface *surface = IMG_LoadTyped_IO(rw, 0, imgType);
-        if (!surface) {
-            panic("IMG_Load(%s) failed", pathToLoad.c_str());
-        }
-        img->dimensions.setTo(surface->w / img->scale, surface->h / img->scale);
-        SDL_CloseIO(rw);
+    SDL_IOStream *rw = SDL_IOFromConstMem(s.data(), s.size());
+    SDL_Surface *surface = IMG_LoadTyped_IO(rw, 0, imgType);
+    SDL_CloseIO(rw);
 #endif
-            auto format = SDL_GetPixelFormatDetails(surface->format);
-            bool hasAlpha = format->Amask;
-            unsigned int mode;
-            if (hasAlpha) {
-                if (format->Rmask == 0x000000ff) {
-                    mode = GL_RGBA;
-                } else {
-                    mode = GL_BGRA;
-                }
-            } else if (format->bytes_per_pixel == 1) {
-                mode = GL_RED;
-            } else {
-                if (format->Rmask == 0x0000ff) {
-                    mode = GL_RGB;
-                } else {
-                    mode = GL_BGR;
-                }
-            }
+    if (!surface) {
+        LOG_ERROR("IMG_Load(%s) failed: %s", pathToLoad.c_str(),
+                  SDL_GetError());
+        return nullptr;
+    }
+    auto format = SDL_GetPixelFormatDetails(surface->format);
+    if (surface->format != SDL_PIXELFORMAT_RGBA32 &&
+        format->bytes_per_pixel > 1) {
+        SDL_Surface *converted =
+            SDL_ConvertSurface(surface, SDL_PIXELFORMAT_RGBA32);
+        SDL_DestroySurface(surface);
+        if (!converted) {
+            LOG_ERROR("failed to convert %s to RGBA: %s", pathToLoad.c_str(),
+                      SDL_GetError());
+        }
+        surface = converted;
+    }
+    if (surface && surface->format == SDL_PIXELFORMAT_RGBA32 &&
+        ImageLoader::premultiplyAlpha &&
+        !(tier.file && tier.file->premultiplied)) {
+        premultiplyAlpha(static_cast<uint8_t *>(surface->pixels), surface->w,
+                         surface->h, surface->pitch);
+    }
+    return surface;
+}
 
-            engine->taskManager->pushRender([=]() {
-                engine->window.makeCurrent();
-                LOG_DEBUG("callback: load image %s", pathToLoad.c_str());
-                // upload texture
-                GLuint texture;
-                glActiveTexture(GL_TEXTURE0);
-                checkForGlErrors("active texture");
-                glGenTextures(1, &texture);
-                if (!texture) {
-                    LOG_ERROR("failed to generate texture for image %s",
-                              pathToLoad.c_str());
-                }
-                checkForGlErrors("gen textures");
-                glBindTexture(GL_TEXTURE_2D, texture);
-                checkForGlErrors("bind texture");
-                glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-                glTexImage2D(GL_TEXTURE_2D, 0, mode, surface->w, surface->h, 0,
-                             mode, GL_UNSIGNED_BYTE, surface->pixels);
-                checkForGlErrors("texImage2D");
-                glGenerateMipmap(GL_TEXTURE_2D);
-                checkForGlErrors("asset load");
-                glBindTexture(GL_TEXTURE_2D, 0);
-                img->texture = texture;
-                SDL_DestroySurface(surface);
-            });
+/**
+ * Wrap a decoded surface in an upload which frees it when it's done.
+ */
+static TextureUpload surfaceUpload(SDL_Surface *surface) {
+    TextureUpload upload;
+    upload.pixels = static_cast<const uint8_t *>(surface->pixels);
+    upload.width = surface->w;
+    upload.height = surface->h;
+    upload.pitch = surface->pitch;
+    auto format = SDL_GetPixelFormatDetails(surface->format);
+    if (format->bytes_per_pixel == 1) {
+        upload.bytesPerPixel = 1;
+        upload.format = GL_RED;
+    }
+    upload.release = [surface]() { SDL_DestroySurface(surface); };
+    return upload;
+}
+
+bool ImageLoader::loadPixels(
+    const ImageTier &tier, ImageTextureInfo &info,
+    std::function<void(TextureUpload &&)> &&onDecoded) {
+    auto engine = krit::engine;
+    const std::filesystem::path &pathToLoad = tier.path;
+    FileBytes s;
+    const char *imgType;
+    // if the manifest has the size, the file is only read on the worker
+    bool deferred = tier.file && tier.file->format != ImageKtx2;
+    if (deferred) {
+        imgType = tier.file->format == ImageJpeg ? "JPEG" : "PNG";
+        info.size = tier.file->size;
+        info.gpuBytes = rgbaBytes(info.size);
+    } else {
+        s = engine->io->readBytes(pathToLoad.c_str());
+        if (!readImageHeader(pathToLoad, s, imgType, info)) {
+            return false;
+        }
+    }
+
+    engine->taskManager->push([=, s = std::move(s),
+                               onDecoded = std::move(onDecoded)]() mutable {
+        if (deferred) {
+            s = engine->io->readBytes(pathToLoad.c_str());
+            checkManifestCrc(tier, pathToLoad, s);
+        }
+        SDL_Surface *surface = decodeImage(tier, s, imgType);
+        engine->taskManager->pushRender([=]() {
+            if (!surface) {
+                // decodeImage has logged why
+                onDecoded(TextureUpload());
+                return;
+            }
+            engine->window.makeCurrent();
+            LOG_DEBUG("callback: load image %s", pathToLoad.c_str());
+            onDecoded(surfaceUpload(surface));
         });
+    });
+
+    return true;
+}
+
+/**
+ * An image variant which has been read, parsed and decoded off the main
+ * thread and is waiting for its texture.
+ */
+struct PreparedImage {
+    std::filesystem::path path;
+    ImageTextureInfo info;
+    // pixels to upload, unless `info.compressed`
+    TextureUpload upload;
+    // a compressed file the device samples directly, and its contents; or,
+    // before prepareImage runs, the contents of `path` if they've been read
+    Ktx2Image ktx;
+    FileBytes bytes;
+
+    /**
+     * Read `path`, reusing the bytes probeImage already read if it's the
+     * same file.
+     */
+    FileBytes read(const std::filesystem::path &toRead) {
+        if (!bytes.empty() && toRead == path) {
+            return std::move(bytes);
+        }
+        return krit::engine->io->readBytes(toRead.c_str());
+    }
+};
+
+/**
+ * Read the header of the file prepareImage will load for `tier`, filling in
+ * `prepared.info`, and keep its contents so the worker doesn't read it again.
+ * This is what sizes images the manifest doesn't list. Runs on the caller's
+ * thread.
+ */
+static bool probeImage(const ImageTier &tier, PreparedImage &prepared) {
+    const std::filesystem::path &pathToLoad = tier.path;
+    bool isKtx2 = pathToLoad.extension() == ".ktx2";
+    std::optional<std::filesystem::path> ktxPath;
+    if (isKtx2) {
+        ktxPath = pathToLoad;
+    } else {
+        ktxPath = findCompressedVariant(tier);
+    }
+    if (ktxPath) {
+        FileBytes s = prepared.read(*ktxPath);
+        Ktx2Image ktx;
+        if (parseKtx2(*ktxPath, s, ktx, prepared.info)) {
+            prepared.path = *ktxPath;
+            prepared.bytes = std::move(s);
+            return true;
+        }
+        if (isKtx2) {
+            return false;
+        }
+        prepared.info = ImageTextureInfo();
+    }
+    FileBytes s = prepared.read(pathToLoad);
+    const char *imgType;
+    if (!readImageHeader(pathToLoad, s, imgType, prepared.info)) {
+        return false;
+    }
+    prepared.path = pathToLoad;
+    prepared.bytes = std::move(s);
+    return true;
+}
+
+/**
+ * Read, parse and decode `tier`, or a precompressed sibling of it. Runs on a
+ * worker.
+ */
+static bool prepareImage(const ImageTier &tier, PreparedImage &prepared) {
+    const std::filesystem::path &pathToLoad = tier.path;
+    bool isKtx2 = pathToLoad.extension() == ".ktx2";
+    std::optional<std::filesystem::path> ktxPath;
+    if (isKtx2) {
+        ktxPath = pathToLoad;
+    } else {
+        ktxPath = findCompressedVariant(tier);
+    }
+    if (ktxPath) {
+        FileBytes s = prepared.read(*ktxPath);
+        checkManifestCrc(tier, *ktxPath, s);
+        if (parseKtx2(*ktxPath, s, prepared.ktx, prepared.info)) {
+            prepared.path = *ktxPath;
+            if (prepared.info.compressed) {
+                prepared.bytes = std::move(s);
+                return true;
+            }
+            LOG_DEBUG("decode compressed image %s", ktxPath->c_str());
+            uint8_t *pixels = prepared.ktx.decode(s.view(), 0);
+            if (!pixels) {
+                LOG_ERROR("failed to decode compressed image %s",
+                          ktxPath->c_str());
+                return false;
+            }
+            prepared.upload = ktx2Upload(prepared.ktx, pixels);
+            return true;
+        }
+        if (isKtx2) {
+            return false;
+        }
+        // fall back to the original
+        prepared.info = ImageTextureInfo();
+    }
+
+    FileBytes s = prepared.read(pathToLoad);
+    checkManifestCrc(tier, pathToLoad, s);
+    const char *imgType;
+    if (tier.file) {
+        imgType = tier.file->format == ImageJpeg ? "JPEG" : "PNG";
+    } else if (!readImageHeader(pathToLoad, s, imgType, prepared.info)) {
+        return false;
+    }
+    SDL_Surface *surface = decodeImage(tier, s, imgType);
+    if (!surface) {
+        return false;
+    }
+    if (tier.file && (surface->w != tier.file->size.x ||
+                      surface->h != tier.file->size.y)) {
+        AREA_LOG_WARN("asset",
+                      "%s is %ix%i, but the image manifest says %ix%i",
+                      pathToLoad.c_str(), surface->w, surface->h,
+                      tier.file->size.x, tier.file->size.y);
+    }
+    prepared.info.size.setTo(surface->w, surface->h);
+    prepared.info.gpuBytes = rgbaBytes(prepared.info.size);
+    prepared.path = pathToLoad;
+    prepared.upload = surfaceUpload(surface);
+    return true;
+}
+
+/**
+ * Pick the tier to load first: the smallest that covers the window height,
+ * or the largest there is.
+ */
+static size_t initialTier(const std::vector<ImageTier> &tiers,
+                          int windowHeight) {
+    for (size_t i = 0; i < tiers.size(); ++i) {
+        if (tiers[i].resolution >= windowHeight) {
+            return i;
+        }
+    }
+    return tiers.size() - 1;
+}
+
+/**
+ * Finish loading an image on the main thread, if it's still alive.
+ */
+static void finishOnMain(std::weak_ptr<ImageData> weak) {
+    krit::engine->taskManager->pushMain([weak]() {
+        if (auto img = weak.lock()) {
+            img->finishLoading();
+        }
+    });
+}
+
+/**
+ * Upload callback for a loading image: hands it the texture, if it's still
+ * alive, then finishes its load on the main thread.
+ */
+static std::function<void(GLuint)>
+textureSetter(std::weak_ptr<ImageData> weak) {
+    return [weak](GLuint texture) {
+        if (auto img = weak.lock()) {
+            img->texture = texture;
+        } else {
+            glDeleteTextures(1, &texture);
+            return;
+        }
+        finishOnMain(weak);
+    };
+}
+
+/**
+ * Hand decoded pixels to a loading image: blit them into its runtime atlas
+ * slot if it has one, otherwise queue them for upload into a texture of their
+ * own. Must be called on the render thread.
+ */
+static void deliverPixels(std::weak_ptr<ImageData> weak,
+                          TextureUpload &&upload) {
+    auto img = weak.lock();
+    if (img && img->atlasPage) {
+        krit::engine->renderer.atlas.blit(*img, upload);
+        finishOnMain(weak);
+    } else {
+        upload.onComplete = textureSetter(weak);
+        krit::engine->renderer.uploader.upload(std::move(upload));
+    }
+}
+
+/**
+ * Size a new image, and either track its other tiers or, if it has only the
+ * one, reserve it a runtime atlas slot if it'll have pixels to blit and is
+ * small enough. Tracked images swap their texture when they change tiers, so
+ * they always get a texture of their own. Runs on the main thread.
+ */
+static void setupImage(const std::shared_ptr<ImageData> &img,
+                       std::vector<ImageTier> &&tiers, size_t current,
+                       bool track, const ImageTextureInfo &info) {
+    auto engine = krit::engine;
+    float scale = tiers[current].scale();
+    img->loading = true;
+    img->scale = scale;
+    img->dimensions.setTo(info.size.x / scale, info.size.y / scale);
+    img->gpuBytes = info.gpuBytes;
+    img->compressed = info.compressed;
+    if (track && tiers.size() > 1) {
+        engine->textures.track(img, std::move(tiers), current);
+    } else if (!info.compressed) {
+        engine->renderer.atlas.allocate(*img, info.size);
+    }
+}
+
+/**
+ * Create the texture for a prepared image, or blit it into its atlas slot.
+ * Runs on the render thread.
+ */
+static void uploadPrepared(std::weak_ptr<ImageData> weak,
+                           PreparedImage &prepared) {
+    krit::engine->window.makeCurrent();
+    LOG_DEBUG("callback: load image %s", prepared.path.c_str());
+    auto img = weak.lock();
+    if (!img) {
+        if (!prepared.info.compressed) {
+            prepared.upload.release();
+        }
+        return;
+    }
+    // replace any estimates from the image manifest
+    img->gpuBytes = prepared.info.gpuBytes;
+    img->compressed = prepared.info.compressed;
+    if (prepared.info.compressed) {
+        textureSetter(weak)(
+            uploadKtx2(prepared.path, prepared.ktx, prepared.bytes));
+    } else {
+        deliverPixels(weak, std::move(prepared.upload));
+    }
+}
+
+/**
+ * Returns right away with an image that has its final size and atlas slot but
+ * no texture yet; decoding and premultiplying happen on a worker. Images the
+ * manifest lists are sized from it, others by reading their header here. Use
+ * ImageData::whenReady to wait for the texture.
+ */
+template <>
+std::shared_ptr<ImageData>
+AssetLoader<ImageData>::loadAsset(const std::string &key) {
+    std::shared_ptr<ImageData> img = std::make_shared<ImageData>();
 
+    auto engine = krit::engine;
+    int windowHeight = engine->window.y;
+
+    // tracked textures can switch tiers later, so we need to know about all
+    // of them; otherwise stop at the first one that covers the window
+    bool track = engine->textures.enabled();
+    std::vector<ImageTier> tiers =
+        ImageLoader::findTiers(key, track ? 0 : windowHeight);
+    if (tiers.empty()) {
+        LOG_ERROR("Couldn't find a valid resolution for image: %s",
+                  key.c_str());
+        return img;
+    }
+    size_t current = initialTier(tiers, windowHeight);
+
+    ImageTier &tier = tiers[current];
+    std::weak_ptr<ImageData> weak = img;
+    auto prepared = std::make_shared<PreparedImage>();
+    ImageTier toLoad = tier;
+
+    ImageTextureInfo info;
+    if (tier.file) {
+        // the manifest already has its size
+        manifestInfo(tier, info);
+    } else if (probeImage(tier, *prepared)) {
+        // otherwise read the header now, so the image is sized and has its
+        // atlas slot before it's returned
+        info = prepared->info;
+    } else {
+        return img;
+    }
+    setupImage(img, std::move(tiers), current, track, info);
+    engine->taskManager->push([weak, toLoad, prepared]() {
+        if (prepareImage(toLoad, *prepared)) {
+            krit::engine->taskManager->pushRender(
+                [weak, prepared]() { uploadPrepared(weak, *prepared); });
+        } else {
+            finishOnMain(weak);
+        }
+    });
     return img;
 }
 
+/**
+ * Everything from finding the file to decoding its pixels happens on a
+ * worker. The main thread then only creates the ImageData, which has its
+ * final size and atlas slot but no texture yet, and hands it to `onLoaded`;
+ * use ImageData::whenReady to wait for the texture.
+ */
+template <>
+void AssetLoader<ImageData>::loadAssetAsync(
+    const std::string &key, AssetLoadCallback<ImageData> &&onLoaded) {
+    auto engine = krit::engine;
+    int windowHeight = engine->window.y;
+    bool track = engine->textures.enabled();
+    engine->taskManager->push([=, onLoaded = std::move(onLoaded)]() {
+        auto start = std::chrono::steady_clock::now();
+        auto elapsedMs = [start]() {
+            return std::chrono::duration<float, std::milli>(
+                       std::chrono::steady_clock::now() - start)
+                .count();
+        };
+        std::vector<ImageTier> tiers =
+            ImageLoader::findTiers(key, track ? 0 : windowHeight);
+        if (tiers.empty()) {
+            LOG_ERROR("Couldn't find a valid resolution for image: %s",
+                      key.c_str());
+            float ms = elapsedMs();
+            engine->taskManager->pushMain(
+                [onLoaded, ms]() { onLoaded(nullptr, ms); });
+            return;
+        }
+        size_t current = initialTier(tiers, windowHeight);
+        auto prepared = std::make_shared<PreparedImage>();
+        if (!prepareImage(tiers[current], *prepared)) {
+            float ms = elapsedMs();
+            engine->taskManager->pushMain(
+                [onLoaded, ms]() { onLoaded(nullptr, ms); });
+            return;
+        }
+        float ms = elapsedMs();
+
+        engine->taskManager->pushMain([=]() mutable {
+            auto img = std::make_shared<ImageData>();
+            setupImage(img, std::move(tiers), current, track, prepared->info);
+            std::weak_ptr<ImageData> weak = img;
+            engine->taskManager->pushRender(
+                [weak, prepared]() { uploadPrepared(weak, *prepared); });
+            onLoaded(img, ms);
+        });
+    });
+}
+
+/**
+ * Images are loaded from their resolution tiers and precompressed siblings,
+ * which all share the key's name up to its extension, e.g. foo.1080.png and
+ * foo.1080.bc7.ktx2 for foo.png. This can also match other images named
+ * like them, which only costs those a reload.
+ */
+template <>
+bool AssetLoader<ImageData>::usesFile(const std::string &id,
+                                      const std::string &path) {
+    if (id == path) {
+        return true;
+    }
+    size_t dot = id.rfind('.');
+    size_t slash = id.rfind('/');
+    if (dot == std::string::npos ||
+        (slash != std::string::npos && dot < slash)) {
+        return false;
+    }
+    return path.size() > dot && !path.compare(0, dot + 1, id, 0, dot + 1);
+}
+
 template <> bool AssetLoader<ImageData>::assetIsReady(ImageData *img) {
     return img->texture > 0;
 }
 
-template <> size_t AssetLoader<ImageData>::cost(ImageData *img) {
-    return (img->dimensions.x * img->scale) * (img->dimensions.y * img->scale) *
-           4;
+template <> AssetCost AssetLoader<ImageData>::cost(ImageData *img) {
+    size_t gpuBytes = img->gpuBytes;
+    if (!gpuBytes) {
+        gpuBytes = (img->dimensions.x * img->scale) *
+                   (img->dimensions.y * img->scale) * 4;
+    }
+    return AssetCost{sizeof(ImageData), gpuBytes};
 }
 
 template <> AssetType AssetLoader<ImageData>::type() { return ImageAsset; }
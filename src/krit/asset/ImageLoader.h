@@ -0,0 +1,117 @@
+#ifndef KRIT_ASSET_IMAGELOADER
+#define KRIT_ASSET_IMAGELOADER
+
+#include "krit/math/Dimensions.h"
+#include "krit/render/Gl.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace krit {
+
+struct TextureUpload;
+
+enum ImageFileFormat : uint32_t {
+    ImagePng,
+    ImageJpeg,
+    ImageKtx2,
+};
+
+/**
+ * What the image manifest records about one file of an image.
+ */
+struct ImageFileInfo {
+    std::filesystem::path path;
+    int resolution = 0;
+    IntDimensions size;
+    ImageFileFormat format = ImagePng;
+    // as declared in the asset spec; see ImageLoader::premultiplyAlpha
+    bool premultiplied = false;
+    // a precompressed copy of the tier with the same resolution
+    bool sibling = false;
+    // CRC-32 of the file's contents
+    uint32_t crc = 0;
+};
+
+/**
+ * One resolution variant of an image asset, e.g. foo.1080.png for foo.png.
+ */
+struct ImageTier {
+    int resolution;
+    std::filesystem::path path;
+    std::filesystem::path archive;
+    // set if the image manifest lists this image, along with any
+    // precompressed siblings of this tier it lists
+    std::optional<ImageFileInfo> file;
+    std::vector<ImageFileInfo> compressed;
+
+    float scale() const { return resolution / 2160.0; }
+};
+
+/**
+ * Pixel size and texture memory of an image file queued for upload.
+ */
+struct ImageTextureInfo {
+    IntDimensions size;
+    size_t gpuBytes = 0;
+    bool compressed = false;
+};
+
+struct ImageLoader {
+    /**
+     * The renderer blends as if textures had premultiplied alpha. If this is
+     * set, decoded PNGs and JPEGs are premultiplied on the worker that
+     * decodes them, unless the image manifest says the file already is.
+     *
+     * Enable it when images are exported with straight alpha, as most
+     * editors write PNGs; without it their translucent edges blend too
+     * bright. Leave it off if every image is premultiplied at build time.
+     * KTX2 files are sampled as they were encoded, so encode them from
+     * premultiplied sources either way. Set it before loading any images.
+     */
+    static bool premultiplyAlpha;
+
+    /**
+     * Load the image manifest written by tools/asset_registry from `path`
+     * under the asset roots, replacing any loaded before. Images it lists
+     * are sized and loaded without probing for variants or reading headers.
+     * The default manifest is loaded the first time it's needed; call this
+     * to load a different one or to reload it. Returns false if the file is
+     * missing or invalid.
+     */
+    static bool parseManifest(const std::string &path = "images.manifest");
+
+    /**
+     * Find the resolution variants of the image `key`, lowest first. If
+     * `targetHeight` is nonzero, stops at the first variant which is at least
+     * that tall.
+     */
+    static std::vector<ImageTier> findTiers(const std::string &key,
+                                            int targetHeight = 0);
+
+    /**
+     * Read the header of an image variant (or a precompressed sibling), or
+     * take its size from the image manifest, and queue decoding and upload
+     * of its pixels. `onUpload` is called on the
+     * render thread with the new texture, or 0 if the pixels couldn't be
+     * decoded. Returns false if the file can't be loaded.
+     */
+    static bool loadTexture(const ImageTier &tier, ImageTextureInfo &info,
+                            std::function<void(GLuint)> &&onUpload);
+
+    /**
+     * Like loadTexture, but for a PNG/JPEG variant only and stopping short of
+     * the upload: `onDecoded` is called on the render thread with the
+     * decoded pixels, or an empty upload if they couldn't be decoded.
+     */
+    static bool loadPixels(const ImageTier &tier, ImageTextureInfo &info,
+                           std::function<void(TextureUpload &&)> &&onDecoded);
+};
+
+}
+
+#endif
@@ -0,0 +1,245 @@
+#include "krit/asset/Ktx2.h"
+#include "krit/utils/Log.h"
+#include <algorithm>
+#include <cstring>
+
+namespace krit {
+
+static const uint8_t KTX2_IDENTIFIER[12] = {0xab, 'K',  'T',  'X',
+                                            ' ',  '2',  '0',  0xbb,
+                                            '\r', '\n', 0x1a, '\n'};
+static const size_t KTX2_HEADER_SIZE = 80;
+static const size_t KTX2_LEVEL_INDEX_ENTRY_SIZE = 24;
+
+template <typename T> static T readLe(const char *p) {
+    T val;
+    memcpy(&val, p, sizeof(T));
+    return val;
+}
+
+GLenum ktx2GlFormat(uint32_t vkFormat) {
+    switch (vkFormat) {
+        case 131: // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+        case 132: // VK_FORMAT_BC1_RGB_SRGB_BLOCK
+            return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case 133: // VK_FORMAT_BC1_RGBA_UNORM_BLOCK
+        case 134: // VK_FORMAT_BC1_RGBA_SRGB_BLOCK
+            return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+        case 137: // VK_FORMAT_BC3_UNORM_BLOCK
+        case 138: // VK_FORMAT_BC3_SRGB_BLOCK
+            return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case 145: // VK_FORMAT_BC7_UNORM_BLOCK
+        case 146: // VK_FORMAT_BC7_SRGB_BLOCK
+            return GL_COMPRESSED_RGBA_BPTC_UNORM;
+        case 147: // VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK
+        case 148: // VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK
+            return GL_COMPRESSED_RGB8_ETC2;
+        case 151: // VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK
+        case 152: // VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK
+            return GL_COMPRESSED_RGBA8_ETC2_EAC;
+        case 157: // VK_FORMAT_ASTC_4x4_UNORM_BLOCK
+        case 158: // VK_FORMAT_ASTC_4x4_SRGB_BLOCK
+            return GL_COMPRESSED_RGBA_ASTC_4x4_KHR;
+        default:
+            return 0;
+    }
+}
+
+bool Ktx2Image::parse(std::string_view data, const char *name) {
+    if (data.size() < KTX2_HEADER_SIZE ||
+        memcmp(data.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER))) {
+        LOG_ERROR("not a KTX2 file: %s", name);
+        return false;
+    }
+    const char *p = data.data() + sizeof(KTX2_IDENTIFIER);
+    vkFormat = readLe<uint32_t>(p);
+    uint32_t pixelWidth = readLe<uint32_t>(p + 8);
+    uint32_t pixelHeight = readLe<uint32_t>(p + 12);
+    uint32_t pixelDepth = readLe<uint32_t>(p + 16);
+    uint32_t layerCount = readLe<uint32_t>(p + 20);
+    uint32_t faceCount = readLe<uint32_t>(p + 24);
+    uint32_t levelCount = std::max(readLe<uint32_t>(p + 28), 1u);
+    uint32_t supercompression = readLe<uint32_t>(p + 32);
+
+    glFormat = ktx2GlFormat(vkFormat);
+    if (!glFormat) {
+        LOG_ERROR("unsupported KTX2 format %u: %s", vkFormat, name);
+        return false;
+    }
+    if (pixelDepth > 1 || layerCount > 1 || faceCount != 1) {
+        LOG_ERROR("only 2D KTX2 textures are supported: %s", name);
+        return false;
+    }
+    if (supercompression) {
+        LOG_ERROR("KTX2 supercompression scheme %u isn't supported: %s",
+                  supercompression, name);
+        return false;
+    }
+    if (levelCount > 32) {
+        LOG_ERROR("too many KTX2 mip levels (%u): %s", levelCount, name);
+        return false;
+    }
+    if ((data.size() - KTX2_HEADER_SIZE) / KTX2_LEVEL_INDEX_ENTRY_SIZE <
+        levelCount) {
+        LOG_ERROR("truncated KTX2 level index: %s", name);
+        return false;
+    }
+
+    width = pixelWidth;
+    height = pixelHeight;
+    levels.clear();
+    levels.reserve(levelCount);
+    const char *index = data.data() + KTX2_HEADER_SIZE;
+    for (size_t i = 0; i < levelCount; ++i) {
+        const char *entry = index + i * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+        Ktx2Level level;
+        level.offset = readLe<uint64_t>(entry);
+        level.length = readLe<uint64_t>(entry + 8);
+        level.width = std::max(width >> i, 1);
+        level.height = std::max(height >> i, 1);
+        // written so that a huge offset or length can't wrap around
+        if (level.offset > data.size() ||
+            level.length > data.size() - level.offset) {
+            LOG_ERROR("truncated KTX2 level %zu: %s", i, name);
+            return false;
+        }
+        // every supported format uses 4x4 blocks; a short level would
+        // otherwise only be noticed when it's decoded or uploaded
+        size_t blocks = (size_t)((level.width + 3) / 4) *
+                        ((level.height + 3) / 4);
+        if (level.length < blocks * blockBytes()) {
+            LOG_ERROR("KTX2 level %zu is too short for its size: %s", i,
+                      name);
+            return false;
+        }
+        levels.push_back(level);
+    }
+    return true;
+}
+
+size_t Ktx2Image::byteSize() const {
+    size_t total = 0;
+    for (auto &level : levels) {
+        total += level.length;
+    }
+    return total;
+}
+
+size_t Ktx2Image::blockBytes() const {
+    switch (glFormat) {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGB8_ETC2:
+            return 8;
+        default:
+            return 16;
+    }
+}
+
+bool Ktx2Image::canDecode() const {
+    return glFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ||
+           glFormat == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT ||
+           glFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+static void expand565(uint16_t c, uint8_t *out) {
+    uint8_t r = (c >> 11) & 0x1f, g = (c >> 5) & 0x3f, b = c & 0x1f;
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+    out[3] = 0xff;
+}
+
+// decode a 4x4 BC1 color block into a 16-pixel RGBA palette lookup
+static void decodeColorBlock(const uint8_t *block, bool fourColor,
+                             uint8_t out[16][4]) {
+    uint16_t c0 = block[0] | (block[1] << 8);
+    uint16_t c1 = block[2] | (block[3] << 8);
+    uint8_t palette[4][4];
+    expand565(c0, palette[0]);
+    expand565(c1, palette[1]);
+    if (fourColor || c0 > c1) {
+        for (int i = 0; i < 3; ++i) {
+            palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+            palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+        }
+        palette[2][3] = palette[3][3] = 0xff;
+    } else {
+        for (int i = 0; i < 3; ++i) {
+            palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+            palette[3][i] = 0;
+        }
+        palette[2][3] = 0xff;
+        palette[3][3] = 0;
+    }
+    uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) |
+                       ((uint32_t)block[7] << 24);
+    for (int i = 0; i < 16; ++i) {
+        memcpy(out[i], palette[(indices >> (i * 2)) & 3], 4);
+    }
+}
+
+static void decodeAlphaBlock(const uint8_t *block, uint8_t out[16][4]) {
+    uint8_t a[8];
+    a[0] = block[0];
+    a[1] = block[1];
+    if (a[0] > a[1]) {
+        for (int i = 2; i < 8; ++i) {
+            a[i] = ((8 - i) * a[0] + (i - 1) * a[1]) / 7;
+        }
+    } else {
+        for (int i = 2; i < 6; ++i) {
+            a[i] = ((6 - i) * a[0] + (i - 1) * a[1]) / 5;
+        }
+        a[6] = 0;
+        a[7] = 0xff;
+    }
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; ++i) {
+        indices |= (uint64_t)block[2 + i] << (i * 8);
+    }
+    for (int i = 0; i < 16; ++i) {
+        out[i][3] = a[(indices >> (i * 3)) & 7];
+    }
+}
+
+uint8_t *Ktx2Image::decode(std::string_view data, size_t levelIndex) const {
+    const Ktx2Level &level = levels[levelIndex];
+    bool hasAlphaBlock = glFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    size_t blockSize = blockBytes();
+    int blocksX = (level.width + 3) / 4, blocksY = (level.height + 3) / 4;
+    if (level.length < (size_t)blocksX * blocksY * blockSize) {
+        return nullptr;
+    }
+    uint8_t *pixels = new uint8_t[level.width * level.height * 4];
+    const uint8_t *src = (const uint8_t *)data.data() + level.offset;
+    uint8_t texels[16][4];
+    for (int by = 0; by < blocksY; ++by) {
+        for (int bx = 0; bx < blocksX; ++bx) {
+            if (hasAlphaBlock) {
+                decodeColorBlock(src + 8, true, texels);
+                decodeAlphaBlock(src, texels);
+            } else {
+                decodeColorBlock(src, false, texels);
+            }
+            src += blockSize;
+            for (int y = 0; y < 4; ++y) {
+                int py = by * 4 + y;
+                if (py >= level.height) {
+                    break;
+                }
+                for (int x = 0; x < 4; ++x) {
+                    int px = bx * 4 + x;
+                    if (px >= level.width) {
+                        break;
+                    }
+                    memcpy(&pixels[(py * level.width + px) * 4],
+                           texels[y * 4 + x], 4);
+                }
+            }
+        }
+    }
+    return pixels;
+}
+
+}
@@ -0,0 +1,95 @@
+#ifndef KRIT_ASSET_KTX2
+#define KRIT_ASSET_KTX2
+
+#include "krit/render/Gl.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// not every GL header exposes the compressed format extensions
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#endif
+#ifndef GL_COMPRESSED_RGBA8_ETC2_EAC
+#define GL_COMPRESSED_RGBA8_ETC2_EAC 0x9278
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+#define GL_COMPRESSED_RGBA_ASTC_4x4_KHR 0x93B0
+#endif
+
+namespace krit {
+
+/**
+ * A single mip level inside a KTX2 container; offsets are relative to the
+ * start of the file.
+ */
+struct Ktx2Level {
+    size_t offset;
+    size_t length;
+    int width;
+    int height;
+};
+
+/**
+ * Minimal reader for KTX2 containers holding a 2D, single-layer,
+ * non-supercompressed block-compressed texture with an optional mip chain.
+ */
+struct Ktx2Image {
+    uint32_t vkFormat = 0;
+    GLenum glFormat = 0;
+    int width = 0;
+    int height = 0;
+    std::vector<Ktx2Level> levels;
+
+    /**
+     * Parse the header and level index of `data`. Returns false (and logs)
+     * if the file isn't a KTX2 container this reader can handle.
+     */
+    bool parse(std::string_view data, const char *name);
+
+    /**
+     * Total size of all mip levels as they'll be stored on the GPU.
+     */
+    size_t byteSize() const;
+
+    /**
+     * Size of one 4x4 block of this format.
+     */
+    size_t blockBytes() const;
+
+    /**
+     * Whether `decode` can turn this format into RGBA8 on the CPU.
+     */
+    bool canDecode() const;
+
+    /**
+     * Decode one mip level to tightly packed RGBA8. The caller owns the
+     * returned buffer, which is null if the level can't be decoded.
+     */
+    uint8_t *decode(std::string_view data, size_t level) const;
+};
+
+/**
+ * Map a VkFormat from a KTX2 header to the matching GL compressed internal
+ * format, or 0 if it isn't supported. sRGB variants map to their UNORM
+ * counterparts, matching how PNG/JPEG textures are uploaded.
+ */
+GLenum ktx2GlFormat(uint32_t vkFormat);
+
+}
+
+#endif
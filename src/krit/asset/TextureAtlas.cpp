@@ -4,6 +4,7 @@
 #include <sstream>
 #include <stddef.h>
 #include <string>
+#include <unordered_set>
 
 #include "krit/Engine.h"
 #include "krit/Engine.h"
@@ -96,8 +97,19 @@ template <> bool AssetLoader<TextureAtlas>::assetIsReady(TextureAtlas *img) {
 
 template <> AssetType AssetLoader<TextureAtlas>::type() { return AtlasAsset; }
 
-template <> size_t AssetLoader<TextureAtlas>::cost(TextureAtlas *a) {
-    return sizeof(TextureAtlas);
+template <> AssetCost AssetLoader<TextureAtlas>::cost(TextureAtlas *a) {
+    AssetCost cost{sizeof(TextureAtlas)};
+    std::unordered_set<ImageData *> pages;
+    for (auto &it : a->regions) {
+        cost.cpuBytes += sizeof(it) + it.first.capacity() +
+                         it.second.name.capacity();
+        // pages are cached as images of their own
+        if (pages.insert(it.second.img.get()).second) {
+            cost.sharedBytes +=
+                AssetLoader<ImageData>::cost(it.second.img.get()).total();
+        }
+    }
+    return cost;
 }
 
 }
\ No newline at end of file
@@ -39,16 +39,14 @@ static sf_count_t sf_vio_read(void *buf, sf_count_t bytes, void *_io) {
     int toRead =
         std::min<int>(static_cast<int>(io->audioData->data.size()) - io->cursor,
                       static_cast<int>(bytes));
-    memcpy(buf, &io->audioData->data.c_str()[io->cursor], toRead);
+    memcpy(buf, io->audioData->data.data() + io->cursor, toRead);
     io->cursor += toRead;
     return toRead;
 }
 
 static sf_count_t sf_vio_write(const void *buf, sf_count_t bytes, void *_io) {
-    AudioDataCursor *io = static_cast<AudioDataCursor *>(_io);
-    memcpy((void *)&io->audioData->data.c_str()[io->cursor], buf, bytes);
-    io->cursor += bytes;
-    return bytes;
+    // audio data is read only, and may be a mapping of the file
+    return 0;
 }
 
 static sf_count_t sf_vio_tell(void *_io) {
@@ -96,14 +94,14 @@ std::shared_ptr<AudioData>
 AssetLoader<AudioData>::loadAsset(const std::string &path) {
     AREA_LOG_INFO("audio", "loading audio asset %s", path.c_str());
     std::shared_ptr<AudioData> a = std::make_shared<AudioData>();
-    std::string content = engine->io->readFile(path.c_str());
     a->path = path;
-    a->data = std::move(content);
+    a->data = engine->io->readBytes(path.c_str());
     return a;
 }
 
-template <> size_t AssetLoader<AudioData>::cost(AudioData *a) {
-    return a->data.size();
+template <> AssetCost AssetLoader<AudioData>::cost(AudioData *a) {
+    // audio is decoded as it streams, so this is the encoded file
+    return AssetCost{sizeof(AudioData) + a->data.size()};
 }
 
 template <> AssetType AssetLoader<AudioData>::type() { return AudioAsset; }
@@ -112,6 +110,8 @@ template <> bool AssetLoader<AudioData>::assetIsReady(AudioData *a) {
     return !!a;
 }
 
+template <> bool AssetLoader<AudioData>::loadsOffThread() { return true; }
+
 }
 
 #endif
@@ -2,6 +2,7 @@
 
 #if KRIT_ENABLE_AUDIO
 
+#include "krit/io/FileBytes.h"
 #include <AL/al.h>
 #include <memory>
 #include <sndfile.h>
@@ -11,7 +12,7 @@ namespace krit {
 
 struct AudioData {
     std::string path;
-    std::string data;
+    FileBytes data;
     int sampleRate{0};
     int channels{0};
     int frames{0};
@@ -44,6 +44,48 @@ void Overlay::draw(krit::RenderContext &ctx) {
                             stats.avg, stats.min, stats.max);
             }
         }
+        {
+            AssetCache &assets = engine->assets;
+            if (assets.budget) {
+                ImGui::Text("Assets: %.3f / %.3f MB", assets.used / 1000000.0,
+                            assets.budget / 1000000.0);
+            } else {
+                ImGui::Text("Assets: %.3f MB", assets.used / 1000000.0);
+            }
+            for (auto &report : assets.report()) {
+                if (!report.count && !report.stats.misses) {
+                    continue;
+                }
+                size_t requests = report.stats.hits + report.stats.misses;
+                ImGui::Text("  %s: %zu (%.3f MB), %.0f%% hits, %zu evicted",
+                            assetTypeName(report.type), report.count,
+                            report.cost.total() / 1000000.0,
+                            requests ? report.stats.hits * 100.0 / requests
+                                     : 0.0,
+                            report.stats.evictions);
+            }
+        }
+        if (engine->textures.enabled()) {
+            ImGui::Text("Textures: %.3f / %.3f MB",
+                        engine->textures.residentBytes() / 1000000.0,
+                        engine->textures.budget / 1000000.0);
+            for (auto &tier : engine->textures.stats()) {
+                ImGui::Text("  %ip: %zu (%.3f MB)", tier.resolution,
+                            tier.textures, tier.bytes / 1000000.0);
+            }
+        }
+#if KRIT_ENABLE_TEXT
+        {
+            GlyphCacheStats glyphs = engine->fonts.glyphCache.stats();
+            ImGui::Text("Glyphs: %zu on %zu pages (%.0f%%)", glyphs.glyphs,
+                        glyphs.pages, glyphs.occupancy * 100);
+            ImGui::Text("  evicted %zu, compacted %zu", glyphs.evictions,
+                        glyphs.compactions);
+            ShapeCache &shapes = engine->fonts.shapeCache;
+            ImGui::Text("Shaped words: %zu (%zu hits, %zu misses)",
+                        shapes.size(), shapes.hits, shapes.misses);
+        }
+#endif
         ImGui::Checkbox("Debug draw", &ctx.debugDraw);
         ImGui::Checkbox("Pause", &engine->paused);
         if (ImGui::Button("Advance Frame")) {
@@ -0,0 +1,101 @@
+#include "krit/io/FileBytes.h"
+#include "krit/utils/Log.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef __EMSCRIPTEN__
+#include <sys/mman.h>
+#endif
+#endif
+
+namespace krit {
+
+FileBytes FileBytes::owned(std::string &&buffer) {
+    FileBytes result;
+    auto owned = std::make_shared<std::string>(std::move(buffer));
+    result.bytes = owned->data();
+    result.length = owned->size();
+    result.storage = std::move(owned);
+    return result;
+}
+
+std::optional<FileBytes> FileBytes::map(const std::filesystem::path &path) {
+#ifdef __EMSCRIPTEN__
+    // the emscripten filesystem lives in memory already, and its mmap would
+    // only make another copy
+    (void)path;
+    return std::nullopt;
+#elif defined(_WIN32)
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return std::nullopt;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return std::nullopt;
+    }
+    FileBytes result;
+    size_t length = fileSize.QuadPart;
+    if (!length) {
+        // CreateFileMapping rejects empty files
+        CloseHandle(file);
+        return result;
+    }
+    HANDLE mapping =
+        CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    // the mapping and the view keep the file alive on their own
+    CloseHandle(file);
+    void *mapped = nullptr;
+    if (mapping) {
+        mapped = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+    }
+    if (!mapped) {
+        LOG_WARN("failed to map %s; reading it instead",
+                 path.string().c_str());
+        return std::nullopt;
+    }
+    result.bytes = static_cast<const char *>(mapped);
+    result.length = length;
+    result.storage = std::shared_ptr<const void>(
+        mapped, [](const void *p) { UnmapViewOfFile(p); });
+    return result;
+#else
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+    struct stat st;
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return std::nullopt;
+    }
+    FileBytes result;
+    size_t length = st.st_size;
+    if (!length) {
+        // mmap rejects empty mappings
+        close(fd);
+        return result;
+    }
+    void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file alive on its own
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        LOG_WARN("failed to map %s; reading it instead", path.c_str());
+        return std::nullopt;
+    }
+    result.bytes = static_cast<const char *>(mapped);
+    result.length = length;
+    result.storage = std::shared_ptr<const void>(
+        mapped, [length](const void *p) { munmap((void *)p, length); });
+    return result;
+#endif
+}
+
+}
@@ -0,0 +1,59 @@
+#ifndef KRIT_IO_FILEBYTES
+#define KRIT_IO_FILEBYTES
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace krit {
+
+/**
+ * Read-only contents of a file. Depending on where the file came from the
+ * bytes are either a memory mapping of it or an owned buffer; copies share
+ * the same storage, which is released along with the last copy. Loaders can
+ * hand `data()` to decoders directly, as long as they keep a copy of the
+ * FileBytes for as long as the decoder needs it.
+ */
+struct FileBytes {
+    /**
+     * Take ownership of an already read buffer.
+     */
+    static FileBytes owned(std::string &&buffer);
+
+    /**
+     * Map the file at `path`, a platform path. Returns nothing if it can't be
+     * mapped, in which case callers should fall back to reading it.
+     */
+    static std::optional<FileBytes> map(const std::filesystem::path &path);
+
+    FileBytes() {}
+
+    const char *data() const { return bytes; }
+    size_t size() const { return length; }
+    bool empty() const { return !length; }
+    std::string_view view() const { return std::string_view(bytes, length); }
+    std::string str() const { return std::string(bytes, length); }
+
+    /**
+     * A view of part of these bytes, sharing their storage.
+     */
+    FileBytes slice(size_t offset, size_t size) const {
+        FileBytes result;
+        result.storage = storage;
+        result.bytes = bytes + offset;
+        result.length = size;
+        return result;
+    }
+
+private:
+    std::shared_ptr<const void> storage;
+    const char *bytes = "";
+    size_t length = 0;
+};
+
+}
+
+#endif
@@ -8,4 +8,5 @@ declare class Io {
     exists(path: string): boolean;
     readFile(path: string): string;
     readDir(path: string): Array<string>;
+    rescan(): void;
 }
@@ -1,8 +1,10 @@
 #ifndef KRIT_IO
 #define KRIT_IO
 
+#include "krit/io/FileBytes.h"
 #include <cstddef>
 #include <filesystem>
+#include <functional>
 #include <memory>
 #include <optional>
 #include <string>
@@ -21,11 +23,34 @@ struct Io {
     virtual std::optional<std::filesystem::path> find(const std::filesystem::path &path) = 0;
     virtual bool exists(const std::filesystem::path &path) = 0;
     virtual std::string readFile(const std::filesystem::path &path) = 0;
+    /**
+     * Like readFile, but without copying the contents where the backend
+     * allows it; loose files are memory mapped in release builds.
+     */
+    virtual FileBytes readBytes(const std::filesystem::path &path) {
+        return FileBytes::owned(readFile(path));
+    }
     virtual std::vector<std::string> readDir(const std::filesystem::path &path) = 0;
+
+    /**
+     * Pick up changes made to the underlying files since the last call,
+     * calling `onChange` with the path of each changed file. Called once per
+     * frame from the main thread.
+     */
+    virtual void poll() {}
+    /**
+     * Forget anything cached about the underlying files and look again.
+     */
+    virtual void rescan() {}
+
+    // called by poll with each file which was created or modified; the
+    // engine sets this to drop the file's assets from its cache
+    std::function<void(const std::string &)> onChange;
 };
 
 extern Io *ioFile;
 extern Io *ioZip;
+extern Io *ioPack;
 
 }
 
@@ -1,38 +1,118 @@
 #include "krit/Engine.h"
 #include "krit/io/Io.h"
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+#ifdef KRIT_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
 
 namespace krit {
 
+/**
+ * Normalize an asset path into the form used as an index key: relative to the
+ * root, with forward slashes and no trailing slash. Returns false if the path
+ * can't be looked up in an index, e.g. if it's absolute or leaves the root.
+ */
+static bool indexKey(const std::filesystem::path &path, std::string &key) {
+    auto normal = path.lexically_normal();
+    if (normal.is_absolute()) {
+        return false;
+    }
+    key = normal.generic_string();
+    if (key == ".") {
+        key.clear();
+    } else if (key == ".." || !key.compare(0, 3, "../")) {
+        return false;
+    }
+    if (!key.empty() && key.back() == '/') {
+        key.pop_back();
+    }
+    return true;
+}
+
+static std::string joinKey(const std::string &dir, const char *name) {
+    return dir.empty() ? std::string(name) : dir + "/" + name;
+}
+
+/**
+ * Loose files under one or more root directories.
+ *
+ * Each root is walked once when it's added, and `find`, `exists` and
+ * `readDir` are answered from the resulting index instead of the filesystem.
+ * On Linux the index is kept up to date through inotify, which also reports
+ * modified files through `onChange`; elsewhere, call `rescan` after changing
+ * files.
+ *
+ * Release builds map files instead of reading them. Development builds,
+ * where files are edited while the game runs, always copy them: a mapped
+ * file truncated by an editor faults (SIGBUS) when the mapping is read.
+ */
 struct IoFile : public Io {
     struct ArchiveInfo {
         // TODO: maybe use an ID here rather than the path
         std::filesystem::path path;
         bool enabled;
+        // false if the root couldn't be walked; it's checked on disk instead
+        bool indexed = false;
+        // index keys of every file and directory under the root
+        std::unordered_set<std::string> entries;
+    };
+
+    // never shrinks, so archives can be used outside of the lock once found
+    std::vector<std::unique_ptr<ArchiveInfo>> archives;
+    std::once_flag initialized;
+    // guards `archives` and their indices
+    std::shared_mutex lock;
+
+#ifdef KRIT_LINUX
+    struct Watch {
+        ArchiveInfo *archive;
+        std::string dir;
     };
 
-    std::vector<ArchiveInfo> archives;
-    std::vector<bool> enabled;
-    bool initialized = false;
+    int inotify = -1;
+    // the same directory can be watched for more than one root
+    std::unordered_multimap<int, Watch> watches;
+#endif
 
     IoFile() {}
 
+    ~IoFile() {
+#ifdef KRIT_LINUX
+        if (inotify != -1) {
+            close(inotify);
+        }
+#endif
+    }
+
     bool addRoot(const std::filesystem::path &path) override {
-        if (hasRoot(path)) {
+        if (!engine->platform->exists(path)) {
+            LOG_WARN("couldn't add missing asset root: %s\n", path.c_str());
             return false;
         }
-        if (engine->platform->exists(path)) {
-            LOG_INFO("adding asset root: %s\n", path.c_str());
-            archives.push_back((ArchiveInfo){.path = path, .enabled = true});
-            return true;
+        std::unique_lock<std::shared_mutex> guard(lock);
+        for (auto &a : archives) {
+            if (a->path == path) {
+                return false;
+            }
         }
-        LOG_WARN("couldn't add missing asset root: %s\n", path.c_str());
-        return false;
+        LOG_INFO("adding asset root: %s\n", path.c_str());
+        auto archive = std::make_unique<ArchiveInfo>();
+        archive->path = path;
+        archive->enabled = true;
+        index(*archive);
+        archives.push_back(std::move(archive));
+        return true;
     }
 
     bool hasRoot(const std::filesystem::path &path) override {
+        std::shared_lock<std::shared_mutex> guard(lock);
         for (auto &a : archives) {
-            if (a.path == path) {
+            if (a->path == path) {
                 return true;
             }
         }
@@ -40,10 +120,11 @@ struct IoFile : public Io {
     }
 
     bool enableRoot(const std::filesystem::path &path) override {
+        std::unique_lock<std::shared_mutex> guard(lock);
         for (auto &a : archives) {
-            if (a.path == path) {
-                if (!a.enabled) {
-                    a.enabled = true;
+            if (a->path == path) {
+                if (!a->enabled) {
+                    a->enabled = true;
                     return true;
                 } else {
                     return false;
@@ -54,10 +135,11 @@ struct IoFile : public Io {
     }
 
     bool disableRoot(const std::filesystem::path &path) override {
+        std::unique_lock<std::shared_mutex> guard(lock);
         for (auto &a : archives) {
-            if (a.path == path) {
-                if (a.enabled) {
-                    a.enabled = false;
+            if (a->path == path) {
+                if (a->enabled) {
+                    a->enabled = false;
                     return true;
                 } else {
                     return false;
@@ -68,84 +150,279 @@ struct IoFile : public Io {
     }
 
     void init() {
-        if (initialized) {
-            return;
-        }
-        initialized = true;
-        addRoot("assets");
+        std::call_once(initialized, [this]() { addRoot("assets"); });
     }
 
     std::string readFile(const std::filesystem::path &path) override {
         init();
-        auto s = path.string();
-        if (!archives.empty()) {
-            for (auto &archive : archives) {
-                if (!archive.enabled) {
-                    continue;
-                }
-                auto combinedPath = archive.path / path;
-                if (engine->platform->exists(combinedPath)) {
-                    return engine->platform->readFile(combinedPath);
-                }
+        if (ArchiveInfo *archive = locate(path)) {
+            return engine->platform->readFile(archive->path / path);
+        }
+        // FIXME: return optional instead of panic
+        panic("no such file: %s", path.c_str());
+    }
+
+    FileBytes readBytes(const std::filesystem::path &path) override {
+        init();
+        if (ArchiveInfo *archive = locate(path)) {
+            auto combinedPath = archive->path / path;
+#if KRIT_RELEASE
+            if (auto mapped = FileBytes::map(combinedPath)) {
+                return std::move(*mapped);
             }
+#endif
+            return FileBytes::owned(engine->platform->readFile(combinedPath));
         }
         // FIXME: return optional instead of panic
-        panic("no such file: %s", s.c_str());
+        panic("no such file: %s", path.c_str());
     }
 
     std::optional<std::filesystem::path>
     find(const std::filesystem::path &path) override {
         init();
-        if (!archives.empty()) {
-            auto s = path.string();
-            for (auto &archive : archives) {
-                if (!archive.enabled) {
-                    continue;
-                }
-                auto combinedPath = archive.path / path;
-                if (engine->platform->exists(combinedPath)) {
-                    return archive.path;
-                }
-            }
+        if (ArchiveInfo *archive = locate(path)) {
+            return archive->path;
         }
         return {};
     }
 
     bool exists(const std::filesystem::path &path) override {
         init();
-        if (!archives.empty()) {
-            auto s = path.string();
-            for (auto &archive : archives) {
-                if (!archive.enabled) {
-                    continue;
-                }
-                auto combinedPath = archive.path / path;
-                if (engine->platform->exists(combinedPath)) {
-                    return true;
-                }
-            }
-        }
-        return false;
+        return locate(path);
     }
 
     std::vector<std::string>
     readDir(const std::filesystem::path &path) override {
         init();
         std::vector<std::string> results;
-        if (!archives.empty()) {
-            auto s = path.string();
-            for (auto &archive : archives) {
-                if (!archive.enabled) {
+        std::unordered_set<std::string> seen;
+        std::string key;
+        bool indexable = indexKey(path, key);
+        std::shared_lock<std::shared_mutex> guard(lock);
+        for (auto &archive : archives) {
+            if (!archive->enabled) {
+                continue;
+            }
+            if (archive->indexed && indexable) {
+                for (auto &entry : archive->entries) {
+                    if (parentKey(entry) == key && seen.insert(entry).second) {
+                        results.push_back(entry);
+                    }
+                }
+            } else {
+                auto combinedPath = archive->path / path;
+                if (!engine->platform->isDir(combinedPath)) {
                     continue;
                 }
-                auto combinedPath = archive.path / path;
-                for (auto &child : engine->platform->readDir(path)) {
-                    results.push_back(child);
+                for (auto &child : engine->platform->readDir(combinedPath)) {
+                    auto relative =
+                        (path / std::filesystem::path(child).filename())
+                            .generic_string();
+                    if (seen.insert(relative).second) {
+                        results.push_back(relative);
+                    }
                 }
             }
         }
         return results;
     }
+
+    void poll() override {
+#ifdef KRIT_LINUX
+        if (inotify == -1) {
+            return;
+        }
+        std::vector<std::string> changed;
+        bool overflowed = false;
+        {
+            std::unique_lock<std::shared_mutex> guard(lock);
+            alignas(inotify_event) char buffer[4096];
+            while (true) {
+                ssize_t length = read(inotify, buffer, sizeof(buffer));
+                if (length <= 0) {
+                    break;
+                }
+                for (char *p = buffer; p < buffer + length;) {
+                    auto *event = reinterpret_cast<inotify_event *>(p);
+                    p += sizeof(inotify_event) + event->len;
+                    if (event->mask & IN_Q_OVERFLOW) {
+                        overflowed = true;
+                        continue;
+                    }
+                    handleEvent(*event, changed);
+                }
+            }
+        }
+        if (overflowed) {
+            LOG_WARN("missed file change notifications; rescanning assets");
+            rescan();
+        }
+        if (onChange) {
+            for (auto &path : changed) {
+                onChange(path);
+            }
+        }
+#endif
+    }
+
+    void rescan() override {
+        std::unique_lock<std::shared_mutex> guard(lock);
+#ifdef KRIT_LINUX
+        for (auto &it : watches) {
+            inotify_rm_watch(inotify, it.first);
+        }
+        watches.clear();
+#endif
+        for (auto &archive : archives) {
+            index(*archive);
+        }
+    }
+
+private:
+    static std::string parentKey(const std::string &key) {
+        size_t slash = key.rfind('/');
+        return slash == std::string::npos ? std::string()
+                                          : key.substr(0, slash);
+    }
+
+    bool contains(ArchiveInfo &archive, const std::filesystem::path &path) {
+        std::string key;
+        if (archive.indexed && indexKey(path, key)) {
+            return key.empty() || archive.entries.count(key);
+        }
+        return engine->platform->exists(archive.path / path);
+    }
+
+    ArchiveInfo *locate(const std::filesystem::path &path) {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        for (auto &archive : archives) {
+            if (archive->enabled && contains(*archive, path)) {
+                return archive.get();
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * Walk the root (or just the directory `dir` under it) into its index.
+     * Requires the lock.
+     */
+    void index(ArchiveInfo &archive, const std::string &dir = "") {
+        if (dir.empty()) {
+            archive.entries.clear();
+            archive.indexed = false;
+        }
+        std::error_code error;
+        auto start = archive.path / dir;
+        if (!std::filesystem::is_directory(start, error)) {
+            return;
+        }
+        watch(archive, dir);
+        auto options =
+            std::filesystem::directory_options::follow_directory_symlink |
+            std::filesystem::directory_options::skip_permission_denied;
+        for (auto it = std::filesystem::recursive_directory_iterator(
+                 start, options, error);
+             !error && it != std::filesystem::recursive_directory_iterator();
+             it.increment(error)) {
+            std::string key =
+                it->path().lexically_relative(archive.path).generic_string();
+            archive.entries.insert(key);
+            if (it->is_directory(error)) {
+                watch(archive, key);
+            }
+        }
+        if (error) {
+            LOG_WARN("couldn't index %s: %s", start.c_str(),
+                     error.message().c_str());
+            if (dir.empty()) {
+                archive.entries.clear();
+            }
+            return;
+        }
+        if (dir.empty()) {
+            archive.indexed = true;
+            AREA_LOG_INFO("io", "indexed %zu entries in %s",
+                          archive.entries.size(), archive.path.c_str());
+        }
+    }
+
+    void watch(ArchiveInfo &archive, const std::string &dir) {
+#ifdef KRIT_LINUX
+        if (inotify == -1) {
+            inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (inotify == -1) {
+                LOG_WARN("inotify unavailable; asset changes won't be seen "
+                         "until rescan");
+                return;
+            }
+        }
+        auto dirPath = archive.path / dir;
+        int wd = inotify_add_watch(inotify, dirPath.c_str(),
+                                   IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                       IN_MOVED_TO | IN_CLOSE_WRITE |
+                                       IN_ONLYDIR);
+        if (wd == -1) {
+            return;
+        }
+        auto range = watches.equal_range(wd);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second.archive == &archive) {
+                return;
+            }
+        }
+        watches.emplace(wd, Watch{&archive, dir});
+#endif
+    }
+
+#ifdef KRIT_LINUX
+    void handleEvent(inotify_event &event, std::vector<std::string> &changed) {
+        if (event.mask & IN_IGNORED) {
+            watches.erase(event.wd);
+            return;
+        }
+        if (!event.len) {
+            return;
+        }
+        std::vector<Watch> targets;
+        auto range = watches.equal_range(event.wd);
+        for (auto it = range.first; it != range.second; ++it) {
+            targets.push_back(it->second);
+        }
+        for (auto &target : targets) {
+            ArchiveInfo &archive = *target.archive;
+            if (!archive.indexed) {
+                continue;
+            }
+            std::string key = joinKey(target.dir, event.name);
+            bool isDir = event.mask & IN_ISDIR;
+            if (event.mask & (IN_CREATE | IN_MOVED_TO)) {
+                archive.entries.insert(key);
+                if (isDir) {
+                    // it may have arrived with contents
+                    index(archive, key);
+                }
+            }
+            if (event.mask & (IN_DELETE | IN_MOVED_FROM)) {
+                archive.entries.erase(key);
+                if (isDir) {
+                    std::string prefix = key + "/";
+                    for (auto it = archive.entries.begin();
+                         it != archive.entries.end();) {
+                        if (!it->compare(0, prefix.size(), prefix)) {
+                            it = archive.entries.erase(it);
+                        } else {
+                            ++it;
+                        }
+                    }
+                }
+            }
+            if (!isDir && (event.mask & (IN_CLOSE_WRITE | IN_MOVED_TO))) {
+                changed.push_back(key);
+            }
+        }
+    }
+#endif
 };
 
 namespace {
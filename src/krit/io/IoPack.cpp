@@ -0,0 +1,269 @@
+#include "krit/Engine.h"
+#include "krit/io/Io.h"
+#include "krit/io/PackFormat.h"
+#include "krit/utils/Panic.h"
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <zlib.h>
+
+namespace krit {
+
+/**
+ * Pack archive backend; see PackFormat.h for the format.
+ *
+ * The archive is mapped once when it's mounted and the table of contents is
+ * searched in place. Stored entries are returned as views of the mapping;
+ * deflated ones are inflated into their own buffer. Deflated entries are
+ * always checked against their content hash; stored ones only in development
+ * builds, as hashing them would cost more than the read they replace.
+ */
+struct IoPack : public Io {
+    struct ArchiveInfo {
+        std::filesystem::path path;
+        bool enabled;
+        FileBytes bytes;
+        const PackEntry *toc;
+        size_t entryCount;
+        const char *names;
+
+        std::string_view name(const PackEntry &entry) const {
+            return std::string_view(names + entry.nameOffset,
+                                    entry.nameLength);
+        }
+
+        const PackEntry *findEntry(std::string_view path) const {
+            return findPackEntry(toc, entryCount, names, path);
+        }
+    };
+
+    // never shrinks, so archives can be used outside of the lock once found
+    std::vector<std::unique_ptr<ArchiveInfo>> archives;
+    std::once_flag initialized;
+    std::shared_mutex lock;
+
+    IoPack() {}
+
+    bool addRoot(const std::filesystem::path &path) override {
+        if (!engine->platform->exists(path)) {
+            LOG_WARN("couldn't add missing asset root: %s\n", path.c_str());
+            return false;
+        }
+        auto archive = std::make_unique<ArchiveInfo>();
+        archive->path = path;
+        archive->enabled = true;
+        if (auto mapped = FileBytes::map(path)) {
+            archive->bytes = std::move(*mapped);
+        } else {
+            archive->bytes =
+                FileBytes::owned(engine->platform->readFile(path));
+        }
+        if (!mount(*archive)) {
+            return false;
+        }
+        std::unique_lock<std::shared_mutex> guard(lock);
+        for (auto &a : archives) {
+            if (a->path == path) {
+                return false;
+            }
+        }
+        archives.push_back(std::move(archive));
+        return true;
+    }
+
+    bool hasRoot(const std::filesystem::path &path) override {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        for (auto &a : archives) {
+            if (a->path == path) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool enableRoot(const std::filesystem::path &path) override {
+        std::unique_lock<std::shared_mutex> guard(lock);
+        for (auto &a : archives) {
+            if (a->path == path) {
+                if (!a->enabled) {
+                    a->enabled = true;
+                    return true;
+                } else {
+                    return false;
+                }
+            }
+        }
+        return false;
+    }
+
+    bool disableRoot(const std::filesystem::path &path) override {
+        std::unique_lock<std::shared_mutex> guard(lock);
+        for (auto &a : archives) {
+            if (a->path == path) {
+                if (a->enabled) {
+                    a->enabled = false;
+                    return true;
+                } else {
+                    return false;
+                }
+            }
+        }
+        return false;
+    }
+
+    void init() {
+        std::call_once(initialized, [this]() { addRoot("assets.pack"); });
+    }
+
+    FileBytes readBytes(const std::filesystem::path &path) override {
+        init();
+        auto s = path.string();
+        const PackEntry *entry;
+        ArchiveInfo *archive = locate(s, entry);
+        if (!archive) {
+            // FIXME: return optional instead of panic
+            panic("failed to find file in pack archives: %s", s.c_str());
+        }
+        FileBytes stored =
+            archive->bytes.slice(entry->offset, entry->storedSize);
+        switch (entry->compression) {
+            case PackStored: {
+#if !KRIT_RELEASE
+                checkContentHash(*archive, *entry, s, stored);
+#endif
+                return stored;
+            }
+            case PackDeflate: {
+                std::string buffer;
+                buffer.resize(entry->size);
+                uLongf length = entry->size;
+                if (uncompress((Bytef *)buffer.data(), &length,
+                               (const Bytef *)stored.data(),
+                               stored.size()) != Z_OK ||
+                    length != entry->size) {
+                    panic("failed to inflate %s in %s", s.c_str(),
+                          archive->path.c_str());
+                }
+                FileBytes inflated = FileBytes::owned(std::move(buffer));
+                checkContentHash(*archive, *entry, s, inflated);
+                return inflated;
+            }
+            default: {
+                panic("unsupported compression %u for %s in %s",
+                      entry->compression, s.c_str(), archive->path.c_str());
+            }
+        }
+    }
+
+    std::string readFile(const std::filesystem::path &path) override {
+        return readBytes(path).str();
+    }
+
+    std::optional<std::filesystem::path>
+    find(const std::filesystem::path &path) override {
+        init();
+        const PackEntry *entry;
+        if (ArchiveInfo *archive = locate(path.string(), entry)) {
+            return archive->path;
+        }
+        return {};
+    }
+
+    bool exists(const std::filesystem::path &path) override {
+        init();
+        const PackEntry *entry;
+        return locate(path.string(), entry);
+    }
+
+    std::vector<std::string>
+    readDir(const std::filesystem::path &path) override {
+        init();
+        std::vector<std::string> results;
+        auto s = path.string();
+        std::shared_lock<std::shared_mutex> guard(lock);
+        for (auto &archive : archives) {
+            if (!archive->enabled) {
+                continue;
+            }
+            for (size_t i = 0; i < archive->entryCount; ++i) {
+                std::string_view name = archive->name(archive->toc[i]);
+                if (!name.compare(0, s.size(), s)) {
+                    results.emplace_back(name);
+                }
+            }
+        }
+        return results;
+    }
+
+private:
+    void checkContentHash(const ArchiveInfo &archive, const PackEntry &entry,
+                          const std::string &path, const FileBytes &bytes) {
+        if (crc32(0, (const Bytef *)bytes.data(), bytes.size()) !=
+            entry.contentHash) {
+            panic("content hash mismatch for %s in %s", path.c_str(),
+                  archive.path.c_str());
+        }
+    }
+
+    bool mount(ArchiveInfo &archive) {
+        const FileBytes &bytes = archive.bytes;
+        PackHeader header;
+        if (bytes.size() < sizeof(header)) {
+            LOG_ERROR("not a pack archive: %s", archive.path.c_str());
+            return false;
+        }
+        memcpy(&header, bytes.data(), sizeof(header));
+        if (memcmp(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC))) {
+            LOG_ERROR("not a pack archive: %s", archive.path.c_str());
+            return false;
+        }
+        if (header.version != PACK_VERSION) {
+            LOG_ERROR("unsupported pack archive version %u: %s",
+                      header.version, archive.path.c_str());
+            return false;
+        }
+        if (header.tocOffset % alignof(PackEntry) ||
+            header.tocOffset + header.entryCount * sizeof(PackEntry) >
+                bytes.size() ||
+            header.namesOffset > bytes.size()) {
+            LOG_ERROR("corrupt pack archive: %s", archive.path.c_str());
+            return false;
+        }
+        archive.toc = reinterpret_cast<const PackEntry *>(bytes.data() +
+                                                          header.tocOffset);
+        archive.entryCount = header.entryCount;
+        archive.names = bytes.data() + header.namesOffset;
+        for (size_t i = 0; i < archive.entryCount; ++i) {
+            const PackEntry &entry = archive.toc[i];
+            if (entry.offset + entry.storedSize > bytes.size() ||
+                header.namesOffset + entry.nameOffset + entry.nameLength >
+                    bytes.size()) {
+                LOG_ERROR("corrupt pack archive: %s", archive.path.c_str());
+                return false;
+            }
+        }
+        AREA_LOG_INFO("io", "mounted %zu entries from %s", archive.entryCount,
+                      archive.path.c_str());
+        return true;
+    }
+
+    ArchiveInfo *locate(const std::string &name, const PackEntry *&entry) {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        for (auto &archive : archives) {
+            if (archive->enabled && (entry = archive->findEntry(name))) {
+                return archive.get();
+            }
+        }
+        return nullptr;
+    }
+};
+
+namespace {
+IoPack pack;
+}
+
+Io *ioPack = &pack;
+
+}
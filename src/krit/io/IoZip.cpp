@@ -1,51 +1,98 @@
 #include "krit/Engine.h"
 #include "krit/io/Io.h"
+#include "krit/io/ZipIndex.h"
 #include "krit/utils/Panic.h"
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 // #define ZIP_STATIC 1
 #include <zip.h>
 
 namespace krit {
 
+/**
+ * Zip archive backend.
+ *
+ * Each archive's central directory is read once when it's added, into an
+ * index of entry names, so lookups never touch libzip. libzip handles can't
+ * be shared between threads, so reads go through a handle per thread and
+ * archive; worker threads loading assets decompress in parallel.
+ */
 struct IoZip : public Io {
     struct ArchiveInfo {
         // TODO: maybe use an ID here rather than the path
         std::filesystem::path path;
-        zip_t *zip;
+        size_t id;
         bool enabled;
+        ZipIndex index;
     };
 
-    std::vector<ArchiveInfo> archives;
-    std::vector<bool> enabled;
-    bool initialized = false;
-
-    IoZip() {}
+    /**
+     * This thread's open handles, by archive ID. Closed when the thread
+     * exits.
+     */
+    struct ThreadHandles {
+        std::vector<zip_t *> handles;
+
+        ~ThreadHandles() {
+            for (auto handle : handles) {
+                if (handle) {
+                    zip_discard(handle);
+                }
+            }
+        }
 
-    ~IoZip() {
-        for (auto archive : archives) {
-            zip_close(archive.zip);
+        zip_t *get(ArchiveInfo &archive) {
+            if (archive.id >= handles.size()) {
+                handles.resize(archive.id + 1);
+            }
+            zip_t *&handle = handles[archive.id];
+            if (!handle) {
+                int error = 0;
+                handle = zip_open(archive.path.c_str(), ZIP_RDONLY, &error);
+                if (!handle) {
+                    panic("failed to open zip archive %s (error=%i)",
+                          archive.path.c_str(), error);
+                }
+            }
+            return handle;
         }
-    }
+    };
+
+    // never shrinks, so archives can be used outside of the lock once found
+    std::vector<std::unique_ptr<ArchiveInfo>> archives;
+    std::once_flag initialized;
+    // guards `archives`; reads only need a shared lock
+    std::shared_mutex lock;
+
+    IoZip() {}
 
     bool addRoot(const std::filesystem::path &path) override {
-        if (hasRoot(path)) {
+        if (!engine->platform->exists(path)) {
+            LOG_WARN("couldn't add missing asset root: %s\n", path.c_str());
             return false;
         }
-        if (engine->platform->exists(path)) {
-            zip_source_t *source =
-                zip_source_file_create(path.string().c_str(), 0, 0, nullptr);
-            zip_t *archive = zip_open_from_source(source, ZIP_RDONLY, nullptr);
-            archives.push_back(
-                (ArchiveInfo){.path = path, .zip = archive, .enabled = true});
-            return true;
+        auto archive = std::make_unique<ArchiveInfo>();
+        archive->path = path;
+        archive->enabled = true;
+        if (!indexArchive(*archive)) {
+            return false;
         }
-        LOG_WARN("couldn't add missing asset root: %s\n", path.c_str());
-        return false;
+        std::unique_lock<std::shared_mutex> guard(lock);
+        for (auto &a : archives) {
+            if (a->path == path) {
+                return false;
+            }
+        }
+        archive->id = archives.size();
+        archives.push_back(std::move(archive));
+        return true;
     }
 
     bool hasRoot(const std::filesystem::path &path) override {
+        std::shared_lock<std::shared_mutex> guard(lock);
         for (auto &a : archives) {
-            if (a.path == path) {
+            if (a->path == path) {
                 return true;
             }
         }
@@ -53,10 +100,11 @@ struct IoZip : public Io {
     }
 
     bool enableRoot(const std::filesystem::path &path) override {
+        std::unique_lock<std::shared_mutex> guard(lock);
         for (auto &a : archives) {
-            if (a.path == path) {
-                if (!a.enabled) {
-                    a.enabled = true;
+            if (a->path == path) {
+                if (!a->enabled) {
+                    a->enabled = true;
                     return true;
                 } else {
                     return false;
@@ -67,10 +115,11 @@ struct IoZip : public Io {
     }
 
     bool disableRoot(const std::filesystem::path &path) override {
+        std::unique_lock<std::shared_mutex> guard(lock);
         for (auto &a : archives) {
-            if (a.path == path) {
-                if (a.enabled) {
-                    a.enabled = false;
+            if (a->path == path) {
+                if (a->enabled) {
+                    a->enabled = false;
                     return true;
                 } else {
                     return false;
@@ -81,113 +130,114 @@ struct IoZip : public Io {
     }
 
     void init() {
-        if (initialized) {
-            return;
-        }
-        initialized = true;
-        addRoot("assets.zip");
+        std::call_once(initialized, [this]() { addRoot("assets.zip"); });
     }
 
     std::string readFile(const std::filesystem::path &path) override {
         LOG_DEBUG("read file: %s", path.string().c_str());
         init();
-        if (!archives.empty()) {
-            auto s = path.string();
-            zip_stat_t stat;
-            zip_stat_init(&stat);
-            for (auto &archive : archives) {
-                if (!archive.enabled) {
-                    continue;
-                }
-                zip_stat(archive.zip, s.c_str(), 0, &stat);
-                int index = zip_name_locate(archive.zip, s.c_str(), 0);
-                if (index == -1) {
-                    continue;
-                }
-                std::string buffer;
-                buffer.resize(stat.size);
-                zip_file_t *f = zip_fopen_index(archive.zip, index, 0);
-                if (!f) {
-                    panic("failed to open file in zip archive: %s", s.c_str());
-                }
-                int bytes = stat.size;
-                char *cur = buffer.data();
-                while (bytes) {
-                    int read = zip_fread(f, cur, bytes);
-                    if (read == -1) {
-                        panic(
-                            "error reading file in zip archive: %s (error=%i)",
-                            s.c_str(), read);
-                    }
-                    bytes -= read;
-                    cur += read;
-                }
-                zip_fclose(f);
-                return buffer;
+        auto s = path.string();
+        zip_uint64_t index;
+        ArchiveInfo *archive = locate(s, index);
+        if (!archive) {
+            // FIXME: return optional instead of panic
+            panic("failed to find file in zip archives: %s", s.c_str());
+        }
+        static thread_local ThreadHandles threadHandles;
+        zip_t *handle = threadHandles.get(*archive);
+        std::string buffer;
+        buffer.resize(archive->index.entries[index].size);
+        zip_file_t *f = zip_fopen_index(handle, index, 0);
+        if (!f) {
+            panic("failed to open file in zip archive: %s", s.c_str());
+        }
+        zip_uint64_t bytes = buffer.size();
+        char *cur = buffer.data();
+        while (bytes) {
+            zip_int64_t read = zip_fread(f, cur, bytes);
+            if (read <= 0) {
+                panic("error reading file in zip archive: %s (error=%i)",
+                      s.c_str(), (int)read);
             }
+            bytes -= read;
+            cur += read;
         }
-        // FIXME: return optional instead of panic
-        panic("failed to find file in zip archives: %s", path.string().c_str());
+        zip_fclose(f);
+        return buffer;
     }
 
     std::optional<std::filesystem::path>
     find(const std::filesystem::path &path) override {
         init();
-        if (!archives.empty()) {
-            auto s = path.string();
-            for (auto &archive : archives) {
-                if (!archive.enabled) {
-                    continue;
-                }
-                int index = zip_name_locate(archive.zip, s.c_str(), 0);
-                if (index != -1) {
-                    return archive.path;
-                }
-            }
+        zip_uint64_t index;
+        if (ArchiveInfo *archive = locate(path.string(), index)) {
+            return archive->path;
         }
         return {};
     }
 
     bool exists(const std::filesystem::path &path) override {
         init();
-        if (!archives.empty()) {
-            auto s = path.string();
-            for (auto &archive : archives) {
-                if (!archive.enabled) {
-                    continue;
-                }
-                int index = zip_name_locate(archive.zip, s.c_str(), 0);
-                if (index != -1) {
-                    return true;
-                }
-            }
-        }
-        return false;
+        zip_uint64_t index;
+        return locate(path.string(), index);
     }
 
     std::vector<std::string>
     readDir(const std::filesystem::path &path) override {
         init();
         std::vector<std::string> results;
-        if (!archives.empty()) {
-            auto s = path.string();
-            for (auto &archive : archives) {
-                if (!archive.enabled) {
-                    continue;
-                }
-                zip_int64_t num_entries =
-                    zip_get_num_entries(archive.zip, /*flags=*/0);
-                for (zip_int64_t i = 0; i < num_entries; ++i) {
-                    const char *name =
-                        zip_get_name(archive.zip, i, /*flags=*/0);
-                    if (!strncmp(name, s.c_str(), s.size())) {
-                        results.push_back(name);
-                    }
+        auto s = path.string();
+        std::shared_lock<std::shared_mutex> guard(lock);
+        for (auto &archive : archives) {
+            if (!archive->enabled) {
+                continue;
+            }
+            for (auto &entry : archive->index.entries) {
+                if (!entry.name.compare(0, s.size(), s)) {
+                    results.push_back(entry.name);
                 }
             }
         }
         return results;
     }
+
+private:
+    bool indexArchive(ArchiveInfo &archive) {
+        int error = 0;
+        zip_t *zip = zip_open(archive.path.c_str(), ZIP_RDONLY, &error);
+        if (!zip) {
+            LOG_ERROR("failed to open zip archive %s (error=%i)",
+                      archive.path.c_str(), error);
+            return false;
+        }
+        zip_int64_t count = zip_get_num_entries(zip, 0);
+        archive.index.reserve(count);
+        zip_stat_t stat;
+        for (zip_int64_t i = 0; i < count; ++i) {
+            zip_stat_init(&stat);
+            if (zip_stat_index(zip, i, 0, &stat) ||
+                !(stat.valid & ZIP_STAT_NAME) ||
+                !(stat.valid & ZIP_STAT_SIZE)) {
+                archive.index.skip();
+                continue;
+            }
+            archive.index.add(stat.name, stat.size);
+        }
+        zip_discard(zip);
+        AREA_LOG_INFO("io", "indexed %zu entries in %s", archive.index.size(),
+                      archive.path.c_str());
+        return true;
+    }
+
+    ArchiveInfo *locate(const std::string &name, zip_uint64_t &index) {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        for (auto &archive : archives) {
+            if (archive->enabled && archive->index.find(name, index)) {
+                return archive.get();
+            }
+        }
+        return nullptr;
+    }
 };
 
 namespace {
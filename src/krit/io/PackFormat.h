@@ -0,0 +1,92 @@
+#ifndef KRIT_IO_PACKFORMAT
+#define KRIT_IO_PACKFORMAT
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace krit {
+
+/**
+ * Pack archives, as written by tools/pack/pack.py. All integers are little
+ * endian:
+ *
+ *   PackHeader
+ *   PackEntry[entryCount], sorted by nameHash
+ *   entry names, not terminated
+ *   entry data, each starting on an `alignment` boundary
+ */
+struct PackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t alignment;
+    uint64_t tocOffset;
+    uint64_t namesOffset;
+};
+
+struct PackEntry {
+    // packHash of the entry's path
+    uint64_t nameHash;
+    uint64_t offset;
+    // bytes in the archive
+    uint64_t storedSize;
+    // bytes once decompressed
+    uint64_t size;
+    // CRC-32 of the decompressed contents
+    uint64_t contentHash;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t compression;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(PackHeader) == 32, "unexpected PackHeader layout");
+static_assert(sizeof(PackEntry) == 56, "unexpected PackEntry layout");
+
+enum PackCompression : uint32_t {
+    PackStored = 0,
+    PackDeflate = 1,
+};
+
+inline const char PACK_MAGIC[4] = {'K', 'P', 'A', 'K'};
+// version 1 hashed contents with FNV-1a
+inline const uint32_t PACK_VERSION = 2;
+
+/**
+ * FNV-1a, which entry names are hashed with.
+ */
+inline uint64_t packHash(std::string_view s) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (char c : s) {
+        hash ^= (uint8_t)c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+/**
+ * Find the entry named `path` in a table of contents, or return null.
+ */
+inline const PackEntry *findPackEntry(const PackEntry *toc, size_t entryCount,
+                                      const char *names,
+                                      std::string_view path) {
+    uint64_t hash = packHash(path);
+    const PackEntry *end = toc + entryCount;
+    const PackEntry *it = std::lower_bound(
+        toc, end, hash, [](const PackEntry &entry, uint64_t hash) {
+            return entry.nameHash < hash;
+        });
+    for (; it != end && it->nameHash == hash; ++it) {
+        if (std::string_view(names + it->nameOffset, it->nameLength) ==
+            path) {
+            return it;
+        }
+    }
+    return nullptr;
+}
+
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef KRIT_IO_ZIPINDEX
+#define KRIT_IO_ZIPINDEX
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace krit {
+
+/**
+ * The entries of a zip archive's central directory, by name, so lookups
+ * never touch libzip.
+ */
+struct ZipIndex {
+    struct Entry {
+        std::string name;
+        uint64_t size;
+    };
+
+    // in archive order, so positions are libzip indices; a deque, since
+    // `byName` points into the names
+    std::deque<Entry> entries;
+    std::unordered_map<std::string_view, uint64_t> byName;
+
+    void reserve(size_t count) { byName.reserve(count); }
+
+    void add(std::string name, uint64_t size) {
+        entries.push_back(Entry{std::move(name), size});
+        byName.emplace(entries.back().name, entries.size() - 1);
+    }
+
+    /**
+     * Add a placeholder for an entry which couldn't be read, to keep
+     * positions lined up with the archive's.
+     */
+    void skip() { entries.push_back(Entry{"", 0}); }
+
+    /**
+     * Find an entry and its libzip index, or return null.
+     */
+    const Entry *find(std::string_view name, uint64_t &index) const {
+        auto it = byName.find(name);
+        if (it == byName.end()) {
+            return nullptr;
+        }
+        index = it->second;
+        return &entries[it->second];
+    }
+
+    size_t size() const { return byName.size(); }
+};
+
+}
+
+#endif
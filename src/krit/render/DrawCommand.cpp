@@ -5,6 +5,7 @@
 #include "krit/math/Matrix.h"
 #include "krit/render/DrawKey.h"
 #include "krit/render/ImageData.h"
+#include "krit/render/RenderContext.h"
 #include <memory>
 
 namespace krit {
@@ -69,10 +70,32 @@ DrawCall &DrawCommandBuffer::getDrawCall(const DrawKey &key, int zIndex) {
     return call;
 }
 
+static float cameraScale(RenderContext &ctx) {
+    return ctx.camera ? std::max(ctx.camera->scale.x, ctx.camera->scale.y) : 1;
+}
+
+// report how many screen pixels per image pixel a textured triangle covers
+static void noteTriangleScale(RenderContext &ctx, const DrawKey &key,
+                              const Triangle &t, const Triangle &uv) {
+    ImageData *img = key.image.get();
+    if (!img || !img->residencyTracked) {
+        return;
+    }
+    float area = std::abs((t.p2.x - t.p1.x) * (t.p3.y - t.p1.y) -
+                          (t.p3.x - t.p1.x) * (t.p2.y - t.p1.y));
+    float uvArea = std::abs((uv.p2.x - uv.p1.x) * (uv.p3.y - uv.p1.y) -
+                            (uv.p3.x - uv.p1.x) * (uv.p2.y - uv.p1.y)) *
+                   img->width() * img->height();
+    if (uvArea > 0) {
+        img->noteDrawScale(std::sqrt(area / uvArea) * cameraScale(ctx));
+    }
+}
+
 void DrawCommandBuffer::addTriangle(RenderContext &ctx, const DrawKey &key,
                                     const Triangle &t, const Triangle &uv,
                                     const Color &color, int zIndex) {
     if (color.a > 0 || key.shader) {
+        noteTriangleScale(ctx, key, t, uv);
         DrawCall &call = this->getDrawCall(key, zIndex);
         addTriangle(call, t, uv, color, color, color);
     }
@@ -83,6 +106,7 @@ void DrawCommandBuffer::addTriangle(RenderContext &ctx, const DrawKey &key,
                                     const Color &color1, const Color &color2,
                                     const Color &color3, int zIndex) {
     if (color1.a > 0 || color2.a > 0 || color3.a > 0 || key.shader) {
+        noteTriangleScale(ctx, key, t, uv);
         DrawCall &call = this->getDrawCall(key, zIndex);
         addTriangle(call, t, uv, color1, color2, color3);
     }
@@ -188,6 +212,13 @@ void DrawCommandBuffer::addRect(RenderContext &ctx, const DrawKey &key,
     ll = matrix * ll;
     lr = matrix * lr;
 
+    if (imageData && imageData->residencyTracked && rect.width &&
+        rect.height) {
+        float sx = std::hypot(ur.x - ul.x, ur.y - ul.y) / rect.width;
+        float sy = std::hypot(ll.x - ul.x, ll.y - ul.y) / rect.height;
+        imageData->noteDrawScale(std::max(sx, sy) * cameraScale(ctx));
+    }
+
     size_t i = vertexData.size();
     vertexData.resize(i + 4);
     addVertex(vertexData[i], ul.x, ul.y, ul.z, uvx1, uvy1, color);
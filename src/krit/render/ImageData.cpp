@@ -7,7 +7,24 @@ namespace krit {
 
 ImageData::ImageData(uint8_t *data, size_t width, size_t height)
     : dimensions(width, height) {
-    engine->taskManager->pushRender([this, data]() {
+    if (data) {
+        // the texture becomes visible once the upload finishes
+        unsigned sequence = startUpload();
+        engine->taskManager->pushRender(
+            [token = uploadToken, sequence, data, width, height]() {
+                LOG_DEBUG("callback: create image data (%zux%zu)", width,
+                          height);
+                TextureUpload upload;
+                upload.pixels = data;
+                upload.width = width;
+                upload.height = height;
+                upload.release = [data]() { delete[] data; };
+                upload.onComplete = uploadFinisher(token, sequence);
+                engine->renderer.uploader.upload(std::move(upload));
+            });
+        return;
+    }
+    engine->taskManager->pushRender([this]() {
         int width = this->dimensions.x, height = this->dimensions.y;
         LOG_DEBUG("callback: create image data (%ix%i)", width, height);
         // upload texture
@@ -20,19 +37,18 @@ ImageData::ImageData(uint8_t *data, size_t width, size_t height)
         }
         this->texture = texture;
         checkForGlErrors("gen textures");
-        if (data) {
-            glBindTexture(GL_TEXTURE_2D, texture);
-            checkForGlErrors("bind texture");
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
-                         GL_UNSIGNED_BYTE, data);
-            checkForGlErrors("texImage2D");
-            glBindTexture(GL_TEXTURE_2D, 0);
-            delete[] data;
-        }
     });
 }
 
 ImageData::~ImageData() {
+    if (uploadToken) {
+        // uploads still in flight will delete their own textures
+        std::lock_guard<std::mutex> guard(uploadToken->lock);
+        uploadToken->img = nullptr;
+    }
+    if (atlasPage && engine) {
+        engine->renderer.atlas.release(*this);
+    }
     if (engine && engine->running && texture && owned) {
         GLuint tex = this->texture;
         engine->taskManager->pushRender([tex]() {
@@ -42,19 +58,103 @@ ImageData::~ImageData() {
     }
 }
 
+unsigned ImageData::startUpload() {
+    if (!uploadToken) {
+        uploadToken = std::make_shared<UploadToken>();
+        uploadToken->img = this;
+    }
+    return ++uploadToken->started;
+}
+
+std::function<void(GLuint)>
+ImageData::uploadFinisher(std::shared_ptr<UploadToken> token,
+                          unsigned sequence) {
+    return [token, sequence](GLuint texture) {
+        std::lock_guard<std::mutex> guard(token->lock);
+        ImageData *img = token->img;
+        // uploads can finish out of order; never let older pixels replace
+        // newer ones
+        if (!img || sequence < token->applied) {
+            glDeleteTextures(1, &texture);
+            return;
+        }
+        token->applied = sequence;
+        img->replaceTexture(texture, img->scale, img->gpuBytes,
+                            img->compressed);
+    };
+}
+
 void ImageData::update(uint8_t *data, GLuint mode, bool free) {
     assert(data);
-    engine->taskManager->pushRender([this, data, free, mode]() {
-        glBindTexture(GL_TEXTURE_2D, texture);
+    unsigned sequence = startUpload();
+    if (free) {
+        // we own the data, so it can be uploaded over several frames into a
+        // new texture which replaces the current one when it's done
+        engine->taskManager->pushRender([token = uploadToken, sequence, data,
+                                         mode, width = width(),
+                                         height = height()]() {
+            TextureUpload upload;
+            upload.pixels = data;
+            upload.width = width;
+            upload.height = height;
+            upload.bytesPerPixel = mode == GL_RED                    ? 1
+                                   : mode == GL_RGB || mode == GL_BGR ? 3
+                                                                      : 4;
+            upload.format = mode;
+            upload.release = [data]() { delete[] data; };
+            upload.onComplete = uploadFinisher(token, sequence);
+            engine->renderer.uploader.upload(std::move(upload));
+        });
+        return;
+    }
+    engine->taskManager->pushRender([token = uploadToken, sequence, data,
+                                     mode]() {
+        std::lock_guard<std::mutex> guard(token->lock);
+        ImageData *img = token->img;
+        if (!img) {
+            return;
+        }
+        // anything still uploading from before this is now out of date
+        token->applied = sequence;
+        if (!img->texture) {
+            glGenTextures(1, &img->texture);
+        }
+        glBindTexture(GL_TEXTURE_2D, img->texture);
         checkForGlErrors("bind texture");
-        glTexImage2D(GL_TEXTURE_2D, 0, mode, width(), height(), 0, mode,
-                     GL_UNSIGNED_BYTE, data);
+        glTexImage2D(GL_TEXTURE_2D, 0, mode, img->width(), img->height(), 0,
+                     mode, GL_UNSIGNED_BYTE, data);
         checkForGlErrors("texImage2D");
         glBindTexture(GL_TEXTURE_2D, 0);
-        if (free) {
-            delete[] data;
-        }
     });
 }
 
+void ImageData::replaceTexture(GLuint texture, float scale, size_t gpuBytes,
+                               bool compressed) {
+    if (this->texture && owned) {
+        glDeleteTextures(1, &this->texture);
+    }
+    this->texture = texture;
+    this->scale = scale;
+    this->gpuBytes = gpuBytes;
+    this->compressed = compressed;
+    this->hasMipmaps = false;
+}
+
+void ImageData::whenReady(std::function<void()> &&callback) {
+    if (loading) {
+        readyCallbacks.push_back(std::move(callback));
+    } else {
+        callback();
+    }
+}
+
+void ImageData::finishLoading() {
+    loading = false;
+    std::vector<std::function<void()>> callbacks;
+    callbacks.swap(readyCallbacks);
+    for (auto &callback : callbacks) {
+        callback();
+    }
+}
+
 }
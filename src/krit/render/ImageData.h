@@ -3,6 +3,10 @@
 
 #include "krit/Math.h"
 #include "krit/render/Gl.h"
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace krit {
 
@@ -22,6 +26,21 @@ struct ImageData {
     IntDimensions dimensions;
     WrapMode wrap = WrapClampEdge;
     bool owned = true;
+    // the texture uses a GPU block-compressed format with a prebuilt mip chain
+    bool compressed = false;
+    // texture memory used by all mip levels, if known
+    size_t gpuBytes = 0;
+    // largest on-screen texel density this image was drawn at since the last
+    // TextureResidency update; only recorded for tracked images
+    float drawnScale = 0;
+    bool residencyTracked = false;
+    // for images packed by the RuntimeAtlas: the page, this image's rect on
+    // it in logical coordinates, and its padded slot in pixels
+    std::shared_ptr<ImageData> atlasPage;
+    IntRectangle atlasRect;
+    IntRectangle atlasSlot;
+    // set by the loader while the texture is still on its way; see whenReady
+    bool loading = false;
 
     ImageData(GLuint texture, IntDimensions dimensions)
         : texture(texture), dimensions(dimensions) {}
@@ -36,8 +55,59 @@ struct ImageData {
 
     void update(uint8_t *data, GLuint mode = GL_RGBA, bool free = false);
 
+    /**
+     * Swap in a different resolution of the same image; the logical
+     * dimensions are unchanged. Must be called on the render thread.
+     */
+    void replaceTexture(GLuint texture, float scale, size_t gpuBytes,
+                        bool compressed);
+
+    /**
+     * Call `callback` on the main thread once this image's texture is ready
+     * to draw, or right away if it isn't loading. Must be called on the main
+     * thread.
+     */
+    void whenReady(std::function<void()> &&callback);
+
+    /**
+     * Called on the main thread by the loader once the texture is in place.
+     */
+    void finishLoading();
+
+    void invalidateMipmaps() { hasMipmaps = false; }
+
+    /**
+     * Record that this image is being drawn at `drawScale` screen pixels per
+     * logical pixel.
+     */
+    void noteDrawScale(float drawScale) {
+        if (residencyTracked && drawScale > drawnScale) {
+            drawnScale = drawScale;
+        }
+    }
+
 private:
+    /**
+     * Shared with uploads of this image's pixels which are still in flight,
+     * since they can outlive it and finish in any order.
+     */
+    struct UploadToken {
+        std::mutex lock;
+        // null once the image is destroyed
+        ImageData *img = nullptr;
+        // sequence numbers of the last upload started, on the main thread,
+        // and of the one whose pixels are in the texture now
+        unsigned started = 0;
+        unsigned applied = 0;
+    };
+
     bool hasMipmaps = false;
+    std::vector<std::function<void()>> readyCallbacks;
+    std::shared_ptr<UploadToken> uploadToken;
+
+    unsigned startUpload();
+    static std::function<void(GLuint)>
+    uploadFinisher(std::shared_ptr<UploadToken> token, unsigned sequence);
 
     friend struct Renderer;
 };
@@ -13,14 +13,23 @@ struct ImageRegion {
     std::shared_ptr<ImageData> img;
     IntRectangle rect;
     std::string name;
+    // if `img` was packed into a runtime atlas page, the original image,
+    // which keeps its slot alive
+    std::shared_ptr<ImageData> owner;
 
     ImageRegion() : img(nullptr) {}
     ImageRegion(std::shared_ptr<ImageData> img, const IntRectangle &rect)
-        : img(img), rect(rect) {}
+        : img(img), rect(rect) {
+        resolveAtlas();
+    }
     ImageRegion(std::shared_ptr<ImageData> img, int x, int y, int w, int h)
-        : img(img), rect(x, y, w, h) {}
+        : img(img), rect(x, y, w, h) {
+        resolveAtlas();
+    }
     ImageRegion(std::shared_ptr<ImageData> img)
-        : img(img), rect(IntRectangle(0, 0, img->width(), img->height())) {}
+        : img(img), rect(IntRectangle(0, 0, img->width(), img->height())) {
+        resolveAtlas();
+    }
     ImageRegion(const std::string &id);
     ImageRegion(const std::string &id, const IntRectangle &rect);
     ImageRegion(const std::string &id, int x, int y, int w, int h);
@@ -40,7 +49,19 @@ struct ImageRegion {
     }
 
     ImageRegion subRegion(int x, int y, int width, int height) {
-        return ImageRegion(img, this->x() + x, this->y() + y, width, height);
+        ImageRegion region(img, this->x() + x, this->y() + y, width, height);
+        region.owner = owner;
+        return region;
+    }
+
+private:
+    void resolveAtlas() {
+        if (img && img->atlasPage) {
+            owner = img;
+            rect.x += img->atlasRect.x;
+            rect.y += img->atlasRect.y;
+            img = img->atlasPage;
+        }
     }
 };
 
@@ -0,0 +1,74 @@
+#ifndef KRIT_RENDER_PREMULTIPLY
+#define KRIT_RENDER_PREMULTIPLY
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace krit {
+
+/**
+ * Multiply the color channels of one little endian RGBA8 pixel by its alpha,
+ * rounding to nearest. Red and blue, then green and alpha, are scaled
+ * together in 16-bit lanes of a single multiply.
+ */
+inline uint32_t premultiplyPixel(uint32_t pixel) {
+    uint32_t a = pixel >> 24;
+    if (a == 0xff) {
+        return pixel;
+    }
+    // c * a / 255 == (t + (t >> 8)) >> 8 for t = c * a + 128
+    uint32_t rb = (pixel & 0x00ff00ff) * a + 0x00800080;
+    rb = ((rb + ((rb >> 8) & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+    uint32_t g = ((pixel >> 8) & 0xff) * a + 0x80;
+    g = ((g + (g >> 8)) >> 8) & 0xff;
+    return rb | (g << 8) | (a << 24);
+}
+
+/**
+ * Premultiply a `width` x `height` RGBA8 image in place, where rows start
+ * `pitch` bytes apart. Uses SSE2 to do four pixels at a time where it's
+ * available.
+ */
+inline void premultiplyAlpha(uint8_t *pixels, int width, int height,
+                             size_t pitch) {
+    for (int y = 0; y < height; ++y) {
+        uint8_t *row = pixels + y * pitch;
+        int x = 0;
+#ifdef __SSE2__
+        const __m128i zero = _mm_setzero_si128();
+        // multiply alpha by 255, which leaves it as it was
+        const __m128i alphaLanes =
+            _mm_set_epi16(0xff, 0, 0, 0, 0xff, 0, 0, 0);
+        const __m128i half = _mm_set1_epi16(0x80);
+        auto scale = [&](__m128i c) {
+            __m128i a = _mm_shufflehi_epi16(
+                _mm_shufflelo_epi16(c, _MM_SHUFFLE(3, 3, 3, 3)),
+                _MM_SHUFFLE(3, 3, 3, 3));
+            __m128i t = _mm_add_epi16(
+                _mm_mullo_epi16(c, _mm_or_si128(a, alphaLanes)), half);
+            return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+        };
+        for (; x + 4 <= width; x += 4) {
+            __m128i p = _mm_loadu_si128((const __m128i *)(row + x * 4));
+            __m128i lo = scale(_mm_unpacklo_epi8(p, zero));
+            __m128i hi = scale(_mm_unpackhi_epi8(p, zero));
+            _mm_storeu_si128((__m128i *)(row + x * 4),
+                             _mm_packus_epi16(lo, hi));
+        }
+#endif
+        for (; x < width; ++x) {
+            uint32_t pixel;
+            memcpy(&pixel, row + x * 4, 4);
+            pixel = premultiplyPixel(pixel);
+            memcpy(row + x * 4, &pixel, 4);
+        }
+    }
+}
+
+}
+
+#endif
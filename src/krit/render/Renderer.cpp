@@ -5,6 +5,7 @@
 #include "imgui_impl_sdl.h"
 #endif
 #include "krit/Engine.h"
+#include "krit/asset/Ktx2.h"
 #include "krit/editor/Editor.h"
 #include "krit/render/BlendMode.h"
 #include "krit/render/CommandBuffer.h"
@@ -23,7 +24,11 @@
 #include "krit/utils/Profiling.h"
 #include <SDL3/SDL_error.h>
 #include <algorithm>
+#ifdef __EMSCRIPTEN__
+#include <emscripten/html5.h>
+#endif
 #include <cassert>
+#include <cmath>
 #include <memory>
 #include <stdint.h>
 #include <utility>
@@ -46,7 +51,7 @@ void Renderer::setSmoothingMode(SmoothingMode mode, ImageData *img) {
             break;
         }
         case SmoothMipmap: {
-            if (img && !img->hasMipmaps) {
+            if (img && !img->hasMipmaps && !img->compressed) {
                 img->hasMipmaps = true;
                 glGenerateMipmap(GL_TEXTURE_2D);
                 checkForGlErrors("generate mipmaps");
@@ -144,6 +149,24 @@ SpriteShader *Renderer::getDefaultTextShader() {
     return defaultTextSpriteShader;
 }
 
+SpriteShader *Renderer::getSdfTextShader(float threshold) {
+    if (!sdfTextShader) {
+        sdfTextShader = new Shader(
+#include "./renderer.text.vert"
+            ,
+#include "./renderer.sdf.frag"
+        );
+    }
+    // quantize, so nearby border thicknesses share a shader and batch
+    int key = std::round(std::clamp(threshold, 0.0f, 1.0f) * 255);
+    SpriteShader *&shader = sdfTextSpriteShaders[key];
+    if (!shader) {
+        shader = new SpriteShader(sdfTextShader);
+        shader->setUniform("uThreshold", key / 255.0f);
+    }
+    return shader;
+}
+
 // static void GLAPIENTRY glMessageCallback(GLenum source, GLenum type, GLuint
 // id,
 //                                          GLenum severity, GLsizei length,
@@ -158,6 +181,10 @@ SpriteShader *Renderer::getDefaultTextShader() {
 Matrix4 _ortho;
 
 Renderer::Renderer(Window &_window, bool block) : window(_window) {
+    if (window.isHeadless()) {
+        // no context to set up; nothing will be drawn
+        return;
+    }
     checkForGlErrors("context");
 #if KRIT_NO_VSYNC
     SDL_GL_SetSwapInterval(0);
@@ -231,9 +258,62 @@ Renderer::Renderer(Window &_window, bool block) : window(_window) {
 
     glDepthRangef(-1000, 1000);
 
+    detectCompressedFormats();
+
     checkForGlErrors("renderer init");
 }
 
+void Renderer::detectCompressedFormats() {
+#ifdef __EMSCRIPTEN__
+    // WebGL only reports formats whose extensions have been enabled, and
+    // rejects uploads in any others
+    EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context =
+        emscripten_webgl_get_current_context();
+    for (const char *extension :
+         {"WEBGL_compressed_texture_s3tc", "EXT_texture_compression_bptc",
+          "WEBGL_compressed_texture_etc", "WEBGL_compressed_texture_astc"}) {
+        if (!emscripten_webgl_enable_extension(context, extension)) {
+            LOG_DEBUG("WebGL extension %s isn't available", extension);
+        }
+    }
+#endif
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+    if (count > 0) {
+        std::vector<GLint> formats(count);
+        glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats.data());
+        for (GLint format : formats) {
+            compressedFormats.push_back(format);
+        }
+    }
+#if KRIT_USE_GLEW
+    // core profiles aren't required to enumerate extension formats
+    if (GLEW_EXT_texture_compression_s3tc) {
+        compressedFormats.push_back(GL_COMPRESSED_RGB_S3TC_DXT1_EXT);
+        compressedFormats.push_back(GL_COMPRESSED_RGBA_S3TC_DXT1_EXT);
+        compressedFormats.push_back(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+    }
+    if (GLEW_ARB_texture_compression_bptc) {
+        compressedFormats.push_back(GL_COMPRESSED_RGBA_BPTC_UNORM);
+    }
+    if (GLEW_ARB_ES3_compatibility) {
+        compressedFormats.push_back(GL_COMPRESSED_RGB8_ETC2);
+        compressedFormats.push_back(GL_COMPRESSED_RGBA8_ETC2_EAC);
+    }
+    if (GLEW_KHR_texture_compression_astc_ldr) {
+        compressedFormats.push_back(GL_COMPRESSED_RGBA_ASTC_4x4_KHR);
+    }
+#endif
+    checkForGlErrors("compressed texture formats");
+    LOG_INFO("%zu compressed texture formats available",
+             compressedFormats.size());
+}
+
+bool Renderer::supportsCompressedFormat(GLenum format) {
+    return std::find(compressedFormats.begin(), compressedFormats.end(),
+                     format) != compressedFormats.end();
+}
+
 Renderer::~Renderer() {}
 
 template <>
@@ -476,6 +556,9 @@ void Renderer::renderFrame(RenderContext &ctx) {
 
     window.makeCurrent();
 
+    uploader.process();
+    checkForGlErrors("texture uploads");
+
     clear(ctx);
     checkForGlErrors("start frame");
 
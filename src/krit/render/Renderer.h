@@ -8,10 +8,13 @@
 #include "krit/render/DrawCommand.h"
 #include "krit/render/Gl.h"
 #include "krit/render/RenderContext.h"
+#include "krit/render/RuntimeAtlas.h"
+#include "krit/render/TextureUploader.h"
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_mutex.h>
 #include <SDL3/SDL_video.h>
 #include <stddef.h>
+#include <unordered_map>
 #include <vector>
 
 #define BUFFER_OFFSET(bytes) ((GLubyte *)NULL + (bytes))
@@ -24,6 +27,8 @@ struct Renderer {
     static const int DUP_BUFFER_COUNT = 1;
 
     DrawCommandBuffer drawCommandBuffer;
+    TextureUploader uploader;
+    RuntimeAtlas atlas;
 
     Renderer(Window &window, bool block);
     ~Renderer();
@@ -35,6 +40,18 @@ struct Renderer {
     SpriteShader *getDefaultColorShader();
     SpriteShader *getDefaultTextShader();
 
+    /**
+     * Shader for signed distance field glyphs, drawing the edge at
+     * `threshold` (0-1) in the distance field.
+     */
+    SpriteShader *getSdfTextShader(float threshold);
+
+    /**
+     * Whether the driver can sample textures stored in this GL compressed
+     * internal format.
+     */
+    bool supportsCompressedFormat(GLenum format);
+
 private:
     GLuint vao;
     GLuint indexBuffer[DUP_BUFFER_COUNT] = {0};
@@ -42,6 +59,7 @@ private:
     size_t vertexCapacity[DUP_BUFFER_COUNT] = {0};
     std::vector<Rectangle> clipStack;
     std::vector<uint32_t> indexData;
+    std::vector<GLenum> compressedFormats;
     Window &window;
     Camera *currentCamera = nullptr;
     FrameBuffer *currentRenderTarget = nullptr;
@@ -49,6 +67,9 @@ private:
     SpriteShader *defaultTextureSpriteShader{nullptr};
     SpriteShader *defaultColorSpriteShader{nullptr};
     SpriteShader *defaultTextSpriteShader{nullptr};
+    Shader *sdfTextShader{nullptr};
+    // by threshold, in 1/255ths
+    std::unordered_map<int, SpriteShader *> sdfTextSpriteShaders;
 
     int width = 0;
     int height = 0;
@@ -61,6 +82,7 @@ private:
     void clear(RenderContext &ctx);
     void updateClip(RenderContext &ctx);
     void dispatchCommands(RenderContext &ctx);
+    void detectCompressedFormats();
 };
 
 }
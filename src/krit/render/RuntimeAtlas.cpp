@@ -0,0 +1,267 @@
+#include "krit/render/RuntimeAtlas.h"
+#include "krit/Engine.h"
+#include "krit/TaskManager.h"
+#include "krit/render/Gl.h"
+#include "krit/render/ImageData.h"
+#include "krit/render/TextureUploader.h"
+#include "krit/utils/Log.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace krit {
+
+RuntimeAtlas::Page &RuntimeAtlas::newPage(float scale) {
+    auto page = std::make_unique<Page>();
+    page->scale = scale;
+    page->img = std::make_shared<ImageData>();
+    page->img->scale = scale;
+    page->img->dimensions.setTo(pageSize / scale, pageSize / scale);
+    page->img->gpuBytes = (size_t)pageSize * pageSize * 4;
+    std::weak_ptr<ImageData> weak = page->img;
+    int size = pageSize;
+    engine->taskManager->pushRender([weak, size]() {
+        auto img = weak.lock();
+        if (!img) {
+            return;
+        }
+        GLuint texture;
+        glActiveTexture(GL_TEXTURE0);
+        glGenTextures(1, &texture);
+        if (!texture) {
+            LOG_ERROR("failed to generate texture for runtime atlas page");
+        }
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size, size, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, nullptr);
+        checkForGlErrors("runtime atlas page");
+        glBindTexture(GL_TEXTURE_2D, 0);
+        img->texture = texture;
+    });
+    AREA_LOG_INFO("asset", "new runtime atlas page (%zu total)",
+                  pages.size() + 1);
+    pages.push_back(std::move(page));
+    return *pages.back();
+}
+
+bool RuntimeAtlas::pack(Page &page, int width, int height,
+                        IntRectangle &slot) {
+    // reuse the smallest freed slot that fits
+    auto best = page.freeSlots.end();
+    for (auto it = page.freeSlots.begin(); it != page.freeSlots.end(); ++it) {
+        if (it->width >= width && it->height >= height &&
+            (best == page.freeSlots.end() ||
+             it->width * it->height < best->width * best->height)) {
+            best = it;
+        }
+    }
+    if (best != page.freeSlots.end()) {
+        IntRectangle free = *best;
+        page.freeSlots.erase(best);
+        slot.setTo(free.x, free.y, width, height);
+        // give back what's left, split along the shorter leftover edge so
+        // the bigger piece stays as large as possible
+        int right = free.width - width, below = free.height - height;
+        IntRectangle side(slot.right(), free.y, right, free.height);
+        IntRectangle bottom(free.x, slot.bottom(), width, below);
+        if (right < below) {
+            side.height = height;
+            bottom.width = free.width;
+        }
+        if (side.width > 0 && side.height > 0) {
+            page.freeSlots.push_back(side);
+        }
+        if (bottom.width > 0 && bottom.height > 0) {
+            page.freeSlots.push_back(bottom);
+        }
+        return true;
+    }
+
+    // otherwise, the shortest shelf that's tall enough and has room
+    Shelf *found = nullptr;
+    for (auto &shelf : page.shelves) {
+        if (shelf.height >= height && pageSize - shelf.x >= width &&
+            (!found || shelf.height < found->height)) {
+            found = &shelf;
+        }
+    }
+    if (!found) {
+        if (page.nextShelfY + height > pageSize || width > pageSize) {
+            return false;
+        }
+        page.shelves.push_back(Shelf{page.nextShelfY, height, 0});
+        page.nextShelfY += height;
+        found = &page.shelves.back();
+    }
+    slot.setTo(found->x, found->y, width, found->height);
+    found->x += width;
+    return true;
+}
+
+bool RuntimeAtlas::allocate(ImageData &img, IntDimensions size) {
+    if (!enabled() || size.x > maxImageSize || size.y > maxImageSize ||
+        size.x <= 0 || size.y <= 0) {
+        return false;
+    }
+    int width = size.x + PADDING * 2, height = size.y + PADDING * 2;
+    IntRectangle slot;
+    Page *target = nullptr;
+    for (auto &page : pages) {
+        if (page->scale == img.scale && pack(*page, width, height, slot)) {
+            target = page.get();
+            break;
+        }
+    }
+    if (!target) {
+        target = &newPage(img.scale);
+        if (!pack(*target, width, height, slot)) {
+            return false;
+        }
+    }
+    ++target->liveSlots;
+    img.atlasPage = target->img;
+    img.atlasSlot = slot;
+    // the page shares the image's scale, so logical offsets line up
+    img.atlasRect.setTo(std::round((slot.x + PADDING) / img.scale),
+                        std::round((slot.y + PADDING) / img.scale),
+                        img.dimensions.x, img.dimensions.y);
+    return true;
+}
+
+static void copyPixel(uint8_t *to, const uint8_t *from, GLenum format) {
+    switch (format) {
+        case GL_BGRA:
+            to[0] = from[2];
+            to[1] = from[1];
+            to[2] = from[0];
+            to[3] = from[3];
+            break;
+        case GL_RGB:
+            to[0] = from[0];
+            to[1] = from[1];
+            to[2] = from[2];
+            to[3] = 0xff;
+            break;
+        case GL_BGR:
+            to[0] = from[2];
+            to[1] = from[1];
+            to[2] = from[0];
+            to[3] = 0xff;
+            break;
+        case GL_RED:
+            to[0] = from[0];
+            to[1] = to[2] = 0;
+            to[3] = 0xff;
+            break;
+        default:
+            memcpy(to, from, 4);
+    }
+}
+
+void RuntimeAtlas::blit(ImageData &img, TextureUpload &upload) {
+    IntRectangle &slot = img.atlasSlot;
+    int w = std::min(upload.width, slot.width - PADDING * 2);
+    int h = std::min(upload.height, slot.height - PADDING * 2);
+    int paddedWidth = w + PADDING * 2, paddedHeight = h + PADDING * 2;
+    size_t rowBytes = (size_t)paddedWidth * 4;
+    size_t pitch =
+        upload.pitch ? upload.pitch : upload.width * upload.bytesPerPixel;
+    bool rgba = upload.format == GL_RGBA && upload.bytesPerPixel == 4;
+    std::vector<uint8_t> pixels(rowBytes * paddedHeight);
+    for (int y = 0; y < h; ++y) {
+        uint8_t *row = &pixels[(y + PADDING) * rowBytes];
+        const uint8_t *from = upload.pixels + y * pitch;
+        uint8_t *to = row + PADDING * 4;
+        if (rgba) {
+            // decoded images are almost always RGBA8 already
+            memcpy(to, from, w * 4);
+        } else {
+            for (int x = 0; x < w; ++x) {
+                copyPixel(to + x * 4, from + x * upload.bytesPerPixel,
+                          upload.format);
+            }
+        }
+        // extrude the edges into the padding so filtering doesn't pick up
+        // neighboring images
+        for (int x = 0; x < PADDING; ++x) {
+            memcpy(row + x * 4, to, 4);
+            memcpy(to + (w + x) * 4, to + (w - 1) * 4, 4);
+        }
+    }
+    for (int y = 0; y < PADDING; ++y) {
+        memcpy(&pixels[y * rowBytes], &pixels[PADDING * rowBytes], rowBytes);
+        memcpy(&pixels[(PADDING + h + y) * rowBytes],
+               &pixels[(PADDING + h - 1) * rowBytes], rowBytes);
+    }
+    if (upload.release) {
+        upload.release();
+        upload.release = nullptr;
+    }
+
+    GLuint texture = img.atlasPage->texture;
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, slot.x, slot.y, paddedWidth,
+                    paddedHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    checkForGlErrors("runtime atlas blit");
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    // mipmaps, if any, are stale now
+    img.atlasPage->invalidateMipmaps();
+    img.owned = false;
+    img.texture = texture;
+}
+
+void RuntimeAtlas::freeSlot(Page &page, IntRectangle slot) {
+    // merge with free neighbors sharing a whole edge, so the page doesn't
+    // break up into slots too small to reuse
+    for (size_t i = 0; i < page.freeSlots.size();) {
+        IntRectangle &other = page.freeSlots[i];
+        bool stacked = other.x == slot.x && other.width == slot.width &&
+                       (other.bottom() == slot.y || slot.bottom() == other.y);
+        bool adjacent =
+            other.y == slot.y && other.height == slot.height &&
+            (other.right() == slot.x || slot.right() == other.x);
+        if (stacked || adjacent) {
+            slot = slot.join(other);
+            page.freeSlots[i] = page.freeSlots.back();
+            page.freeSlots.pop_back();
+            // the bigger slot may now line up with ones we already passed
+            i = 0;
+        } else {
+            ++i;
+        }
+    }
+    // a slot at the end of its shelf goes back to the shelf, and empty
+    // shelves at the bottom of the page go back to the page
+    for (auto &shelf : page.shelves) {
+        if (shelf.y == slot.y && shelf.height == slot.height &&
+            shelf.x == slot.right()) {
+            shelf.x = slot.x;
+            while (!page.shelves.empty() && !page.shelves.back().x) {
+                page.nextShelfY -= page.shelves.back().height;
+                page.shelves.pop_back();
+            }
+            return;
+        }
+    }
+    page.freeSlots.push_back(slot);
+}
+
+void RuntimeAtlas::release(ImageData &img) {
+    for (size_t i = 0; i < pages.size(); ++i) {
+        Page &page = *pages[i];
+        if (page.img != img.atlasPage) {
+            continue;
+        }
+        freeSlot(page, img.atlasSlot);
+        if (!--page.liveSlots) {
+            AREA_LOG_INFO("asset", "releasing empty runtime atlas page");
+            pages.erase(pages.begin() + i);
+        }
+        break;
+    }
+}
+
+}
@@ -0,0 +1,80 @@
+#ifndef KRIT_RENDER_RUNTIMEATLAS
+#define KRIT_RENDER_RUNTIMEATLAS
+
+#include "krit/math/Dimensions.h"
+#include "krit/math/Rectangle.h"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace krit {
+
+struct ImageData;
+struct TextureUpload;
+
+/**
+ * Packs small, individually loaded images into shared texture pages so they
+ * can be drawn in a single batch.
+ *
+ * Opt in by setting `maxImageSize`. Images whose pixel dimensions fit are
+ * given a slot on a page at load time; an ImageRegion built from such an
+ * image points into the page instead, and keeps the image alive. Freed slots
+ * are merged with free neighbors and split when they're reused, and a page is
+ * released once its last image is gone. Live slots never move, since
+ * ImageRegions hold their rects by value.
+ */
+struct RuntimeAtlas {
+    static const int PADDING = 2;
+
+    // images with both pixel dimensions at or below this are packed; 0
+    // disables packing
+    int maxImageSize = 0;
+    int pageSize = 2048;
+
+    bool enabled() { return maxImageSize > 0; }
+
+    /**
+     * Reserve a slot for `img`, whose pixel size is `size`. Returns false if
+     * the image shouldn't be packed.
+     */
+    bool allocate(ImageData &img, IntDimensions size);
+
+    /**
+     * Copy decoded pixels into the image's slot. Must be called on the
+     * render thread.
+     */
+    void blit(ImageData &img, TextureUpload &upload);
+
+    /**
+     * Return an image's slot; called when the image is destroyed.
+     */
+    void release(ImageData &img);
+
+    size_t pageCount() { return pages.size(); }
+
+private:
+    struct Shelf {
+        int y;
+        int height;
+        int x;
+    };
+
+    struct Page {
+        std::shared_ptr<ImageData> img;
+        float scale;
+        int nextShelfY = 0;
+        std::vector<Shelf> shelves;
+        std::vector<IntRectangle> freeSlots;
+        size_t liveSlots = 0;
+    };
+
+    std::vector<std::unique_ptr<Page>> pages;
+
+    Page &newPage(float scale);
+    bool pack(Page &page, int width, int height, IntRectangle &slot);
+    void freeSlot(Page &page, IntRectangle slot);
+};
+
+}
+
+#endif
@@ -0,0 +1,67 @@
+#include "krit/render/Skyline.h"
+#include <algorithm>
+
+namespace krit {
+
+void Skyline::reset(int size) {
+    this->size = size;
+    nodes.clear();
+    nodes.push_back(Node{0, 0, size});
+}
+
+bool Skyline::pack(int width, int height, IntRectangle &slot) {
+    // find the position which leaves the lowest top edge, bottom-left style
+    int bestIndex = -1, bestY = 0, bestTop = size + 1, bestWidth = 0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        int x = nodes[i].x;
+        if (x + width > size) {
+            break;
+        }
+        int y = 0;
+        int remaining = width;
+        for (size_t j = i; remaining > 0; ++j) {
+            y = std::max(y, nodes[j].y);
+            remaining -= nodes[j].width;
+        }
+        int top = y + height;
+        if (top <= size &&
+            (top < bestTop ||
+             (top == bestTop && nodes[i].width < bestWidth))) {
+            bestIndex = i;
+            bestY = y;
+            bestTop = top;
+            bestWidth = nodes[i].width;
+        }
+    }
+    if (bestIndex < 0) {
+        return false;
+    }
+    slot.setTo(nodes[bestIndex].x, bestY, width, height);
+
+    // raise the skyline under the new slot
+    nodes.insert(nodes.begin() + bestIndex, Node{slot.x, bestTop, width});
+    for (size_t i = bestIndex + 1; i < nodes.size();) {
+        Node &node = nodes[i];
+        int covered = slot.right() - node.x;
+        if (covered <= 0) {
+            break;
+        }
+        if (covered < node.width) {
+            node.x += covered;
+            node.width -= covered;
+            break;
+        }
+        nodes.erase(nodes.begin() + i);
+    }
+    for (size_t i = 0; i + 1 < nodes.size();) {
+        if (nodes[i].y == nodes[i + 1].y) {
+            nodes[i].width += nodes[i + 1].width;
+            nodes.erase(nodes.begin() + i + 1);
+        } else {
+            ++i;
+        }
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,39 @@
+#ifndef KRIT_RENDER_SKYLINE
+#define KRIT_RENDER_SKYLINE
+
+#include "krit/math/Rectangle.h"
+#include <vector>
+
+namespace krit {
+
+/**
+ * Packs rectangles into a square along a skyline: the top edge of everything
+ * placed so far, stored as horizontal segments. Each rectangle goes where it
+ * leaves the lowest top edge, so rows of similar heights stay flat.
+ */
+struct Skyline {
+    struct Node {
+        int x;
+        int y;
+        int width;
+    };
+
+    // left to right, covering the full width; neighbours never share a height
+    std::vector<Node> nodes;
+    int size = 0;
+
+    /**
+     * Start over with an empty `size` pixel square.
+     */
+    void reset(int size);
+
+    /**
+     * Find room for a `width` x `height` rectangle and reserve it; returns
+     * false if there isn't any.
+     */
+    bool pack(int width, int height, IntRectangle &slot);
+};
+
+}
+
+#endif
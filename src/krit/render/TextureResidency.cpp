@@ -0,0 +1,232 @@
+#include "krit/render/TextureResidency.h"
+#include "krit/Engine.h"
+#include "krit/render/ImageData.h"
+#include "krit/utils/Log.h"
+#include "krit/utils/Profiling.h"
+#include <algorithm>
+
+namespace krit {
+
+void TextureResidency::track(std::shared_ptr<ImageData> img,
+                             std::vector<ImageTier> &&tiers, size_t current) {
+    img->residencyTracked = true;
+    Entry &entry = entries.emplace_back();
+    entry.img = img;
+    entry.tiers = std::move(tiers);
+    entry.current = entry.target = current;
+}
+
+size_t TextureResidency::desiredTier(Entry &entry, float drawnScale) {
+    if (entry.idle >= idleFrames) {
+        return 0;
+    }
+    if (drawnScale <= 0) {
+        // not drawn this frame, but not idle long enough to drop it
+        return entry.current;
+    }
+    for (size_t i = 0; i < entry.tiers.size(); ++i) {
+        if (entry.tiers[i].scale() >= drawnScale) {
+            return i;
+        }
+    }
+    return entry.tiers.size() - 1;
+}
+
+size_t TextureResidency::tierBytes(ImageData &img, ImageTier &tier) {
+    float scale = tier.scale();
+    return (size_t)(img.dimensions.x * scale) * (img.dimensions.y * scale) * 4 *
+           4 / 3;
+}
+
+void TextureResidency::load(Entry &entry, size_t tier) {
+    ImageTier &imageTier = entry.tiers[tier];
+    float scale = imageTier.scale();
+    std::weak_ptr<ImageData> weak = entry.img;
+    auto info = std::make_shared<ImageTextureInfo>();
+    AREA_LOG_DEBUG("residency", "switching %s to tier %i",
+                   imageTier.path.c_str(), imageTier.resolution);
+    entry.pending = true;
+    ++pendingCount;
+    bool loading = ImageLoader::loadTexture(
+        imageTier, *info, [this, weak, tier, scale, info](GLuint texture) {
+            --pendingCount;
+            auto img = weak.lock();
+            if (!img) {
+                glDeleteTextures(1, &texture);
+                return;
+            }
+            if (texture) {
+                img->replaceTexture(texture, scale, info->gpuBytes,
+                                    info->compressed);
+            }
+            for (auto &entry : entries) {
+                if (entry.img.lock() == img) {
+                    entry.pending = false;
+                    if (texture) {
+                        entry.current = tier;
+                    } else {
+                        dropTier(entry, tier);
+                    }
+                    break;
+                }
+            }
+        });
+    if (!loading) {
+        entry.pending = false;
+        --pendingCount;
+        dropTier(entry, tier);
+    }
+}
+
+void TextureResidency::dropTier(Entry &entry, size_t tier) {
+    // keep the current tier and stop trying this one
+    entry.tiers.erase(entry.tiers.begin() + tier);
+    if (entry.current > tier) {
+        --entry.current;
+    }
+    entry.target = entry.current;
+}
+
+void TextureResidency::update() {
+    if (!enabled()) {
+        return;
+    }
+    ProfileZone("TextureResidency::update");
+
+    bool resized =
+        windowSize.x != engine->window.x || windowSize.y != engine->window.y;
+    windowSize.setTo(engine->window.x, engine->window.y);
+
+    size_t resident = 0;
+    std::vector<size_t> upgrades;
+    for (size_t i = 0; i < entries.size();) {
+        Entry &entry = entries[i];
+        auto img = entry.img.lock();
+        if (!img) {
+            if (i < entries.size() - 1) {
+                entries[i] = std::move(entries.back());
+            }
+            entries.pop_back();
+            continue;
+        }
+        float drawnScale = img->drawnScale;
+        img->drawnScale = 0;
+        if (drawnScale > 0) {
+            entry.idle = 0;
+        } else {
+            ++entry.idle;
+        }
+        if (resized) {
+            // the scale things are drawn at just changed; don't wait to
+            // release the tiers we no longer need
+            entry.lowFrames = downgradeFrames;
+        }
+        size_t desired = desiredTier(entry, drawnScale);
+        if (desired < entry.current && ++entry.lowFrames < downgradeFrames &&
+            entry.idle < idleFrames) {
+            desired = entry.current;
+        } else if (desired >= entry.current) {
+            entry.lowFrames = 0;
+        }
+        entry.target = desired;
+        resident += img->gpuBytes;
+        if (entry.target > entry.current) {
+            upgrades.push_back(i);
+        }
+        ++i;
+    }
+
+    // downgrades free memory, so they go first
+    for (auto &entry : entries) {
+        if (pendingCount >= maxPending) {
+            break;
+        }
+        if (!entry.pending && entry.target < entry.current) {
+            auto img = entry.img.lock();
+            resident -= img->gpuBytes;
+            resident += tierBytes(*img, entry.tiers[entry.target]);
+            load(entry, entry.target);
+        }
+    }
+
+    // upgrade whatever is drawn the most undersampled first
+    std::sort(upgrades.begin(), upgrades.end(), [this](size_t a, size_t b) {
+        Entry &ea = entries[a], &eb = entries[b];
+        float ra = ea.tiers[ea.target].scale() / ea.tiers[ea.current].scale();
+        float rb = eb.tiers[eb.target].scale() / eb.tiers[eb.current].scale();
+        return ra > rb;
+    });
+    for (size_t index : upgrades) {
+        if (pendingCount >= maxPending) {
+            break;
+        }
+        Entry &entry = entries[index];
+        if (entry.pending) {
+            continue;
+        }
+        auto img = entry.img.lock();
+        size_t needed = tierBytes(*img, entry.tiers[entry.target]);
+        if (resident - img->gpuBytes + needed > budget) {
+            // make room by dropping images that weren't drawn this frame
+            for (auto &other : entries) {
+                if (resident - img->gpuBytes + needed <= budget ||
+                    pendingCount >= maxPending) {
+                    break;
+                }
+                if (&other != &entry && !other.pending && other.idle > 0 &&
+                    other.current > 0) {
+                    auto otherImg = other.img.lock();
+                    resident -= otherImg->gpuBytes;
+                    resident += tierBytes(*otherImg, other.tiers[0]);
+                    other.target = 0;
+                    load(other, 0);
+                }
+            }
+            if (resident - img->gpuBytes + needed > budget ||
+                pendingCount >= maxPending) {
+                continue;
+            }
+        }
+        resident -= img->gpuBytes;
+        resident += needed;
+        load(entry, entry.target);
+    }
+}
+
+size_t TextureResidency::residentBytes() {
+    size_t total = 0;
+    for (auto &entry : entries) {
+        if (auto img = entry.img.lock()) {
+            total += img->gpuBytes;
+        }
+    }
+    return total;
+}
+
+std::vector<TextureTierStats> TextureResidency::stats() {
+    std::vector<TextureTierStats> result;
+    for (auto &entry : entries) {
+        auto img = entry.img.lock();
+        if (!img) {
+            continue;
+        }
+        int resolution = entry.tiers[entry.current].resolution;
+        auto found = std::find_if(result.begin(), result.end(),
+                                  [resolution](TextureTierStats &s) {
+                                      return s.resolution == resolution;
+                                  });
+        if (found == result.end()) {
+            result.push_back(TextureTierStats{resolution});
+            found = result.end() - 1;
+        }
+        ++found->textures;
+        found->bytes += img->gpuBytes;
+    }
+    std::sort(result.begin(), result.end(),
+              [](const TextureTierStats &a, const TextureTierStats &b) {
+                  return a.resolution < b.resolution;
+              });
+    return result;
+}
+
+}
@@ -0,0 +1,8 @@
+declare class TextureResidency {
+    budget: number;
+    idleFrames: number;
+    downgradeFrames: number;
+    maxPending: number;
+
+    residentBytes(): number;
+}
@@ -0,0 +1,80 @@
+#ifndef KRIT_RENDER_TEXTURERESIDENCY
+#define KRIT_RENDER_TEXTURERESIDENCY
+
+#include "krit/asset/ImageLoader.h"
+#include "krit/math/Dimensions.h"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace krit {
+
+struct ImageData;
+
+struct TextureTierStats {
+    int resolution;
+    size_t textures = 0;
+    size_t bytes = 0;
+};
+
+/**
+ * Keeps image assets at the resolution tier they're actually drawn at.
+ *
+ * Images loaded while a budget is set are tracked along with all of their
+ * resolution variants. Each frame, draws report how many screen pixels each
+ * logical pixel covers; textures drawn larger than their current tier are
+ * streamed in at a higher tier, and textures that are drawn smaller or not at
+ * all drop back down, keeping the total under `budget` bytes. Tier switches
+ * load in the background and swap `ImageData::texture` when ready.
+ */
+struct TextureResidency {
+    // VRAM budget for tracked textures, in bytes; 0 disables tracking
+    size_t budget = 0;
+    // frames an image can go undrawn before it drops to its lowest tier
+    unsigned idleFrames = 300;
+    // frames a lower tier must be sufficient before we downgrade to it
+    unsigned downgradeFrames = 60;
+    // maximum number of tier loads in flight at once
+    size_t maxPending = 2;
+
+    bool enabled() { return budget > 0; }
+
+    void track(std::shared_ptr<ImageData> img, std::vector<ImageTier> &&tiers,
+               size_t current);
+
+    void update();
+
+    /**
+     * Texture memory currently used by tracked images.
+     */
+    size_t residentBytes();
+
+    /**
+     * Number of tracked textures and their memory, per resolution tier.
+     */
+    std::vector<TextureTierStats> stats();
+
+private:
+    struct Entry {
+        std::weak_ptr<ImageData> img;
+        std::vector<ImageTier> tiers;
+        size_t current;
+        size_t target;
+        unsigned idle = 0;
+        unsigned lowFrames = 0;
+        bool pending = false;
+    };
+
+    std::vector<Entry> entries;
+    IntDimensions windowSize;
+    size_t pendingCount = 0;
+
+    size_t desiredTier(Entry &entry, float drawnScale);
+    size_t tierBytes(ImageData &img, ImageTier &tier);
+    void load(Entry &entry, size_t tier);
+    void dropTier(Entry &entry, size_t tier);
+};
+
+}
+
+#endif
@@ -0,0 +1,166 @@
+#include "krit/render/TextureUploader.h"
+#include "krit/Engine.h"
+#include "krit/TaskManager.h"
+#include "krit/utils/Log.h"
+#include "krit/utils/Profiling.h"
+#include <algorithm>
+#include <cstring>
+
+namespace krit {
+
+static GLenum internalFormat(GLenum format) {
+    switch (format) {
+        case GL_BGRA:
+            return GL_RGBA;
+        case GL_BGR:
+            return GL_RGB;
+        default:
+            return format;
+    }
+}
+
+void TextureUploader::upload(TextureUpload &&upload) {
+    if (upload.width <= 0 || upload.height <= 0 || !upload.pixels) {
+        LOG_ERROR("rejecting empty %ix%i texture upload", upload.width,
+                  upload.height);
+        if (upload.release) {
+            upload.release();
+        }
+        if (upload.onComplete) {
+            upload.onComplete(0);
+        }
+        return;
+    }
+    auto job = std::make_shared<Job>();
+    job->upload = std::move(upload);
+    TextureUpload &u = job->upload;
+    job->rowBytes = u.width * u.bytesPerPixel;
+    if (!u.pitch) {
+        u.pitch = job->rowBytes;
+    }
+
+    // allocate storage up front; rows are filled in as the budget allows
+    glActiveTexture(GL_TEXTURE0);
+    glGenTextures(1, &job->texture);
+    if (!job->texture) {
+        LOG_ERROR("failed to generate texture for upload");
+    }
+    checkForGlErrors("gen textures");
+    glBindTexture(GL_TEXTURE_2D, job->texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat(u.format), u.width, u.height,
+                 0, u.format, GL_UNSIGNED_BYTE, nullptr);
+    checkForGlErrors("texImage2D");
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+#ifndef __EMSCRIPTEN__
+    // WebGL can't map buffers, so emscripten uploads from client memory
+    size_t size = job->rowBytes * u.height;
+    glGenBuffers(1, &job->pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, job->pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    job->staging = static_cast<uint8_t *>(glMapBufferRange(
+        GL_PIXEL_UNPACK_BUFFER, 0, size,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    checkForGlErrors("map pixel buffer");
+    if (!job->staging) {
+        glDeleteBuffers(1, &job->pbo);
+        job->pbo = 0;
+    }
+#endif
+
+    if (job->staging) {
+        // copy into the staging buffer off the render thread
+        engine->taskManager->push([job]() {
+            TextureUpload &u = job->upload;
+            for (int y = 0; y < u.height; ++y) {
+                memcpy(job->staging + y * job->rowBytes, u.pixels + y * u.pitch,
+                       job->rowBytes);
+            }
+            if (u.release) {
+                u.release();
+                u.release = nullptr;
+            }
+            u.pixels = nullptr;
+            engine->taskManager->pushRender([job]() { job->staged = true; });
+        });
+    } else {
+        job->staged = true;
+    }
+
+    jobs.push_back(std::move(job));
+}
+
+void TextureUploader::process() {
+    if (jobs.empty()) {
+        return;
+    }
+    ProfileZone("TextureUploader::process");
+    size_t budget = frameBudget;
+    glActiveTexture(GL_TEXTURE0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (auto it = jobs.begin(); it != jobs.end() && budget > 0;) {
+        Job &job = **it;
+        if (!job.staged) {
+            ++it;
+            continue;
+        }
+        TextureUpload &u = job.upload;
+        if (job.pbo) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, job.pbo);
+            if (job.staging) {
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                job.staging = nullptr;
+            }
+        } else if (u.pitch != job.rowBytes) {
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, u.pitch / u.bytesPerPixel);
+        }
+        glBindTexture(GL_TEXTURE_2D, job.texture);
+
+        int rows = std::max<size_t>(1, budget / job.rowBytes);
+        rows = std::min(rows, u.height - job.rowsUploaded);
+        // with a PBO bound, the pointer is an offset into the buffer
+        const uint8_t *src =
+            job.pbo ? reinterpret_cast<const uint8_t *>(job.rowsUploaded *
+                                                        job.rowBytes)
+                    : u.pixels + job.rowsUploaded * u.pitch;
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, job.rowsUploaded, u.width, rows,
+                        u.format, GL_UNSIGNED_BYTE, src);
+        checkForGlErrors("texSubImage2D");
+        job.rowsUploaded += rows;
+        budget -= std::min(budget, rows * job.rowBytes);
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+        if (job.pbo) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        } else if (u.pitch != job.rowBytes) {
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        }
+
+        if (job.rowsUploaded >= u.height) {
+            finish(job);
+            it = jobs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    // restore the default for everything else that uploads pixels
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void TextureUploader::finish(Job &job) {
+    if (job.pbo) {
+        glDeleteBuffers(1, &job.pbo);
+        job.pbo = 0;
+    }
+    TextureUpload &u = job.upload;
+    if (u.release) {
+        u.release();
+        u.release = nullptr;
+    }
+    if (u.onComplete) {
+        u.onComplete(job.texture);
+    }
+}
+
+}
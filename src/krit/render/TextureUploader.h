@@ -0,0 +1,75 @@
+#ifndef KRIT_RENDER_TEXTUREUPLOADER
+#define KRIT_RENDER_TEXTUREUPLOADER
+
+#include "krit/render/Gl.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+
+namespace krit {
+
+/**
+ * Decoded pixels waiting to become a texture.
+ */
+struct TextureUpload {
+    const uint8_t *pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    // bytes between the starts of consecutive rows in `pixels`
+    size_t pitch = 0;
+    size_t bytesPerPixel = 4;
+    GLenum format = GL_RGBA;
+    // frees `pixels`; called once they're no longer needed
+    std::function<void()> release;
+    // called on the render thread with the finished texture
+    std::function<void(GLuint)> onComplete;
+};
+
+/**
+ * Spreads texture uploads across frames.
+ *
+ * Pixels are copied into a mapped pixel buffer object on a worker thread,
+ * then streamed into the texture in row bands with glTexSubImage2D, at most
+ * `frameBudget` bytes per frame. The texture is only handed over once every
+ * row is in place, so nothing ever samples a partial upload. Mipmaps are left
+ * to the renderer, which builds them on first use with SmoothMipmap.
+ */
+struct TextureUploader {
+    // bytes to upload per frame
+    size_t frameBudget = 8 * 1024 * 1024;
+
+    /**
+     * Start uploading into a new texture. Must be called on the render
+     * thread. An upload with no pixels is released and completed with 0.
+     */
+    void upload(TextureUpload &&upload);
+
+    /**
+     * Upload the next bands of pending textures; called once per frame by
+     * the renderer.
+     */
+    void process();
+
+    bool idle() { return jobs.empty(); }
+
+private:
+    struct Job {
+        TextureUpload upload;
+        GLuint texture = 0;
+        GLuint pbo = 0;
+        uint8_t *staging = nullptr;
+        size_t rowBytes = 0;
+        int rowsUploaded = 0;
+        bool staged = false;
+    };
+
+    std::list<std::shared_ptr<Job>> jobs;
+
+    void finish(Job &job);
+};
+
+}
+
+#endif
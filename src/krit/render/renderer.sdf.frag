@@ -0,0 +1,21 @@
+R"(#version 300 es
+// renderer.sdf.frag
+#ifdef GL_ES
+precision highp float;
+#endif
+// Krit signed distance field text fragment shader
+uniform sampler2D uImage;
+// distance value of the edge to draw; lower values draw a thicker outline
+uniform float uThreshold;
+in vec4 vColor;
+in vec2 vTexCoord;
+out vec4 FragColor;
+
+void main(void) {
+    float distance = texture(uImage, vTexCoord).r;
+    float width = fwidth(distance) * 0.5;
+    float coverage =
+        smoothstep(uThreshold - width, uThreshold + width, distance);
+    FragColor = vColor * coverage;
+}
+)"
@@ -273,8 +273,9 @@ AssetLoader<ParticleEffect>::loadAsset(const std::string &path) {
     return ParticleEffect::load(path);
 }
 
-template <> size_t AssetLoader<ParticleEffect>::cost(ParticleEffect *effect) {
-    return 1;
+template <>
+AssetCost AssetLoader<ParticleEffect>::cost(ParticleEffect *effect) {
+    return AssetCost{sizeof(ParticleEffect)};
 }
 
 }
@@ -25,10 +25,10 @@
 
 struct KritSpineExtension : public spine::DefaultSpineExtension {
     char *_readFile(const spine::String &path, int *length) override {
-        std::string s = krit::engine->io->readFile(path.buffer());
+        krit::FileBytes s = krit::engine->io->readBytes(path.buffer());
         *length = s.size();
         char *c = (char *)malloc(s.size() + 1);
-        memcpy(c, s.c_str(), s.size());
+        memcpy(c, s.data(), s.size());
         c[s.size()] = 0;
         return c;
     }
@@ -58,9 +58,11 @@ AssetLoader<SpineData>::loadAsset(const std::string &path) {
         new spine::SkeletonBinary(data->atlas.get()));
     // data->json = std::unique_ptr<spine::SkeletonJson>(
     //     new spine::SkeletonJson(data->atlas.get()));
-    std::string s = engine->io->readFile(path.c_str());
+    FileBytes s = engine->io->readBytes(path.c_str());
+    data->skeletonBytes = s.size();
     data->skeletonData = std::unique_ptr<spine::SkeletonData>(
-        data->binary->readSkeletonData((unsigned char *)s.c_str(), s.size()));
+        data->binary->readSkeletonData((const unsigned char *)s.data(),
+                                       s.size()));
     // data->skeletonData = std::unique_ptr<spine::SkeletonData>(
     //     data->json->readSkeletonData((const char *)s));
     if (!data->skeletonData) {
@@ -72,10 +74,19 @@ AssetLoader<SpineData>::loadAsset(const std::string &path) {
     return data;
 }
 
-template <> size_t AssetLoader<SpineData>::cost(SpineData *s) {
-    return sizeof(SpineData) + sizeof(spine::Atlas) +
-           sizeof(spine::SkeletonBinary) + sizeof(spine::SkeletonData) +
-           sizeof(spine::AnimationStateData);
+template <> AssetCost AssetLoader<SpineData>::cost(SpineData *s) {
+    // the parsed skeleton isn't measurable from outside, so its size is
+    // taken from the file it came from
+    AssetCost cost{sizeof(SpineData) + sizeof(spine::Atlas) +
+                   sizeof(spine::SkeletonBinary) +
+                   sizeof(spine::SkeletonData) +
+                   sizeof(spine::AnimationStateData) + s->skeletonBytes};
+    // page textures are cached as images of their own
+    auto &pages = s->atlas->getPages();
+    for (size_t i = 0; i < pages.size(); ++i) {
+        cost.sharedBytes += (size_t)pages[i]->width * pages[i]->height * 4;
+    }
+    return cost;
 }
 
 template <> AssetType AssetLoader<SpineData>::type() {
@@ -226,13 +237,17 @@ void SpineSprite::render(RenderContext &ctx) {
         uint32_t *colors = command->colors;
         uint16_t *indices = command->indices;
         key.image = static_cast<ImageRegion *>(command->texture)->img;
-        float uvOffsetX = 0, uvOffsetY = 0;
+        float uvOffsetX = 0, uvOffsetY = 0, uvScaleX = 1, uvScaleY = 1;
         auto region = static_cast<ImageRegion *>(command->texture);
         if (region->uvx1() || region->uvy1() ||
             std::abs(region->uvx2() - 1) > 0.000001 ||
             std::abs(region->uvy2() - 1) > 0.000001) {
+            // the page is a region of a larger texture, e.g. a runtime
+            // atlas page
             uvOffsetX = region->uvx1();
             uvOffsetY = region->uvy1();
+            uvScaleX = region->uvx2() - region->uvx1();
+            uvScaleY = region->uvy2() - region->uvy1();
         }
         switch (command->blendMode) {
             case spine::BlendMode_Additive: {
@@ -263,15 +278,15 @@ void SpineSprite::render(RenderContext &ctx) {
             uv.p1.setTo(uvs[i1 * 2], uvs[i1 * 2 + 1]);
             uv.p2.setTo(uvs[i2 * 2], uvs[i2 * 2 + 1]);
             uv.p3.setTo(uvs[i3 * 2], uvs[i3 * 2 + 1]);
-            if (uvOffsetX) {
-                uv.p1.x += uvOffsetX;
-                uv.p2.x += uvOffsetX;
-                uv.p3.x += uvOffsetX;
+            if (uvOffsetX || uvScaleX != 1) {
+                uv.p1.x = uvOffsetX + uv.p1.x * uvScaleX;
+                uv.p2.x = uvOffsetX + uv.p2.x * uvScaleX;
+                uv.p3.x = uvOffsetX + uv.p3.x * uvScaleX;
             }
-            if (uvOffsetY) {
-                uv.p1.y += uvOffsetY;
-                uv.p2.y += uvOffsetY;
-                uv.p3.y += uvOffsetY;
+            if (uvOffsetY || uvScaleY != 1) {
+                uv.p1.y = uvOffsetY + uv.p1.y * uvScaleY;
+                uv.p2.y = uvOffsetY + uv.p2.y * uvScaleY;
+                uv.p3.y = uvOffsetY + uv.p3.y * uvScaleY;
             }
             c.setTo(colors[i1] & 0xffffff);
             c.a = ((colors[i1] >> 24) & 0xff) / 0xff;
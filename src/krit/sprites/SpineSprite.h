@@ -51,6 +51,8 @@ struct SpineData {
     // std::unique_ptr<spine::SkeletonJson> json;
     std::unique_ptr<spine::SkeletonData> skeletonData;
     std::unique_ptr<spine::AnimationStateData> animationStateData;
+    // size of the skeleton file
+    size_t skeletonBytes = 0;
 };
 
 struct SpineSprite : public Sprite {
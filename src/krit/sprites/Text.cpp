@@ -27,69 +27,8 @@
 
 namespace krit {
 
-struct ReusableHbBuffer {
-    hb_buffer_t *hbBuf{nullptr};
-
-    ReusableHbBuffer(hb_buffer_t *buf) : hbBuf(buf) {}
-    ReusableHbBuffer(ReusableHbBuffer &&other) {
-        hbBuf = other.hbBuf;
-        other.hbBuf = nullptr;
-    }
-    ~ReusableHbBuffer() {
-        if (hbBuf) {
-            hb_buffer_destroy(hbBuf);
-            hbBuf = nullptr;
-        }
-    }
-
-    ReusableHbBuffer &operator=(ReusableHbBuffer &&other) {
-        if (hbBuf) {
-            hb_buffer_destroy(hbBuf);
-        }
-        hbBuf = other.hbBuf;
-        other.hbBuf = nullptr;
-        return *this;
-    }
-
-    hb_buffer_t *take() {
-        hb_buffer_t *result = hbBuf;
-        hbBuf = nullptr;
-        return result;
-    }
-};
-
 static const int FONT_SCALE = 64;
 
-static void resetBuffer(hb_buffer_t *hbBuf) {
-    hb_buffer_set_direction(hbBuf, HB_DIRECTION_LTR);
-    hb_buffer_set_script(hbBuf, HB_SCRIPT_LATIN);
-    hb_buffer_set_language(hbBuf, hb_language_from_string("en", -1));
-    hb_buffer_set_cluster_level(hbBuf,
-                                HB_BUFFER_CLUSTER_LEVEL_MONOTONE_CHARACTERS);
-}
-
-static std::vector<ReusableHbBuffer> recycledBuffers;
-hb_buffer_t *getHbBuffer() {
-    hb_buffer_t *hbBuf;
-    if (recycledBuffers.empty()) {
-        hbBuf = hb_buffer_create();
-        resetBuffer(hbBuf);
-    } else {
-        hbBuf = recycledBuffers.back().take();
-        recycledBuffers.pop_back();
-    }
-    return hbBuf;
-}
-void recycleHbBuffer(hb_buffer_t *hbBuf) {
-    if (recycledBuffers.size() < 1024) {
-        hb_buffer_clear_contents(hbBuf);
-        resetBuffer(hbBuf);
-        recycledBuffers.push_back(hbBuf);
-    } else {
-        hb_buffer_destroy(hbBuf);
-    }
-}
-
 std::unordered_map<std::string, TextFormatTagOptions> Text::formatTags = {
     {"\n", TextFormatTagOptions().setNewline()},
     {"br", TextFormatTagOptions().setNewline()},
@@ -196,10 +135,9 @@ struct FormatTag {
 struct TextRun {
     std::shared_ptr<Font> font;
     std::string rawText;
-    hb_buffer_t *hbBuf = nullptr;
     std::vector<TextOpcode> opcodes;
 
-    TextRun(std::shared_ptr<Font> font) : font(font) { hbBuf = getHbBuffer(); }
+    TextRun(std::shared_ptr<Font> font) : font(font) {}
 };
 
 /**
@@ -207,7 +145,7 @@ struct TextRun {
  * Vector of TextOpcodes.
  */
 struct TextParser {
-    static TextRenderStack stack;
+    TextRenderStack stack;
 
     Point cursor;
 
@@ -218,10 +156,19 @@ struct TextParser {
     std::vector<TextOpcode> word;
     int wordLength = 0;
     int lineHeight = 0;
+    // font of the last StartTextRun
+    std::shared_ptr<Font> runFont;
+
+    // characters in the opcodes before `closedOps`, plus every glyph
+    int chars = 0;
+    // opcodes before this are final; the rest are the open last line
+    size_t closedOps = 0;
+    Dimensions closedDimensions;
 
     void parseText(Text &txt, const std::string &s, bool rich) {
         ProfileZone("TextParser::parseText");
         txt.opcodes.clear();
+        txt.glyphs.clear();
         txt.textDimensions.setTo(0, 0);
         txt.maxChars = 0;
         cursor.setTo(0, 0);
@@ -230,12 +177,7 @@ struct TextParser {
             return;
         }
 
-        txt.recycleBuffers();
-
-        // pass 1: find all format tags, and convert the text into TextRuns
-        std::vector<TextRun> runs;
-        runs.emplace_back(txt.font);
-        TextRenderStack &st = TextParser::stack;
+        TextRenderStack &st = this->stack;
         st.clear();
         st.font.push(txt.font);
         st.color.push(txt.baseColor);
@@ -243,157 +185,164 @@ struct TextParser {
         st.custom.push(nullptr);
         word.clear();
 
-        int rawTextStart = -1;
-
-        for (Utf8Iterator it = s.begin(); it != s.end(); ++it) {
-            size_t i = it.index();
-            char32_t c = *it;
-            if (c == '<' || c == '\n' || c == '\t') {
-                if (rawTextStart > -1) {
-                    size_t originalSize = runs.back().rawText.size();
-                    size_t begin = rawTextStart;
-                    size_t length = it.index() - begin;
-                    runs.back().rawText.append(s.c_str() + begin, length);
+        appendText(txt, s);
+    }
+
+    /**
+     * Parse `s` as a continuation of everything parsed so far, picking up the
+     * open format tags and the last line where they left off. The last line
+     * is left open; finish() closes it.
+     */
+    void appendText(Text &txt, const std::string &s) {
+        // pass 1: find all format tags, and convert the text into TextRuns
+        std::vector<TextRun> runs;
+        TextRenderStack &st = this->stack;
+        runs.emplace_back(st.font.top());
+
+        // everything between delimiters is raw text; the delimiters are all
+        // ASCII, so there's no need to decode anything to find them
+        size_t rawTextStart = 0;
+
+        for (size_t i = findAscii<'<', '\n', '\t'>(s, 0); i < s.size();
+             i = findAscii<'<', '\n', '\t'>(s, i + 1)) {
+            char c = s[i];
+            if (i > rawTextStart) {
+                size_t originalSize = runs.back().rawText.size();
+                size_t begin = rawTextStart;
+                size_t length = i - begin;
+                runs.back().rawText.append(s.c_str() + begin, length);
+                runs.back().opcodes.emplace_back(
+                    std::in_place_index_t<RawText>(), originalSize, length);
+            }
+            switch (c) {
+                case '\n': {
                     runs.back().opcodes.emplace_back(
-                        std::in_place_index_t<RawText>(), originalSize, length);
-                    rawTextStart = -1;
+                        TextOpcode(std::in_place_index_t<NewLine>(),
+                                   Dimensions(), LeftAlign));
+                    break;
                 }
-                switch (c) {
-                    case '\n': {
-                        runs.back().opcodes.emplace_back(
-                            TextOpcode(std::in_place_index_t<NewLine>(),
-                                       Dimensions(), LeftAlign));
-                        break;
+                case '\t': {
+                    runs.back().opcodes.emplace_back(
+                        TextOpcode(std::in_place_index_t<Tab>()));
+                    break;
+                }
+                default: {
+                    // we have a tag; look for the end
+                    // FIXME: also parse attributes here
+                    size_t startPos = i;
+                    size_t endPos = s.find('>', i);
+                    if (endPos == std::string::npos) {
+                        endPos = s.size();
                     }
-                    case '\t': {
-                        runs.back().opcodes.emplace_back(
-                            TextOpcode(std::in_place_index_t<Tab>()));
+                    i = endPos;
+                    // identify the tag and convert it into ops
+                    std::string_view tagName(s.c_str() + startPos + 1,
+                                             endPos - startPos - 1);
+                    if (tagName.empty()) {
                         break;
                     }
-                    default: {
-                        int startPos = i;
-                        int endPos = it.index() + 1;
-                        if (c == '<') {
-                            // we have a tag; look for the end
-                            // FIXME: also parse attributes here
-                            for (; it != s.end(); ++it) {
-                                endPos = it.index();
-                                char32_t c2 = *it;
-                                if (c2 == '>') {
-                                    break;
-                                }
+                    bool open = true;
+                    bool close = false;
+                    if (tagName[0] == '/') {
+                        // close
+                        open = false;
+                        close = true;
+                        tagName = std::string_view(&tagName[1],
+                                                   tagName.length() - 1);
+                    } else if (tagName[tagName.length() - 1] == '/') {
+                        // self closing
+                        open = close = true;
+                        tagName = std::string_view(&tagName[0],
+                                                   tagName.length() - 1);
+                    }
+                    static std::string tagStr;
+                    tagStr.assign(tagName.data(), tagName.length());
+                    // printf("TAG: <%s> %s%s\n", tagStr.c_str(),
+                    //        open ? "OPEN" : "", close ? "CLOSE" : "");
+                    auto found = Text::formatTags.find(tagStr);
+                    if (found != Text::formatTags.end()) {
+                        TextFormatTagOptions &tag = found->second;
+                        if (tag.color) {
+                            if (open) {
+                                st.color.push(*tag.color);
                             }
+                            if (close) {
+                                st.color.pop();
+                            }
+                            runs.back().opcodes.emplace_back(TextOpcode(
+                                std::in_place_index_t<SetColor>(),
+                                st.color.top()));
                         }
-                        // identify the tag and convert it into ops
-                        std::string_view tagName(s.c_str() + startPos + 1,
-                                                 endPos - startPos - 1);
-                        bool open = true;
-                        bool close = false;
-                        if (tagName[0] == '/') {
-                            // close
-                            open = false;
-                            close = true;
-                            tagName = std::string_view(&tagName[1],
-                                                       tagName.length() - 1);
-                        } else if (tagName[tagName.length() - 1] == '/') {
-                            // self closing
-                            open = close = true;
-                            tagName = std::string_view(&tagName[0],
-                                                       tagName.length() - 1);
-                        }
-                        static std::string tagStr;
-                        tagStr.assign(tagName.data(), tagName.length());
-                        // printf("TAG: <%s> %s%s\n", tagStr.c_str(),
-                        //        open ? "OPEN" : "", close ? "CLOSE" : "");
-                        auto found = Text::formatTags.find(tagStr);
-                        if (found != Text::formatTags.end()) {
-                            TextFormatTagOptions &tag = found->second;
-                            if (tag.color) {
-                                if (open) {
-                                    st.color.push(*tag.color);
-                                }
-                                if (close) {
-                                    st.color.pop();
-                                }
-                                runs.back().opcodes.emplace_back(TextOpcode(
-                                    std::in_place_index_t<SetColor>(),
-                                    st.color.top()));
+                        if (tag.align) {
+                            if (open) {
+                                st.align.push(*tag.align);
                             }
-                            if (tag.align) {
-                                if (open) {
-                                    st.align.push(*tag.align);
-                                }
-                                if (close) {
-                                    st.align.pop();
-                                }
-                                runs.back().opcodes.emplace_back(TextOpcode(
-                                    std::in_place_index_t<SetAlign>(),
-                                    currentAlign = st.align.top()));
+                            if (close) {
+                                st.align.pop();
                             }
-                            if (tag.custom != nullptr) {
-                                if (open) {
-                                    st.custom.push(tag.custom);
-                                }
-                                if (close) {
-                                    st.custom.pop();
-                                }
-                                runs.back().opcodes.emplace_back(TextOpcode(
-                                    std::in_place_index_t<SetCustom>(),
-                                    st.custom.top()));
+                            runs.back().opcodes.emplace_back(TextOpcode(
+                                std::in_place_index_t<SetAlign>(),
+                                currentAlign = st.align.top()));
+                        }
+                        if (tag.custom != nullptr) {
+                            if (open) {
+                                st.custom.push(tag.custom);
                             }
-                            if (tag.sprite && open) {
-                                runs.back().opcodes.emplace_back(TextOpcode(
-                                    std::in_place_index_t<RenderSprite>(),
-                                    tag.sprite));
+                            if (close) {
+                                st.custom.pop();
                             }
-                            if (tag.newline && open) {
-                                runs.back().opcodes.emplace_back(
-                                    TextOpcode(std::in_place_index_t<NewLine>(),
-                                               Dimensions(), LeftAlign));
+                            runs.back().opcodes.emplace_back(TextOpcode(
+                                std::in_place_index_t<SetCustom>(),
+                                st.custom.top()));
+                        }
+                        if (tag.sprite && open) {
+                            runs.back().opcodes.emplace_back(TextOpcode(
+                                std::in_place_index_t<RenderSprite>(),
+                                tag.sprite));
+                        }
+                        if (tag.newline && open) {
+                            runs.back().opcodes.emplace_back(
+                                TextOpcode(std::in_place_index_t<NewLine>(),
+                                           Dimensions(), LeftAlign));
+                        }
+                        if (tag.tab && open) {
+                            runs.back().opcodes.emplace_back(
+                                TextOpcode(std::in_place_index_t<Tab>()));
+                        }
+                        if (tag.charDelay && !close) {
+                            runs.back().opcodes.emplace_back(TextOpcode(
+                                std::in_place_index_t<CharDelay>(),
+                                tag.charDelay));
+                        }
+                        if (tag.border) {
+                            if (open) {
+                                runs.back().opcodes.emplace_back(TextOpcode(
+                                    std::in_place_index_t<EnableBorder>()));
                             }
-                            if (tag.tab && open) {
+                            if (close) {
                                 runs.back().opcodes.emplace_back(
-                                    TextOpcode(std::in_place_index_t<Tab>()));
+                                    TextOpcode(std::in_place_index_t<
+                                               DisableBorder>()));
                             }
-                            if (tag.charDelay && !close) {
-                                runs.back().opcodes.emplace_back(TextOpcode(
-                                    std::in_place_index_t<CharDelay>(),
-                                    tag.charDelay));
+                        }
+                        if (tag.font) {
+                            // this will begin a new run
+                            if (open) {
+                                st.font.push(tag.font);
                             }
-                            if (tag.border) {
-                                if (open) {
-                                    runs.back().opcodes.emplace_back(TextOpcode(
-                                        std::in_place_index_t<EnableBorder>()));
-                                }
-                                if (close) {
-                                    runs.back().opcodes.emplace_back(
-                                        TextOpcode(std::in_place_index_t<
-                                                   DisableBorder>()));
-                                }
+                            if (close) {
+                                st.font.pop();
                             }
-                            if (tag.font) {
-                                // this will begin a new run
-                                if (open) {
-                                    st.font.push(tag.font);
-                                }
-                                if (close) {
-                                    st.font.pop();
-                                }
-                                if (runs.back().font != st.font.top()) {
-                                    runs.emplace_back(st.font.top());
-                                }
+                            if (runs.back().font != st.font.top()) {
+                                runs.emplace_back(st.font.top());
                             }
                         }
                     }
                 }
-            } else {
-                // part of a raw text run
-                if (rawTextStart == -1) {
-                    rawTextStart = it.index();
-                }
             }
+            rawTextStart = i + 1;
         }
-        if (rawTextStart > -1) {
+        if (rawTextStart < s.size()) {
             size_t originalSize = runs.back().rawText.size();
             size_t begin = rawTextStart;
             size_t length = s.length() - begin;
@@ -403,34 +352,29 @@ struct TextParser {
         }
 
         // pass 2: shape and layout
-        size_t glyphCost = 0;
         for (size_t i = 0; i < runs.size(); ++i) {
             auto &run = runs[i];
             // shape the text
-            auto &hbBuf = run.hbBuf;
-            txt.buffers.push_back(hbBuf);
             auto &rawText = run.rawText;
-            hb_buffer_add_utf8(hbBuf, rawText.c_str(), rawText.size(), 0, -1);
-            run.font->shape(hbBuf);
-            Utf8Iterator it = rawText.begin();
-            unsigned int glyphCount;
-            hb_glyph_info_t *glyphInfo =
-                hb_buffer_get_glyph_infos(hbBuf, &glyphCount);
-            hb_glyph_position_t *glyphPos =
-                hb_buffer_get_glyph_positions(hbBuf, &glyphCount);
-
-            size_t glyphCursor = 0;
+            size_t glyphCursor = txt.glyphs.size();
+            engine->fonts.shapeCache.shape(run.font.get(), rawText,
+                                           txt.glyphs);
+            size_t glyphCount = txt.glyphs.size();
 
             hb_font_extents_t extents;
             hb_font_get_h_extents(run.font->font, &extents);
             lineHeight = (extents.ascender - extents.descender +
                           extents.line_gap); // * txt.size / FONT_SCALE;
 
-            this->addOp(txt,
-                        TextOpcode(std::in_place_index_t<StartTextRun>(),
-                                   (TextRunData){.font = run.font,
-                                                 .hbBuf = run.hbBuf,
-                                                 .lineHeight = lineHeight}));
+            if (i > 0 || run.font != runFont) {
+                // starting a run ends the current word, so text appended
+                // in the same font continues the last run instead
+                runFont = run.font;
+                this->addOp(
+                    txt, TextOpcode(std::in_place_index_t<StartTextRun>(),
+                                    (TextRunData){.font = run.font,
+                                                  .lineHeight = lineHeight}));
+            }
 
             for (auto &op : run.opcodes) {
                 switch (op.index()) {
@@ -438,40 +382,34 @@ struct TextParser {
                         size_t start = std::get<RawText>(op).first;
                         size_t end = start + std::get<RawText>(op).second;
                         for (; glyphCursor < glyphCount; ++glyphCursor) {
-                            hb_glyph_info_t &_glyphInfo =
-                                glyphInfo[glyphCursor];
-                            hb_glyph_position_t &_glyphPos =
-                                glyphPos[glyphCursor];
-                            size_t txtPointer = _glyphInfo.cluster;
+                            ShapedGlyph &glyph = txt.glyphs[glyphCursor];
+                            size_t txtPointer = glyph.cluster;
                             if (txtPointer >= end) {
                                 break;
                             }
-                            while (it.index() < txtPointer) {
-                                ++it;
-                            }
-                            char32_t c = *it;
-                            switch (c) {
+                            // clusters start on a character boundary, and
+                            // only ASCII matters here
+                            switch (rawText[txtPointer]) {
                                 case ' ': {
                                     flushWord(txt);
                                     cursor.x +=
-                                        _glyphPos.x_advance + txt.charSpacing;
+                                        glyph.xAdvance + txt.charSpacing;
                                     if (txt.opcodes.back().index() ==
                                         Whitespace) {
                                         std::get<Whitespace>(
                                             txt.opcodes.back()) +=
-                                            _glyphPos.x_advance +
+                                            glyph.xAdvance +
                                             txt.charSpacing;
                                     } else {
                                         txt.opcodes.emplace_back(
                                             std::in_place_index_t<Whitespace>(),
-                                            _glyphPos.x_advance +
+                                            glyph.xAdvance +
                                                 txt.charSpacing);
                                     }
                                     break;
                                 }
                                 default: {
-                                    glyphCost +=
-                                        1; // std::max(charDelays[c], 1);
+                                    chars += 1; // std::max(charDelays[c], 1);
                                     if (!word.empty() &&
                                         word.back().index() == GlyphBlock &&
                                         std::get<GlyphBlock>(word.back())
@@ -483,14 +421,14 @@ struct TextParser {
                                         auto &back = word.back();
                                         // add this glyph to the existing opcode
                                         ++std::get<GlyphBlock>(back).glyphs;
-                                        wordLength += _glyphPos.x_advance +
+                                        wordLength += glyph.xAdvance +
                                                       txt.charSpacing;
-                                        // cursor.x += _glyphPos.x_advance;
+                                        // cursor.x += glyph.xAdvance;
                                     } else {
                                         word.emplace_back(
                                             std::in_place_index_t<GlyphBlock>(),
                                             glyphCursor, 1, 0);
-                                        wordLength += _glyphPos.x_advance +
+                                        wordLength += glyph.xAdvance +
                                                       txt.charSpacing;
                                     }
                                 }
@@ -504,6 +442,27 @@ struct TextParser {
                 }
             }
         }
+
+        chars += countChars(txt, closedOps);
+        closedOps = txt.opcodes.size();
+        closedDimensions.copyFrom(txt.textDimensions);
+    }
+
+    /**
+     * Drop the opcodes added by finish(), so that appendText() can continue
+     * the last line. Returns the index of the first opcode that may change.
+     */
+    size_t resume(Text &txt) {
+        txt.opcodes.erase(txt.opcodes.begin() + closedOps, txt.opcodes.end());
+        txt.textDimensions.copyFrom(closedDimensions);
+        return closedOps;
+    }
+
+    /**
+     * Close the last line and finish the layout. This can't be resumed from,
+     * so it's done on a copy of the parser.
+     */
+    void finish(Text &txt) {
         newLine(txt);
 
         if (txt.wordWrap) {
@@ -513,20 +472,26 @@ struct TextParser {
             txt.dimensions.copyFrom(txt.textDimensions);
         }
 
-        txt.maxChars = glyphCost;
-        for (auto it : txt.opcodes) {
-            if (it.index() == CharDelay) {
-                txt.maxChars += std::get<CharDelay>(it);
-            } else if (it.index() == Whitespace) {
-                ++txt.maxChars;
-            }
-        }
+        txt.maxChars = chars + countChars(txt, closedOps);
 
         if (krit::Log::level("text") <= LogLevel::Debug) {
             debugPrint(txt.opcodes);
         }
     }
 
+    int countChars(Text &txt, size_t start) {
+        int count = 0;
+        for (size_t i = start; i < txt.opcodes.size(); ++i) {
+            TextOpcode &op = txt.opcodes[i];
+            if (op.index() == CharDelay) {
+                count += std::get<CharDelay>(op);
+            } else if (op.index() == Whitespace) {
+                ++count;
+            }
+        }
+        return count;
+    }
+
     void addInitialNewline(Text &txt) {
         if (newLineIndex == -1) {
             newLineIndex = txt.opcodes.size();
@@ -629,8 +594,6 @@ struct TextParser {
     }
 };
 
-TextRenderStack TextParser::stack;
-
 TextFormatTagOptions &TextFormatTagOptions::setFont(const std::string &name) {
     this->font = engine->fonts.getFont(name);
     assert(this->font);
@@ -645,24 +608,54 @@ TextOptions &TextOptions::setFont(const std::string &name) {
 
 Text::Text(const TextOptions &options) : TextOptions(options) { assert(font); }
 
-Text::~Text() { recycleBuffers(); }
-
-void Text::recycleBuffers() {
-    for (hb_buffer_t *hbBuf : buffers) {
-        recycleHbBuffer(hbBuf);
-    }
-    buffers.clear();
-}
+Text::~Text() {}
 
 void Text::refresh() {
     if (this->dirty || (this->wordWrap && dimensions.x != renderedSize.x)) {
-        // TODO: reuse static parser...
-        TextParser parser;
-        parser.parseText(*this, this->text, this->rich);
+        ProfileZone("Text::refresh");
+        layout = std::make_shared<TextParser>();
+        layout->parseText(*this, this->text, this->rich);
         this->dirty = false;
+        retainable = true;
+        if (this->text.empty()) {
+            layout = nullptr;
+            retained[0].valid = retained[1].valid = false;
+        } else {
+            finishLayout(0);
+        }
     }
 }
 
+void Text::finishLayout(size_t firstOp) {
+    TextParser finished(*layout);
+    finished.finish(*this);
+    retained[0].valid = retained[1].valid = false;
+    retainable = retainable &&
+                 std::none_of(opcodes.begin() + firstOp, opcodes.end(),
+                              [](TextOpcode &op) {
+                                  return op.index() == SetCustom ||
+                                         op.index() == RenderSprite;
+                              });
+}
+
+Text &Text::appendText(const std::string &text) {
+    if (text.empty()) {
+        return *this;
+    }
+    this->text += text;
+    if (this->dirty || !layout ||
+        (this->wordWrap && dimensions.x != renderedSize.x)) {
+        // no current layout to continue
+        this->dirty = true;
+        return *this;
+    }
+    ProfileZone("Text::appendText");
+    size_t firstOp = layout->resume(*this);
+    layout->appendText(*this, text);
+    finishLayout(firstOp);
+    return *this;
+}
+
 void Text::resize(float w, float h) {
     if (this->wordWrap) {
         if ((this->dimensions.x != static_cast<int>(w)) ||
@@ -683,12 +676,69 @@ void Text::render(RenderContext &ctx) {
     __render(ctx, false);
 }
 
+/**
+ * Glyph quads from one __render pass. Glyphs can land on different glyph
+ * cache pages, so they're grouped by page before being drawn; otherwise
+ * alternating pages would split the pass into a draw call per glyph.
+ */
+struct GlyphBatch {
+    RenderContext &ctx;
+    int zIndex;
+    std::vector<TextQuad> &quads;
+    // if set, quads are kept here, less `origin`, instead of being drawn
+    std::vector<TextQuad> *record = nullptr;
+    Point origin;
+
+    GlyphBatch(RenderContext &ctx, int zIndex)
+        : ctx(ctx), zIndex(zIndex), quads(scratch) {}
+    ~GlyphBatch() { flush(); }
+
+    void add(const DrawKey &key, const IntRectangle &rect,
+             const Matrix4 &matrix, const Color &color, float reveal = 0,
+             float revealBorder = 0) {
+        if (!key.image) {
+            // still being rasterized; see GlyphCache::getGlyph
+            return;
+        }
+        quads.push_back(
+            TextQuad{key, rect, matrix, color, reveal, revealBorder});
+    }
+
+    void flush() {
+        auto firstImage = quads.empty() ? nullptr : quads[0].key.image.get();
+        if (std::any_of(quads.begin(), quads.end(), [=](const TextQuad &quad) {
+                return quad.key.image.get() != firstImage;
+            })) {
+            std::stable_sort(quads.begin(), quads.end(),
+                             [](const TextQuad &a, const TextQuad &b) {
+                                 return a.key.image.get() < b.key.image.get();
+                             });
+        }
+        for (auto &quad : quads) {
+            if (record) {
+                TextQuad &local = record->emplace_back(quad);
+                local.matrix.translate(-origin.x, -origin.y, -origin.z);
+            } else {
+                ctx.addRect(quad.key, quad.rect, quad.matrix, quad.color,
+                            zIndex);
+            }
+        }
+        quads.clear();
+    }
+
+private:
+    static std::vector<TextQuad> scratch;
+};
+
+std::vector<TextQuad> GlyphBatch::scratch;
+
 void Text::__render(RenderContext &ctx, bool border) {
     if (charCount == 0) {
         return;
     }
 
     this->refresh();
+    ProfileZone("Text::__render");
 
     bool _borderEnabled = this->border;
 
@@ -707,14 +757,44 @@ void Text::__render(RenderContext &ctx, bool border) {
     float fontScale = size / cameraScale / 64.0;
     bool pixelPerfect = allowPixelPerfect && fontScale < 20;
 
-    hb_buffer_t *hbBuf = nullptr;
+    // the quads only move with `position` unless something else changed
+    Point origin(position);
+    if (pixelPerfect) {
+        float fullScaleX = cameraScale / scale.x,
+              fullScaleY = cameraScale / scale.y;
+        origin.x = std::round(origin.x * fullScaleX) / fullScaleX;
+        origin.y = std::round(origin.y * fullScaleY) / fullScaleY;
+    }
+    RetainedPass &pass = retained[border ? 0 : 1];
+    if (retainable) {
+        TextRenderState state = renderState(ctx);
+        if (pass.valid && pass.state == state &&
+            engine->fonts.glyphCache.touch(pass.glyphs)) {
+            drawRetained(ctx, pass, origin);
+            return;
+        }
+        pass.quads.clear();
+        pass.glyphs.clear();
+        pass.state = state;
+        // build quads for every character; drawRetained hides the ones
+        // charCount hasn't reached, so a reveal doesn't rebuild them
+        charCount = -1;
+    }
+    // characters revealed before the current one
+    float consumed = 0;
+
     std::shared_ptr<Font> font = this->font;
     int lineHeight = 0;
+    GlyphBatch batch(ctx, zIndex);
+    pass.valid = false;
+    if (retainable) {
+        batch.record = &pass.quads;
+        batch.origin = origin;
+    }
 
     for (TextOpcode &op : this->opcodes) {
         switch (op.index()) {
             case StartTextRun: {
-                hbBuf = std::get<StartTextRun>(op).hbBuf;
                 font = std::get<StartTextRun>(op).font;
                 lineHeight = std::get<StartTextRun>(op).lineHeight;
                 break;
@@ -767,6 +847,7 @@ void Text::__render(RenderContext &ctx, bool border) {
                         this->position.z);
                     Color originalColor(sprite->color);
                     sprite->color = sprite->color * color;
+                    batch.flush();
                     sprite->render(ctx);
                     sprite->color = originalColor;
                 }
@@ -774,6 +855,7 @@ void Text::__render(RenderContext &ctx, bool border) {
                 break;
             }
             case CharDelay: {
+                consumed += std::get<CharDelay>(op);
                 if (charCount > -1) {
                     charCount -= std::get<CharDelay>(op);
                     if (charCount <= 0) {
@@ -791,27 +873,29 @@ void Text::__render(RenderContext &ctx, bool border) {
                 break;
             }
             case GlyphBlock: {
-                unsigned int glyphCount;
-                hb_glyph_info_t *glyphInfo =
-                    hb_buffer_get_glyph_infos(hbBuf, &glyphCount);
-                hb_glyph_position_t *glyphPos =
-                    hb_buffer_get_glyph_positions(hbBuf, &glyphCount);
+                // SDF glyphs are rasterized at one size and scaled to fit
+                bool sdf = font->sdf;
+                float rasterScale = sdf ? Font::SDF_SIZE / size : glyphScale;
+                unsigned int glyphSize =
+                    sdf ? Font::SDF_SIZE : std::round(size * glyphScale);
                 for (size_t i = std::get<GlyphBlock>(op).startIndex;
                      i < std::get<GlyphBlock>(op).startIndex +
                              std::get<GlyphBlock>(op).glyphs;
                      ++i) {
-                    hb_glyph_info_t &_info = glyphInfo[i];
-                    hb_glyph_position_t &_pos = glyphPos[i];
-                    GlyphData &glyph =
-                        engine->fonts.getGlyph(font.get(), _info.codepoint,
-                                               std::round(size * glyphScale));
-                    // size_t txtPointer = _info.cluster;
+                    ShapedGlyph &shaped = glyphs[i];
+                    GlyphData &glyph = engine->fonts.getGlyph(
+                        font.get(), shaped.glyphId, glyphSize);
+                    if (retainable) {
+                        pass.glyphs.emplace_back(font->id, shaped.glyphId,
+                                                 glyphSize, 0);
+                    }
+                    // size_t txtPointer = shaped.cluster;
 
                     GlyphRenderData renderData(
-                        _info.codepoint, color,
+                        shaped.glyphId, color,
                         scale, // FIXME
-                        Point((cursor.x + _pos.x_offset) * fontScale,
-                              (cursor.y - _pos.y_offset) * fontScale));
+                        Point((cursor.x + shaped.xOffset) * fontScale,
+                              (cursor.y - shaped.yOffset) * fontScale));
                     if (custom) {
                         custom(&ctx, this, &renderData);
                     }
@@ -827,8 +911,8 @@ void Text::__render(RenderContext &ctx, bool border) {
                             std::round(matrix.tx() * fullScaleX) / fullScaleX;
                         matrix.ty() =
                             std::round(matrix.ty() * fullScaleY) / fullScaleY;
-                        matrix.a() = 1.0 / glyphScale / fullScaleX;
-                        matrix.d() = 1.0 / glyphScale / fullScaleY;
+                        matrix.a() = 1.0 / rasterScale / fullScaleX;
+                        matrix.d() = 1.0 / rasterScale / fullScaleY;
                         matrix.a() *= ctx.camera->scale.x / ctx.camera->scale.y;
                         matrix.b() = matrix.c() = 0;
                         matrix.translate(
@@ -837,9 +921,9 @@ void Text::__render(RenderContext &ctx, bool border) {
                             std::round(renderData.position.y * fullScaleY) /
                                 fullScaleY);
                         matrix.translate(
-                            std::round(glyph.offset.x / glyphScale) /
+                            std::round(glyph.offset.x / rasterScale) /
                                 fullScaleX,
-                            std::round(-glyph.offset.y / glyphScale) /
+                            std::round(-glyph.offset.y / rasterScale) /
                                 fullScaleY);
                     } else {
                         key.smooth = smooth == SmoothingMode::SmoothMipmap
@@ -849,18 +933,24 @@ void Text::__render(RenderContext &ctx, bool border) {
                                          position.y + renderData.position.y,
                                          position.z);
                         matrix.a() = ctx.camera->scale.x / ctx.camera->scale.y /
-                                     glyphScale / fullScaleX;
-                        matrix.d() = 1.0 / glyphScale / fullScaleY;
+                                     rasterScale / fullScaleX;
+                        matrix.d() = 1.0 / rasterScale / fullScaleY;
                         matrix.b() = matrix.c() = 0;
                         matrix.translate(
-                            glyph.offset.x / glyphScale / fullScaleX,
-                            -glyph.offset.y / glyphScale / fullScaleY);
+                            glyph.offset.x / rasterScale / fullScaleX,
+                            -glyph.offset.y / rasterScale / fullScaleY);
                     }
                     key.image = glyph.region.img;
                     key.blend = blendMode;
-                    key.shader = this->shader
-                                     ? this->shader
-                                     : engine->renderer.getDefaultTextShader();
+                    if (this->shader) {
+                        key.shader = this->shader;
+                    } else if (sdf) {
+                        key.smooth = SmoothingMode::SmoothLinear;
+                        key.shader = engine->renderer.getSdfTextShader(
+                            Font::sdfThreshold(0));
+                    } else {
+                        key.shader = engine->renderer.getDefaultTextShader();
+                    }
                     if (border) {
                         if (_borderEnabled) {
                             float thickness = borderThickness * cameraScale;
@@ -868,16 +958,32 @@ void Text::__render(RenderContext &ctx, bool border) {
                                               this->borderColor.g,
                                               this->borderColor.b,
                                               this->borderColor.a * color.a);
-                            GlyphData &borderGlyph = engine->fonts.getGlyph(
-                                font.get(), _info.codepoint,
-                                std::round(size * glyphScale),
-                                std::round(thickness * glyphScale));
+                            // SDF borders reuse the glyph, with the edge
+                            // pushed outward by the shader
+                            unsigned int borderSize =
+                                sdf ? 0 : std::round(thickness * glyphScale);
+                            GlyphData &borderGlyph =
+                                sdf ? glyph
+                                    : engine->fonts.getGlyph(
+                                          font.get(), shaped.glyphId,
+                                          glyphSize, borderSize);
+                            if (retainable && !sdf) {
+                                pass.glyphs.emplace_back(font->id,
+                                                         shaped.glyphId,
+                                                         glyphSize, borderSize);
+                            }
+                            key.image = borderGlyph.region.img;
+                            if (sdf && !this->shader) {
+                                key.shader = engine->renderer.getSdfTextShader(
+                                    Font::sdfThreshold(thickness *
+                                                       rasterScale));
+                            }
                             matrix.tx() +=
                                 (borderGlyph.offset.x - glyph.offset.x) /
-                                glyphScale / fullScaleX;
+                                rasterScale / fullScaleX;
                             matrix.ty() -=
                                 (borderGlyph.offset.y - glyph.offset.y) /
-                                glyphScale / fullScaleY;
+                                rasterScale / fullScaleY;
                             if (pitch) {
                                 matrix.pitch(pitch);
                             }
@@ -889,11 +995,10 @@ void Text::__render(RenderContext &ctx, bool border) {
                                     thickness + (borderGlyph.region.rect.width -
                                                  thickness) *
                                                     fraction;
-                                ctx.addRect(key, newRect, matrix, borderColor,
-                                            zIndex);
+                                batch.add(key, newRect, matrix, borderColor);
                             } else {
-                                ctx.addRect(key, borderGlyph.region.rect,
-                                            matrix, borderColor, zIndex);
+                                batch.add(key, borderGlyph.region.rect, matrix,
+                                          borderColor, consumed, thickness);
                             }
                         }
                     } else {
@@ -905,16 +1010,16 @@ void Text::__render(RenderContext &ctx, bool border) {
                             float fraction = fmod(charCount, 1);
                             IntRectangle newRect(glyph.region.rect);
                             newRect.width *= fraction;
-                            ctx.addRect(key, newRect, matrix, renderData.color,
-                                        zIndex);
+                            batch.add(key, newRect, matrix, renderData.color);
                         } else {
-                            ctx.addRect(key, glyph.region.rect, matrix,
-                                        renderData.color, zIndex);
+                            batch.add(key, glyph.region.rect, matrix,
+                                      renderData.color, consumed);
                         }
                     }
 
                     cursor.x +=
-                        _pos.x_advance * renderData.scale.x + charSpacing;
+                        shaped.xAdvance * renderData.scale.x + charSpacing;
+                    ++consumed;
                     if (charCount > -1) {
                         // FIXME: charDelays
                         --charCount; //   -= std::max(charDelays[*it], 1);
@@ -926,6 +1031,7 @@ void Text::__render(RenderContext &ctx, bool border) {
                 break;
             }
             case Whitespace: {
+                ++consumed;
                 if (charCount > -1) {
                     --charCount;
                     if (charCount <= 0) {
@@ -944,6 +1050,65 @@ void Text::__render(RenderContext &ctx, bool border) {
             }
         }
     }
+
+    if (retainable) {
+        batch.flush();
+        // repeated glyphs only need to be kept alive once
+        std::sort(pass.glyphs.begin(), pass.glyphs.end(), GlyphSizeLess());
+        pass.glyphs.erase(std::unique(pass.glyphs.begin(), pass.glyphs.end()),
+                          pass.glyphs.end());
+        pass.valid = true;
+        drawRetained(ctx, pass, origin);
+    }
+}
+
+void Text::drawRetained(RenderContext &ctx, RetainedPass &pass,
+                        const Point &origin) {
+    for (auto &quad : pass.quads) {
+        float remaining = charCount - quad.reveal;
+        if (charCount > -1 && quad.reveal > 0 && remaining <= 0) {
+            continue;
+        }
+        Matrix4 matrix(quad.matrix);
+        matrix.translate(origin.x, origin.y, origin.z);
+        if (charCount > -1 && remaining > 0 && remaining < 1) {
+            // rare case: partial last character
+            IntRectangle rect(quad.rect);
+            rect.width = quad.revealBorder +
+                         (quad.rect.width - quad.revealBorder) * remaining;
+            ctx.addRect(quad.key, rect, matrix, quad.color, zIndex);
+        } else {
+            ctx.addRect(quad.key, quad.rect, matrix, quad.color, zIndex);
+        }
+    }
+}
+
+TextRenderState Text::renderState(RenderContext &ctx) {
+    TextRenderState state;
+    state.glyphGeneration = engine->fonts.glyphCache.generation;
+    if (dynamicSize) {
+        state.cameraScale = ctx.camera->scale;
+    } else {
+        // only the aspect ratio matters
+        state.cameraScale.setTo(ctx.camera->scale.x / ctx.camera->scale.y, 1);
+    }
+    state.font = font.get();
+    state.size = size;
+    state.charSpacing = charSpacing;
+    state.color = color;
+    state.baseColor = baseColor;
+    state.borderColor = borderColor;
+    state.borderThickness = borderThickness;
+    state.border = border;
+    state.scale = scale;
+    state.glyphScale = glyphScale;
+    state.pitch = pitch;
+    state.shader = shader;
+    state.blendMode = blendMode;
+    state.smooth = smooth;
+    state.allowPixelPerfect = allowPixelPerfect;
+    state.dynamicSize = dynamicSize;
+    return state;
 }
 
 Text &Text::setText(const std::string &text) {
@@ -965,6 +1130,8 @@ Text &Text::setRichText(const std::string &text) {
 }
 
 void Text::setTabStops(const std::string &stops) {
+    // tab stops are applied during layout
+    this->dirty = true;
     tabStops.clear();
     std::stringstream stream(stops);
     std::string token;
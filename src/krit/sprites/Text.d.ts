@@ -51,6 +51,7 @@ declare class Text extends Sprite {
     scale: Vec2f;
     wordWrap: boolean;
 
+    appendText(s: string): void;
     refresh(): void;
     invalidate(): void;
     set font(s: string);
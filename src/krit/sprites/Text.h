@@ -5,7 +5,9 @@
 #include "krit/Sprite.h"
 #include "krit/asset/Font.h"
 #include "krit/math/Dimensions.h"
+#include "krit/math/Matrix.h"
 #include "krit/math/Point.h"
+#include "krit/render/DrawKey.h"
 #include "krit/utils/Color.h"
 #include <cassert>
 #include <functional>
@@ -16,12 +18,12 @@
 #include <variant>
 #include <vector>
 
-struct hb_buffer_t;
 struct hb_font_t;
 
 namespace krit {
 
 struct Text;
+struct TextParser;
 struct RenderContext;
 
 enum AlignType {
@@ -148,7 +150,6 @@ struct GlyphBlockData {
 
 struct TextRunData {
     std::shared_ptr<Font> font;
-    hb_buffer_t *hbBuf;
     int lineHeight = 0;
 };
 
@@ -178,6 +179,60 @@ using TextOpcode =
                  NewlineData, Sprite *, std::monostate, float, int,
                  std::monostate, std::monostate>;
 
+/**
+ * A glyph quad produced by Text rendering.
+ */
+struct TextQuad {
+    DrawKey key;
+    IntRectangle rect;
+    Matrix4 matrix;
+    Color color;
+    // characters revealed before this quad's; see Text::charCount
+    float reveal = 0;
+    // width of a partially revealed quad that is shown regardless
+    float revealBorder = 0;
+};
+
+/**
+ * Everything besides the layout that a Text's quads depend on. Quads are
+ * reused for as long as this doesn't change.
+ */
+struct TextRenderState {
+    unsigned glyphGeneration = 0;
+    Vec2f cameraScale;
+    Font *font = nullptr;
+    int size = 0;
+    float charSpacing = 0;
+    Color color;
+    Color baseColor;
+    Color borderColor;
+    int borderThickness = 0;
+    bool border = false;
+    Vec2f scale;
+    float glyphScale = 0;
+    float pitch = 0;
+    SpriteShader *shader = nullptr;
+    BlendMode blendMode = Alpha;
+    SmoothingMode smooth = SmoothLinear;
+    bool allowPixelPerfect = false;
+    bool dynamicSize = false;
+
+    bool operator==(TextRenderState &other) {
+        return glyphGeneration == other.glyphGeneration &&
+               cameraScale == other.cameraScale && font == other.font &&
+               size == other.size && charSpacing == other.charSpacing &&
+               color == other.color && baseColor == other.baseColor &&
+               borderColor == other.borderColor &&
+               borderThickness == other.borderThickness &&
+               border == other.border && scale == other.scale &&
+               glyphScale == other.glyphScale && pitch == other.pitch &&
+               shader == other.shader &&
+               blendMode == other.blendMode && smooth == other.smooth &&
+               allowPixelPerfect == other.allowPixelPerfect &&
+               dynamicSize == other.dynamicSize;
+    }
+};
+
 struct Text : public Sprite, public TextOptions {
     static std::unordered_map<std::string, TextFormatTagOptions> formatTags;
 
@@ -204,6 +259,11 @@ struct Text : public Sprite, public TextOptions {
 
     Text &setText(const std::string &text);
     Text &setRichText(const std::string &text);
+    /**
+     * Add text to the end, tags included. Only the new text is shaped and
+     * laid out, continuing from the end of the last line.
+     */
+    Text &appendText(const std::string &text);
     void refresh();
     void invalidate() { dirty = true; }
 
@@ -226,9 +286,25 @@ struct Text : public Sprite, public TextOptions {
     void setTabStops(const std::string &stops);
 
 private:
-    void recycleBuffers();
     std::vector<TextOpcode> opcodes;
-    std::vector<hb_buffer_t*> buffers;
+    // shaped glyphs of every run; GlyphBlocks index into this
+    std::vector<ShapedGlyph> glyphs;
+    // parser state at the end of the text, for appendText
+    std::shared_ptr<TextParser> layout;
+
+    // quads from the last border and fill passes, relative to `position`
+    struct RetainedPass {
+        TextRenderState state;
+        std::vector<TextQuad> quads;
+        // the glyphs the quads were built from, which have to be kept in the
+        // glyph cache while they're drawn
+        std::vector<GlyphSize> glyphs;
+        bool valid = false;
+    };
+    RetainedPass retained[2];
+    // false if inline sprites or custom render functions make each frame
+    // different
+    bool retainable = false;
     bool rich = false;
     bool dirty = false;
     Dimensions renderedSize;
@@ -237,6 +313,10 @@ private:
     friend struct TextParser;
 
     void __render(RenderContext &ctx, bool border);
+    void drawRetained(RenderContext &ctx, RetainedPass &pass,
+                      const Point &origin);
+    void finishLayout(size_t firstOp);
+    TextRenderState renderState(RenderContext &ctx);
 };
 
 }
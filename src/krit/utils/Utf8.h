@@ -1,7 +1,41 @@
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <string_view>
 
 namespace krit {
 
+/**
+ * Find the first occurrence of any of `Delimiters`, which must be ASCII, in
+ * `s` at or after `pos`; returns `s.size()` if there is none. Bytes of
+ * multibyte UTF-8 characters are never ASCII, so this doesn't need to
+ * decode anything. Checks eight bytes at a time.
+ */
+template <char... Delimiters>
+size_t findAscii(std::string_view s, size_t pos) {
+    static_assert(((Delimiters > 0) && ...), "delimiters must be ASCII");
+    const uint64_t ones = 0x0101010101010101ull;
+    const uint64_t highBits = 0x8080808080808080ull;
+    for (; pos + 8 <= s.size(); pos += 8) {
+        uint64_t word;
+        memcpy(&word, s.data() + pos, 8);
+        // nonzero iff some byte of `word` equals a delimiter
+        uint64_t found = 0;
+        ((found |= ((word ^ ones * (uint8_t)Delimiters) - ones) &
+                   ~(word ^ ones * (uint8_t)Delimiters) & highBits),
+         ...);
+        if (found) {
+            break;
+        }
+    }
+    for (; pos < s.size(); ++pos) {
+        if (((s[pos] == Delimiters) || ...)) {
+            return pos;
+        }
+    }
+    return s.size();
+}
+
 /**
  * Adapted from http://www.nubaria.com/en/blog/?p=371
  */
@@ -0,0 +1,176 @@
+#include "Test.h"
+#include "krit/asset/AssetCache.h"
+#include <string>
+
+using namespace krit;
+
+namespace {
+
+// an asset costing as many bytes as its id says, e.g. "a:40"
+struct SmallAsset {
+    size_t bytes;
+};
+struct LargeAsset {
+    size_t bytes;
+};
+
+size_t parseCost(const std::string &id) {
+    return std::stoul(id.substr(id.find(':') + 1));
+}
+
+}
+
+namespace krit {
+
+template <> AssetType AssetLoader<SmallAsset>::type() { return TextAsset; }
+template <>
+std::shared_ptr<SmallAsset>
+AssetLoader<SmallAsset>::loadAsset(const std::string &id) {
+    if (id.find(':') == std::string::npos) {
+        return nullptr;
+    }
+    return std::make_shared<SmallAsset>(SmallAsset{parseCost(id)});
+}
+template <> AssetCost AssetLoader<SmallAsset>::cost(SmallAsset *asset) {
+    return AssetCost{asset->bytes};
+}
+
+template <> AssetType AssetLoader<LargeAsset>::type() { return ImageAsset; }
+template <>
+std::shared_ptr<LargeAsset>
+AssetLoader<LargeAsset>::loadAsset(const std::string &id) {
+    return std::make_shared<LargeAsset>(LargeAsset{parseCost(id)});
+}
+template <> AssetCost AssetLoader<LargeAsset>::cost(LargeAsset *asset) {
+    return AssetCost{0, asset->bytes};
+}
+
+}
+
+namespace {
+
+enum { Small, Large };
+
+struct TestCache : public AssetCacheBase<SmallAsset, LargeAsset> {
+    template <int A> bool has(const std::string &id) {
+        return std::get<A>(cache).count(id);
+    }
+
+    // load without holding on to the asset, then move on to the next frame
+    template <int A> void load(const std::string &id) {
+        get<A>(id);
+        ++frame;
+    }
+};
+
+}
+
+TEST(AssetCache, hitsAndMisses) {
+    TestCache cache;
+    auto a = cache.get<Small>("a:10");
+    CHECK(a && a->bytes == 10);
+    CHECK_EQ(cache.get<Small>("a:10"), a);
+    CHECK_EQ(cache.typeStats[Small].hits, 1u);
+    CHECK_EQ(cache.typeStats[Small].misses, 1u);
+    CHECK_EQ(cache.typeStats[Small].loads, 1u);
+    CHECK(!cache.get<Small>("broken"));
+    CHECK_EQ(cache.typeStats[Small].failures, 1u);
+    CHECK_EQ(cache.used, 10u);
+    CHECK_EQ(cache.budgets[Small].used, 10u);
+}
+
+TEST(AssetCache, evictsLeastRecentlyUsed) {
+    TestCache cache;
+    cache.budget = 100;
+    cache.load<Small>("a:40");
+    cache.load<Small>("b:40");
+    // touching `a` makes `b` the oldest
+    cache.load<Small>("a:40");
+    cache.load<Small>("c:40");
+    CHECK(cache.has<Small>("a:40"));
+    CHECK(!cache.has<Small>("b:40"));
+    CHECK(cache.has<Small>("c:40"));
+    CHECK_EQ(cache.used, 80u);
+    CHECK_EQ(cache.typeStats[Small].evictions, 1u);
+}
+
+TEST(AssetCache, keepsReferencedAssets) {
+    TestCache cache;
+    cache.budget = 100;
+    auto held = cache.get<Small>("a:60");
+    ++cache.frame;
+    cache.load<Small>("b:60");
+    // `a` is still referenced and `b` was just used, so nothing is dropped
+    CHECK(cache.has<Small>("a:60"));
+    cache.load<Small>("c:30");
+    CHECK(cache.has<Small>("a:60"));
+    CHECK(!cache.has<Small>("b:60"));
+    CHECK(cache.has<Small>("c:30"));
+    held.reset();
+    cache.load<Small>("d:30");
+    CHECK(!cache.has<Small>("a:60"));
+    CHECK_EQ(cache.used, 60u);
+}
+
+TEST(AssetCache, keepsAssetsUsedThisFrame) {
+    TestCache cache;
+    cache.budget = 50;
+    cache.get<Small>("a:40");
+    cache.get<Small>("b:40");
+    // over budget, but both were requested this frame
+    CHECK(cache.has<Small>("a:40") && cache.has<Small>("b:40"));
+    CHECK_EQ(cache.used, 80u);
+    ++cache.frame;
+    cache.get<Small>("c:20");
+    CHECK(!cache.has<Small>("a:40"));
+    CHECK(!cache.has<Small>("b:40"));
+    CHECK_EQ(cache.used, 20u);
+}
+
+TEST(AssetCache, typeCeiling) {
+    TestCache cache;
+    cache.setLimit<Large>(100);
+    cache.load<Large>("a:60");
+    cache.load<Small>("x:500");
+    cache.load<Large>("b:60");
+    CHECK(!cache.has<Large>("a:60"));
+    CHECK(cache.has<Large>("b:60"));
+    // no overall budget, so other types are unaffected
+    CHECK(cache.has<Small>("x:500"));
+    CHECK_EQ(cache.budgets[Large].used, 60u);
+}
+
+TEST(AssetCache, typeFloor) {
+    TestCache cache;
+    cache.budget = 100;
+    cache.setFloor<Large>(60);
+    cache.load<Large>("a:60");
+    cache.load<Small>("x:30");
+    cache.load<Small>("y:30");
+    // `a` is the oldest, but its type is at its floor
+    CHECK(cache.has<Large>("a:60"));
+    CHECK(!cache.has<Small>("x:30"));
+    CHECK(cache.has<Small>("y:30"));
+    CHECK_EQ(cache.used, 90u);
+}
+
+TEST(AssetCache, invalidateDropsChangedAssets) {
+    TestCache cache;
+    auto held = cache.get<Small>("a:10");
+    cache.load<Small>("b:20");
+    cache.load<Large>("a:10");
+    cache.invalidate("a:10");
+    // every type loaded from the file is dropped, and nothing else
+    CHECK(!cache.has<Small>("a:10"));
+    CHECK(!cache.has<Large>("a:10"));
+    CHECK(cache.has<Small>("b:20"));
+    CHECK_EQ(cache.used, 20u);
+    CHECK_EQ(cache.budgets[Small].used, 20u);
+    CHECK_EQ(cache.budgets[Large].used, 0u);
+    CHECK_EQ(cache.typeStats[Small].evictions, 0u);
+    // holders keep the old copy; the next request loads a new one
+    CHECK(held && held->bytes == 10);
+    auto reloaded = cache.get<Small>("a:10");
+    CHECK(reloaded && reloaded != held);
+    CHECK_EQ(cache.typeStats[Small].loads, 3u);
+}
@@ -0,0 +1,85 @@
+#include "Test.h"
+#include "krit/asset/GlyphTable.h"
+#include <map>
+#include <random>
+#include <tuple>
+
+using namespace krit;
+
+static GlyphSize key(uint32_t font, char32_t glyph, unsigned size = 16,
+                     unsigned border = 0) {
+    return GlyphSize(font, glyph, size, border);
+}
+
+TEST(GlyphTable, findInserted) {
+    GlyphTable table;
+    CHECK(!table.find(key(8, 'a')));
+    table.insert(key(8, 'a')).lastUsed = 1;
+    table.insert(key(8, 'b')).lastUsed = 2;
+    table.insert(key(16, 'a')).lastUsed = 3;
+    CHECK_EQ(table.size(), 3u);
+    CHECK_EQ(table.find(key(8, 'a'))->lastUsed, 1u);
+    CHECK_EQ(table.find(key(8, 'b'))->lastUsed, 2u);
+    CHECK_EQ(table.find(key(16, 'a'))->lastUsed, 3u);
+    CHECK(!table.find(key(8, 'a', 17)));
+    CHECK(!table.find(key(8, 'a', 16, 1)));
+}
+
+TEST(GlyphTable, pointersSurviveGrowth) {
+    GlyphTable table;
+    GlyphData *first = &table.insert(key(8, 0));
+    for (char32_t i = 1; i < 2000; ++i) {
+        table.insert(key(8, i)).lastUsed = i;
+    }
+    CHECK_EQ(table.find(key(8, 0)), first);
+    for (char32_t i = 1; i < 2000; ++i) {
+        CHECK_EQ(table.find(key(8, i))->lastUsed, i);
+    }
+}
+
+// erasing shifts later entries back into the gap; check every survivor can
+// still be found, against a map, through many rounds of inserts and erases
+TEST(GlyphTable, eraseKeepsProbeChains) {
+    GlyphTable table;
+    using Key = std::tuple<uint32_t, char32_t, unsigned>;
+    std::map<Key, unsigned> expected;
+    std::mt19937 random(1234);
+    unsigned next = 1;
+    for (int round = 0; round < 50; ++round) {
+        for (int i = 0; i < 150; ++i) {
+            Key k(1 + random() % 4, random() % 500, 8 + random() % 4);
+            if (expected.count(k)) {
+                continue;
+            }
+            GlyphSize size = key(std::get<0>(k), std::get<1>(k), std::get<2>(k));
+            table.insert(size).lastUsed = next;
+            expected[k] = next++;
+        }
+        unsigned cutoff = next - 100 - random() % 100;
+        table.eraseIf([&](const GlyphSize &, GlyphData &glyph) {
+            return glyph.lastUsed < cutoff;
+        });
+        for (auto it = expected.begin(); it != expected.end();) {
+            it = it->second < cutoff ? expected.erase(it) : std::next(it);
+        }
+        CHECK_EQ(table.size(), expected.size());
+        for (auto &[k, lastUsed] : expected) {
+            GlyphData *found =
+                table.find(key(std::get<0>(k), std::get<1>(k), std::get<2>(k)));
+            CHECK(found && found->lastUsed == lastUsed);
+        }
+        size_t visited = 0;
+        table.forEach([&](const GlyphSize &, GlyphData &) { ++visited; });
+        CHECK_EQ(visited, expected.size());
+    }
+}
+
+TEST(GlyphTable, erasedDataIsReset) {
+    GlyphTable table;
+    table.insert(key(8, 'a')).lastUsed = 5;
+    table.eraseIf([](const GlyphSize &, GlyphData &) { return true; });
+    CHECK_EQ(table.size(), 0u);
+    CHECK(!table.find(key(8, 'a')));
+    // the freed data is reused, and comes back blank
+    CHECK_EQ(table.insert(key(8, 'b')).lastUsed, 0u);
+}
@@ -0,0 +1,110 @@
+#include "Test.h"
+#include "krit/Engine.h"
+#include "krit/TaskManager.h"
+#include "krit/io/Io.h"
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zip.h>
+
+using namespace krit;
+
+namespace {
+
+/**
+ * Write a zip archive of `contents`, named by `names`, compressing every
+ * other entry. Returns false if libzip couldn't.
+ */
+bool writeArchive(const std::filesystem::path &path,
+                  const std::vector<std::string> &names,
+                  const std::vector<std::string> &contents) {
+    int error = 0;
+    zip_t *zip = zip_open(path.c_str(), ZIP_CREATE | ZIP_TRUNCATE, &error);
+    if (!zip) {
+        return false;
+    }
+    for (size_t i = 0; i < names.size(); ++i) {
+        // the buffers outlive zip_close, so libzip needn't copy them
+        zip_source_t *source = zip_source_buffer(zip, contents[i].data(),
+                                                 contents[i].size(), 0);
+        zip_int64_t index =
+            source ? zip_file_add(zip, names[i].c_str(), source, 0) : -1;
+        if (index < 0) {
+            zip_source_free(source);
+            zip_discard(zip);
+            return false;
+        }
+        if (i % 2) {
+            zip_set_file_compression(zip, index, ZIP_CM_STORE, 0);
+        }
+    }
+    return zip_close(zip) == 0;
+}
+
+/**
+ * Entry contents which differ in size and bytes, so a read from the wrong
+ * offset or handle can't match by accident.
+ */
+std::string entryContents(size_t i) {
+    std::string s;
+    size_t size = 1 + (i * 7919) % 200000;
+    s.reserve(size);
+    uint32_t state = 0x9e3779b9u * (uint32_t)(i + 1);
+    while (s.size() < size) {
+        state = state * 1664525u + 1013904223u;
+        // half of each entry is text, which deflates, and half noise
+        s += s.size() < size / 2 ? (char)('a' + i % 26) : (char)(state >> 24);
+    }
+    return s;
+}
+
+}
+
+TEST(IoZip, parallelReads) {
+    KritOptions options;
+    options.setHeadless(true);
+    Engine headless(options);
+    auto scope = headless.scope();
+
+    auto dir = std::filesystem::temp_directory_path() / "krit-iozip-test";
+    std::filesystem::create_directories(dir);
+    auto archive = dir / "stress.zip";
+    std::vector<std::string> names, contents;
+    for (size_t i = 0; i < 64; ++i) {
+        names.push_back("assets/dir" + std::to_string(i % 4) + "/file" +
+                        std::to_string(i) + ".bin");
+        contents.push_back(entryContents(i));
+    }
+    CHECK(writeArchive(archive, names, contents));
+    CHECK(ioZip->addRoot(archive));
+
+    // every thread reads every entry, starting at different places so that
+    // threads are decompressing the same entries at the same time
+    const int threadCount = 8;
+    const int rounds = 10;
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int round = 0; round < rounds; ++round) {
+                for (size_t i = 0; i < names.size(); ++i) {
+                    size_t entry = (i + t * 3) % names.size();
+                    if (ioZip->readFile(names[entry]) != contents[entry]) {
+                        ++mismatches;
+                    }
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    CHECK_EQ(mismatches.load(), 0);
+
+    ioZip->disableRoot(archive);
+    headless.taskManager->cleanup();
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,80 @@
+#include "Test.h"
+#include "krit/io/PackFormat.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace krit;
+
+namespace {
+
+struct Toc {
+    std::vector<PackEntry> entries;
+    std::string names;
+
+    void add(const std::string &name, uint64_t hash, uint64_t offset) {
+        PackEntry entry{};
+        entry.nameHash = hash;
+        entry.offset = offset;
+        entry.nameOffset = names.size();
+        entry.nameLength = name.size();
+        names += name;
+        entries.push_back(entry);
+    }
+
+    void add(const std::string &name, uint64_t offset) {
+        add(name, packHash(name), offset);
+    }
+
+    void sort() {
+        std::sort(entries.begin(), entries.end(),
+                  [](const PackEntry &a, const PackEntry &b) {
+                      return a.nameHash < b.nameHash;
+                  });
+    }
+
+    const PackEntry *find(std::string_view path) {
+        return findPackEntry(entries.data(), entries.size(), names.data(),
+                             path);
+    }
+};
+
+}
+
+TEST(PackFormat, hashMatchesPackTool) {
+    // FNV-1a test vectors; pack.py must agree
+    CHECK_EQ(packHash(""), 0xcbf29ce484222325ull);
+    CHECK_EQ(packHash("a"), 0xaf63dc4c8601ec8cull);
+    CHECK_EQ(packHash("foobar"), 0x85944171f73967e8ull);
+}
+
+TEST(PackFormat, findEntries) {
+    Toc toc;
+    CHECK(!toc.find("missing"));
+    for (int i = 0; i < 200; ++i) {
+        toc.add("img/sprite" + std::to_string(i) + ".png", i * 4096);
+    }
+    toc.sort();
+    for (int i = 0; i < 200; ++i) {
+        const PackEntry *entry =
+            toc.find("img/sprite" + std::to_string(i) + ".png");
+        CHECK(entry && entry->offset == (uint64_t)i * 4096);
+    }
+    CHECK(!toc.find("img/sprite200.png"));
+    CHECK(!toc.find("img/sprite1.pn"));
+    CHECK(!toc.find(""));
+}
+
+TEST(PackFormat, findCollidingNames) {
+    // entries with the same hash are told apart by name
+    Toc toc;
+    uint64_t hash = packHash("b");
+    toc.add("a", 1, 10);
+    toc.add("x", hash, 20);
+    toc.add("y", hash, 30);
+    toc.add("b", 40);
+    toc.add("z", ~0ull, 50);
+    toc.sort();
+    CHECK(toc.find("b") && toc.find("b")->offset == 40);
+    CHECK(!toc.find("x"));
+}
@@ -0,0 +1,47 @@
+#include "Test.h"
+#include "krit/render/Premultiply.h"
+#include <vector>
+
+using namespace krit;
+
+TEST(Premultiply, everyColorAndAlpha) {
+    // one row per alpha, one pixel per channel value, padded rows so both
+    // the vector loop and the tail see every combination
+    const int width = 257;
+    const size_t pitch = width * 4 + 12;
+    std::vector<uint8_t> pixels(pitch * 256, 0xcd), original;
+    for (int a = 0; a < 256; ++a) {
+        for (int c = 0; c < width; ++c) {
+            uint8_t *px = &pixels[a * pitch + c * 4];
+            px[0] = c;
+            px[1] = 255 - c % 256;
+            px[2] = c / 2;
+            px[3] = a;
+        }
+    }
+    original = pixels;
+    premultiplyAlpha(pixels.data(), width, 256, pitch);
+    int wrong = 0;
+    for (int a = 0; a < 256; ++a) {
+        for (int c = 0; c < width; ++c) {
+            const uint8_t *before = &original[a * pitch + c * 4];
+            const uint8_t *after = &pixels[a * pitch + c * 4];
+            for (int channel = 0; channel < 3; ++channel) {
+                // rounded to nearest
+                wrong += after[channel] != (before[channel] * a + 127) / 255;
+            }
+            wrong += after[3] != a;
+        }
+        // padding is left alone
+        for (size_t i = width * 4; i < pitch; ++i) {
+            wrong += pixels[a * pitch + i] != 0xcd;
+        }
+    }
+    CHECK_EQ(wrong, 0);
+}
+
+TEST(Premultiply, pixel) {
+    CHECK_EQ(premultiplyPixel(0xff336699u), 0xff336699u);
+    CHECK_EQ(premultiplyPixel(0x00ffffffu), 0x00000000u);
+    CHECK_EQ(premultiplyPixel(0x80ff8000u), 0x80804000u);
+}
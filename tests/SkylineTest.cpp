@@ -0,0 +1,83 @@
+#include "Test.h"
+#include "krit/render/Skyline.h"
+#include <random>
+#include <vector>
+
+using namespace krit;
+
+static bool overlaps(const IntRectangle &a, const IntRectangle &b) {
+    return a.x < b.right() && b.x < a.right() && a.y < b.bottom() &&
+           b.y < a.bottom();
+}
+
+static void checkNodes(const Skyline &skyline) {
+    int x = 0;
+    for (size_t i = 0; i < skyline.nodes.size(); ++i) {
+        auto &node = skyline.nodes[i];
+        CHECK_EQ(node.x, x);
+        CHECK(node.width > 0);
+        CHECK(node.y >= 0 && node.y <= skyline.size);
+        if (i > 0) {
+            CHECK(node.y != skyline.nodes[i - 1].y);
+        }
+        x += node.width;
+    }
+    CHECK_EQ(x, skyline.size);
+}
+
+TEST(Skyline, fillsRows) {
+    Skyline skyline;
+    skyline.reset(64);
+    IntRectangle slot;
+    for (int i = 0; i < 16; ++i) {
+        CHECK(skyline.pack(16, 16, slot));
+        CHECK_EQ(slot.x, i % 4 * 16);
+        CHECK_EQ(slot.y, i / 4 * 16);
+    }
+    CHECK(!skyline.pack(1, 1, slot));
+    skyline.reset(64);
+    CHECK(skyline.pack(64, 64, slot));
+    CHECK(!skyline.pack(65, 1, slot));
+}
+
+TEST(Skyline, prefersLowestTop) {
+    Skyline skyline;
+    skyline.reset(100);
+    IntRectangle tall, shortSlot, next;
+    CHECK(skyline.pack(50, 40, tall));
+    CHECK(skyline.pack(50, 10, shortSlot));
+    CHECK_EQ(shortSlot.x, 50);
+    // fits on top of either, but leaves a lower top edge on the short one
+    CHECK(skyline.pack(50, 20, next));
+    CHECK_EQ(next.x, 50);
+    CHECK_EQ(next.y, 10);
+    checkNodes(skyline);
+}
+
+TEST(Skyline, randomRectsDontOverlap) {
+    std::mt19937 random(42);
+    for (int trial = 0; trial < 20; ++trial) {
+        Skyline skyline;
+        skyline.reset(256);
+        std::vector<IntRectangle> placed;
+        int failures = 0;
+        while (failures < 20) {
+            int width = 1 + random() % 40, height = 1 + random() % 40;
+            IntRectangle slot;
+            if (!skyline.pack(width, height, slot)) {
+                ++failures;
+                continue;
+            }
+            CHECK_EQ(slot.width, width);
+            CHECK_EQ(slot.height, height);
+            CHECK(slot.x >= 0 && slot.right() <= 256);
+            CHECK(slot.y >= 0 && slot.bottom() <= 256);
+            for (auto &other : placed) {
+                CHECK(!overlaps(slot, other));
+            }
+            placed.push_back(slot);
+            checkNodes(skyline);
+        }
+        CHECK(placed.size() > 30);
+    }
+}
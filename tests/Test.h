@@ -0,0 +1,51 @@
+#ifndef KRIT_TESTS_TEST
+#define KRIT_TESTS_TEST
+
+#include <cstdio>
+#include <vector>
+
+/**
+ * A minimal test harness, so the tests build without any dependencies.
+ *
+ *   TEST(Suite, name) {
+ *       CHECK(1 + 1 == 2);
+ *   }
+ *
+ * Each suite is registered with ctest separately; see main.cpp.
+ */
+namespace krit::test {
+
+struct TestCase {
+    const char *suite;
+    const char *name;
+    void (*run)();
+};
+
+std::vector<TestCase> &testCases();
+
+struct TestRegistrar {
+    TestRegistrar(const char *suite, const char *name, void (*run)()) {
+        testCases().push_back(TestCase{suite, name, run});
+    }
+};
+
+void fail(const char *file, int line, const char *expression);
+
+}
+
+#define TEST(suite, name)                                                      \
+    static void suite##_##name();                                              \
+    static krit::test::TestRegistrar suite##_##name##_registrar(               \
+        #suite, #name, suite##_##name);                                        \
+    static void suite##_##name()
+
+#define CHECK(expression)                                                      \
+    do {                                                                       \
+        if (!(expression)) {                                                   \
+            krit::test::fail(__FILE__, __LINE__, #expression);                 \
+        }                                                                      \
+    } while (0)
+
+#define CHECK_EQ(a, b) CHECK((a) == (b))
+
+#endif
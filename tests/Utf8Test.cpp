@@ -0,0 +1,47 @@
+#include "Test.h"
+#include "krit/utils/Utf8.h"
+#include <random>
+#include <string>
+
+using namespace krit;
+
+template <char... Delimiters>
+static size_t naiveFind(std::string_view s, size_t pos) {
+    for (; pos < s.size(); ++pos) {
+        if (((s[pos] == Delimiters) || ...)) {
+            return pos;
+        }
+    }
+    return s.size();
+}
+
+TEST(Utf8, findAsciiBasics) {
+    CHECK_EQ((findAscii<' '>("", 0)), 0u);
+    CHECK_EQ((findAscii<' '>("abc", 0)), 3u);
+    CHECK_EQ((findAscii<' '>("ab cdefghijkl", 0)), 2u);
+    CHECK_EQ((findAscii<' '>("abcdefghijk l", 0)), 11u);
+    CHECK_EQ((findAscii<' ', '\n'>("abcdefghij\nk l", 0)), 10u);
+    CHECK_EQ((findAscii<' '>("a b c", 2)), 3u);
+    // bytes of multibyte characters never match
+    CHECK_EQ((findAscii<' '>("\xe4\xb8\xad\xe6\x96\x87\xe5\xad\x97 x", 0)),
+             9u);
+}
+
+TEST(Utf8, findAsciiMatchesNaive) {
+    std::mt19937 random(7);
+    const char alphabet[] = {'a', ' ', '\n', '<', '\xe4', '\xb8', '\x80', 'z'};
+    for (int trial = 0; trial < 500; ++trial) {
+        std::string s;
+        size_t length = random() % 40;
+        for (size_t i = 0; i < length; ++i) {
+            // mostly letters, so matches are spread out
+            s += random() % 6 ? 'a' + random() % 26
+                              : alphabet[random() % sizeof(alphabet)];
+        }
+        for (size_t pos = 0; pos <= s.size(); ++pos) {
+            CHECK_EQ((findAscii<' '>(s, pos)), (naiveFind<' '>(s, pos)));
+            CHECK_EQ((findAscii<' ', '\n', '<'>(s, pos)),
+                     (naiveFind<' ', '\n', '<'>(s, pos)));
+        }
+    }
+}
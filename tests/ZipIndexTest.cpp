@@ -0,0 +1,42 @@
+#include "Test.h"
+#include "krit/io/ZipIndex.h"
+#include <string>
+
+using namespace krit;
+
+TEST(ZipIndex, findByName) {
+    ZipIndex index;
+    uint64_t found = 99;
+    CHECK(!index.find("a.txt", found));
+    CHECK_EQ(found, 99u);
+    index.reserve(3);
+    index.add("a.txt", 10);
+    index.skip();
+    index.add("dir/b.txt", 20);
+    CHECK_EQ(index.size(), 2u);
+    CHECK_EQ(index.entries.size(), 3u);
+    const ZipIndex::Entry *entry = index.find("dir/b.txt", found);
+    CHECK(entry && entry->size == 20);
+    // positions stay lined up with the archive's, skipped entries included
+    CHECK_EQ(found, 2u);
+    CHECK(index.find("a.txt", found) && found == 0);
+    CHECK(!index.find("", found));
+    CHECK(!index.find("dir", found));
+}
+
+TEST(ZipIndex, namesOutliveGrowth) {
+    // more entries than were reserved, with names too long to be stored
+    // inline, so they'd dangle if entries moved
+    ZipIndex index;
+    index.reserve(4);
+    for (int i = 0; i < 5000; ++i) {
+        index.add("assets/some/long/directory/name/file" + std::to_string(i),
+                  i);
+    }
+    for (int i = 0; i < 5000; ++i) {
+        uint64_t found;
+        auto entry = index.find(
+            "assets/some/long/directory/name/file" + std::to_string(i), found);
+        CHECK(entry && found == (uint64_t)i && entry->size == (uint64_t)i);
+    }
+}
@@ -0,0 +1,42 @@
+#include "Test.h"
+#include <cstring>
+
+namespace krit::test {
+
+static int failures = 0;
+
+std::vector<TestCase> &testCases() {
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+void fail(const char *file, int line, const char *expression) {
+    fprintf(stderr, "  %s:%i: CHECK(%s) failed\n", file, line, expression);
+    ++failures;
+}
+
+}
+
+/**
+ * Runs every test, or only those in the suite named by the first argument.
+ */
+int main(int argc, char **argv) {
+    using namespace krit::test;
+    const char *suite = argc > 1 ? argv[1] : nullptr;
+    int ran = 0, failed = 0;
+    for (auto &test : testCases()) {
+        if (suite && strcmp(suite, test.suite)) {
+            continue;
+        }
+        int before = failures;
+        test.run();
+        ++ran;
+        bool passed = failures == before;
+        if (!passed) {
+            ++failed;
+        }
+        printf("%s %s.%s\n", passed ? "PASS" : "FAIL", test.suite, test.name);
+    }
+    printf("%i of %i tests passed\n", ran - failed, ran);
+    return ran && !failed ? 0 : 1;
+}
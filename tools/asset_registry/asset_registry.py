@@ -1,5 +1,9 @@
 from glob import glob
+import math
 import os
+import struct
+import subprocess
+import zlib
 from jinja2 import Template
 import yaml
 from PIL import Image
@@ -7,12 +11,99 @@ from PIL import Image
 def pascalCase(path):
     return ''.join(filter(lambda s: s.isalpha() or s.isdigit(), list(''.join(s.title() for s in path.split('/')))))
 
-def run(inputPath, outputDir):
+# compressonator codec names for each supported KTX2 variant; the runtime
+# looks for these as siblings of the source image, e.g. foo.1080.bc7.ktx2
+COMPRESSED_FORMATS = {
+    'bc1': 'BC1',
+    'bc3': 'BC3',
+    'bc7': 'BC7',
+    'etc2': 'ETC2_RGBA',
+    'astc': 'ASTC',
+}
+
+def compressImage(compressor, sourcePath, format, w, h):
+    if format not in COMPRESSED_FORMATS:
+        raise Exception("Unrecognized compressed texture format: {}".format(format))
+    outPath = os.path.splitext(sourcePath)[0] + '.' + format + '.ktx2'
+    if not os.path.exists(outPath) or os.path.getmtime(outPath) < os.path.getmtime(sourcePath):
+        mipLevels = int(math.log2(max(w, h, 1))) + 1
+        print('compressing {} -> {}'.format(sourcePath, outPath))
+        subprocess.check_call([
+            compressor,
+            '-fd', COMPRESSED_FORMATS[format],
+            '-miplevels', str(mipLevels),
+            sourcePath,
+            outPath,
+        ])
+    return { 'format': format, 'path': outPath }
+
+# binary image manifest read by ImageLoader::parseManifest; see
+# src/krit/asset/ImageLoader.cpp for the layout
+MANIFEST_MAGIC = b'KIMG'
+MANIFEST_VERSION = 1
+MANIFEST_HEADER = struct.Struct('<4sIII')
+MANIFEST_IMAGE = struct.Struct('<IIII')
+MANIFEST_FILE = struct.Struct('<IIIIIIII')
+
+MANIFEST_FORMATS = {'png': 0, 'jpg': 1, 'jpeg': 1, 'ktx2': 2}
+PREMULTIPLIED = 1
+SIBLING = 2
+
+def fileCrc(path):
+    crc = 0
+    with open(path, 'rb') as f:
+        for chunk in iter(lambda: f.read(1 << 20), b''):
+            crc = zlib.crc32(chunk, crc)
+    return crc & 0xffffffff
+
+def manifestFile(assetRoot, path, resolution, w, h, flags):
+    format = os.path.splitext(path)[1][1:].lower()
+    if format not in MANIFEST_FORMATS:
+        raise Exception("Unrecognized image format: {}".format(path))
+    return {
+        'path': os.path.relpath(path, assetRoot).replace(os.sep, '/'),
+        'resolution': resolution,
+        'width': w,
+        'height': h,
+        'format': MANIFEST_FORMATS[format],
+        'flags': flags,
+        'crc': fileCrc(path),
+    }
+
+def writeManifest(outPath, manifest):
+    images = []
+    files = []
+    strings = bytearray()
+    def addString(s):
+        offset = len(strings)
+        strings.extend(s.encode('utf-8'))
+        return offset, len(strings) - offset
+    for key in sorted(manifest):
+        # each tier is followed by its precompressed siblings
+        imageFiles = sorted(manifest[key], key=lambda f: (f['resolution'], f['flags'] & SIBLING, f['path']))
+        keyOffset, keyLength = addString(key)
+        images.append(MANIFEST_IMAGE.pack(keyOffset, keyLength, len(files), len(imageFiles)))
+        for f in imageFiles:
+            pathOffset, pathLength = addString(f['path'])
+            files.append(MANIFEST_FILE.pack(f['crc'], pathOffset, pathLength, f['resolution'], f['width'], f['height'], f['format'], f['flags']))
+    content = MANIFEST_HEADER.pack(MANIFEST_MAGIC, MANIFEST_VERSION, len(images), len(files)) + b''.join(images) + b''.join(files) + bytes(strings)
+    if os.path.exists(outPath):
+        with open(outPath, 'rb') as existingFile:
+            if existingFile.read() == content:
+                print('no change to {}; skipping'.format(outPath))
+                return
+    with open(outPath, 'wb') as outFile:
+        outFile.write(content)
+
+def run(inputPath, outputDir, compressor='compressonatorcli', manifestPath=None):
     imagePaths = {}
     images = []
+    # every file of each image, by the key the runtime loads it with
+    manifest = {}
+    assetRoot = 'assets'
     def getImage(path):
         if path not in imagePaths:
-            img = { 'path': path, 'width': 0, 'height': 0, 'sizes': [] }
+            img = { 'path': path, 'width': 0, 'height': 0, 'sizes': [], 'compressed': [] }
             images.append(img)
             imagePaths[path] = img
             return img
@@ -38,11 +129,14 @@ def run(inputPath, outputDir):
                         raise Exception("Unrecognized image extension: {}".format(matchPath))
 
                     base = getImage(basePath)
+                    key = os.path.relpath(basePath, assetRoot).replace(os.sep, '/')
+                    flags = PREMULTIPLIED if item.get('premultiplied') else 0
                     if size == 2160:
                         im = Image.open(matchPath)
                         w, h = im.size
                         base['width'] = w
                         base['height'] = h
+                        target = base
                     else:
                         child = getImage(matchPath)
                         im = Image.open(matchPath)
@@ -50,6 +144,13 @@ def run(inputPath, outputDir):
                         child['width'] = w
                         child['height'] = h
                         base['sizes'].append({ 'size': size, 'path': matchPath })
+                        target = child
+                    files = manifest.setdefault(key, [])
+                    files.append(manifestFile(assetRoot, matchPath, size, w, h, flags))
+                    for format in item.get('compress', []):
+                        variant = compressImage(compressor, matchPath, format, w, h)
+                        target['compressed'].append(variant)
+                        files.append(manifestFile(assetRoot, variant['path'], size, w, h, flags | SIBLING))
 
     for artifact in ('images.yaml',):
         outPath = os.path.join(outputDir, artifact)
@@ -66,6 +167,12 @@ def run(inputPath, outputDir):
         else:
             print('no change to {}; skipping'.format(artifact))
 
+    if manifestPath is None:
+        if not manifest:
+            return
+        manifestPath = os.path.join(assetRoot, 'images.manifest')
+    writeManifest(manifestPath, manifest)
+
 
 def main():
     import argparse
@@ -73,10 +180,12 @@ def main():
     parser = argparse.ArgumentParser(description='asset_registry.py')
     parser.add_argument('--input', nargs='?', default='assets.yaml', help='path to assets file; output files will be saved in this directory')
     parser.add_argument('--output-dir', nargs='?', default='.', help='directory where output files will be stored')
+    parser.add_argument('--compressor', nargs='?', default='compressonatorcli', help='texture compressor used for images with a `compress` list')
+    parser.add_argument('--manifest', nargs='?', default=None, help='where to write the binary image manifest; defaults to images.manifest in the asset root')
 
     args = parser.parse_args()
 
-    run(args.input, args.output_dir)
+    run(args.input, args.output_dir, args.compressor, args.manifest)
 
 if __name__ == '__main__':
     main()
@@ -0,0 +1,130 @@
+"""
+Build a pack archive (see src/krit/io/PackFormat.h) from a directory of assets.
+
+    python3 pack.py assets assets.pack
+
+Files are stored uncompressed when their format is already compressed or
+benefits from being mapped directly (images, audio, GPU textures), and
+deflated otherwise; use --store/--deflate to override by extension.
+"""
+
+import argparse
+import os
+import struct
+import zlib
+
+MAGIC = b'KPAK'
+VERSION = 2
+HEADER = struct.Struct('<4sIIIQQ')
+ENTRY = struct.Struct('<QQQQQIIII')
+
+STORED = 0
+DEFLATE = 1
+
+# formats which don't get smaller, or which loaders read straight from the
+# archive's mapping
+STORED_EXTENSIONS = {'.png', '.jpg', '.jpeg', '.ktx2', '.ogg', '.mp3', '.flac', '.zip'}
+
+# only used for names; contents are hashed with zlib.crc32, which is far
+# faster than hashing byte by byte in Python
+def fnv1a(data):
+    h = 0xcbf29ce484222325
+    for b in data:
+        h ^= b
+        h = (h * 0x100000001b3) & 0xffffffffffffffff
+    return h
+
+def align(offset, alignment):
+    return (offset + alignment - 1) // alignment * alignment
+
+def collectFiles(root):
+    paths = []
+    for dirPath, dirNames, fileNames in os.walk(root):
+        dirNames.sort()
+        for fileName in sorted(fileNames):
+            fullPath = os.path.join(dirPath, fileName)
+            paths.append(os.path.relpath(fullPath, root).replace(os.sep, '/'))
+    return paths
+
+def chooseCompression(path, store, deflate):
+    extension = os.path.splitext(path)[1].lower()
+    if extension in deflate:
+        return DEFLATE
+    if extension in store or extension in STORED_EXTENSIONS:
+        return STORED
+    return DEFLATE
+
+def run(root, outputPath, alignment=4096, store=(), deflate=()):
+    entries = []
+    for path in collectFiles(root):
+        with open(os.path.join(root, path), 'rb') as f:
+            content = f.read()
+        compression = chooseCompression(path, store, deflate)
+        data = content
+        if compression == DEFLATE:
+            data = zlib.compress(content, 9)
+            if len(data) >= len(content):
+                # not worth inflating at load time
+                compression = STORED
+                data = content
+        entries.append({
+            'name': path.encode('utf-8'),
+            'data': data,
+            'size': len(content),
+            'hash': zlib.crc32(content),
+            'compression': compression,
+        })
+    for entry in entries:
+        entry['nameHash'] = fnv1a(entry['name'])
+    entries.sort(key=lambda e: (e['nameHash'], e['name']))
+
+    names = b''
+    for entry in entries:
+        entry['nameOffset'] = len(names)
+        names += entry['name']
+
+    tocOffset = HEADER.size
+    namesOffset = tocOffset + ENTRY.size * len(entries)
+    offset = namesOffset + len(names)
+    for entry in entries:
+        offset = align(offset, alignment)
+        entry['offset'] = offset
+        offset += len(entry['data'])
+
+    tmpPath = outputPath + '.tmp'
+    with open(tmpPath, 'wb') as out:
+        out.write(HEADER.pack(MAGIC, VERSION, len(entries), alignment, tocOffset, namesOffset))
+        for entry in entries:
+            out.write(ENTRY.pack(
+                entry['nameHash'],
+                entry['offset'],
+                len(entry['data']),
+                entry['size'],
+                entry['hash'],
+                entry['nameOffset'],
+                len(entry['name']),
+                entry['compression'],
+                0,
+            ))
+        out.write(names)
+        for entry in entries:
+            out.write(b'\0' * (entry['offset'] - out.tell()))
+            out.write(entry['data'])
+    os.replace(tmpPath, outputPath)
+
+    stored = sum(1 for e in entries if e['compression'] == STORED)
+    print('packed {} files ({} stored, {} deflated) into {}'.format(
+        len(entries), stored, len(entries) - stored, outputPath))
+
+def extensions(s):
+    return {e if e.startswith('.') else '.' + e for e in s.split(',') if e}
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Build a krit pack archive')
+    parser.add_argument('root', help='directory to pack')
+    parser.add_argument('output', help='archive to write')
+    parser.add_argument('--align', type=int, default=4096, help='entry alignment in bytes')
+    parser.add_argument('--store', type=extensions, default=set(), help='comma separated extensions to always store')
+    parser.add_argument('--deflate', type=extensions, default=set(), help='comma separated extensions to always deflate')
+    args = parser.parse_args()
+    run(args.root, args.output, args.align, args.store, args.deflate)